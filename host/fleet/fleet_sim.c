@@ -0,0 +1,678 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "change_detector.h"
+#include "sample_scheduler.h"
+#include "load_classifier.h"
+#include "telemetry.h"
+#include "ota_poll.h"
+#include "app_config.h"
+#include "sensor_logic.h"
+
+// Fleet load generator for the ingest side (broker, Node-RED, Prometheus).
+// Thousands of virtual monitors run the firmware's own publishing
+// decision and payload code on a work-stealing thread pool. Each replays
+// the dataset traces from a random offset in accelerated virtual time
+// and publishes to a broker stand-in on loopback.
+//
+// Per device, through the same sensor_logic.c calls as app_main and
+// sensor_logic_task, with the settings of app_config.h:
+//   awake   reads at the sample_scheduler period, publishes when the
+//           change detector (CHANGE_POLICY) fires and on the first
+//           reading of a wake, deep sleep after IDLE_TIMEOUT_MS without a
+//           change
+//   asleep  wake checks at the scheduler's sleep period, a full wake on a
+//           change or after OTA_CHECK_INTERVAL_MS asleep
+// Payloads come from src/telemetry.c in the chosen format and batching,
+// on the topics of src/mqtt_manager.c. Not modelled: the sleep journal,
+// grid events, rollups, metrics and the connect time after a wake.
+//
+// Virtual time advances in ticks of TICK_MS. Each tick the devices are
+// cut into chunks dealt round robin onto the workers' deques. A worker
+// takes from the back of its own deque and steals from the front of the
+// others. With -x the next tick waits for its wall-clock slot, so the
+// fleet offers x times its real-time load; -x 0 runs flat out.
+//
+// Each worker holds one TCP connection to the stand-in, like a bridge,
+// and writes MQTT 3.1.1 PUBLISH packets (QoS 1, as the firmware sends
+// them), each prefixed with its send time. The stand-in is one thread
+// polling every connection, like a single-threaded broker. It parses the
+// packets, counts the PUBACKs it would send back, and takes the latency
+// from send to parsed.
+//
+// Build (from the repo root):
+//   cc -O2 -DHAL_HOST -Iinclude -o fleet_sim host/fleet/fleet_sim.c src/sensor_logic.c src/change_detector.c src/sample_scheduler.c src/load_classifier.c src/telemetry.c -lpthread
+// Run:
+//   ./fleet_sim [-n devices] [-t threads] [-d seconds] [-x speed] [-b] [-B samples[:ms]] [-s seed] dataset/*.csv
+
+#define TICK_MS            500      // SCHED_FAST_PERIOD_MS, no device reads faster
+#define CHUNK_DEVICES      64
+#define SEND_BUF           65536
+#define CONN_BUF           (2 * SEND_BUF)
+#define STAMP_LEN          8
+#define PUBACK_LEN         4
+
+// --- Trace ---
+
+typedef struct {
+    float voltage, current, power, energy, frequency, pf;
+} row_t;
+
+static row_t *rows = NULL;
+static uint32_t row_count = 0;
+
+static int load_csv(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    char line[128];
+    int added = 0;
+    while (fgets(line, sizeof(line), f)) {
+        row_t r;
+        if (sscanf(line, "%f,%f,%f,%f,%f,%f", &r.voltage, &r.current, &r.power, &r.energy, &r.frequency,
+                   &r.pf) != 6) {
+            continue; // Header
+        }
+        row_t *grown = realloc(rows, (row_count + 1) * sizeof(row_t));
+        if (!grown) break;
+        rows = grown;
+        rows[row_count++] = r;
+        added++;
+    }
+    fclose(f);
+    return added;
+}
+
+// As the emulated PZEM of the host simulator reports it
+static void row_data(uint32_t row, pzem_data_t *out) {
+    const row_t *r = &rows[row];
+    out->voltage_dv = (uint16_t)(r->voltage * 10.0f + 0.5f);
+    out->current_ma = (uint32_t)(r->current * 1000.0f + 0.5f);
+    out->power_dw   = (uint32_t)(r->power * 10.0f + 0.5f);
+    out->energy_wh  = (uint32_t)(r->energy * 1000.0f + 0.5f);
+    out->freq_dhz   = (uint16_t)(r->frequency * 10.0f + 0.5f);
+    out->pf_cent    = (uint16_t)(r->pf * 100.0f + 0.5f);
+    out->valid = true;
+}
+
+// --- Options ---
+
+static uint32_t device_count = 2000;
+static int thread_count = 0;
+static uint32_t duration_s = 3600;
+static double speed = 600;
+static telemetry_format_t format = TELEMETRY_FMT_JSON;
+static int batch_max = 1;
+static uint32_t batch_latency_ms = 5000;
+static uint32_t seed = 1;
+
+// --- Devices ---
+
+typedef struct {
+    change_detector_t detector;
+    sample_scheduler_t scheduler;
+    sensor_logic_t logic;
+    telemetry_batch_t batch;
+    uint32_t offset;              // Trace row at virtual time 0
+    uint64_t next_ms;             // Virtual time of the next reading
+    uint32_t slept_ms;            // Asleep since the last full wake
+    uint16_t packet_id;
+    bool awake;
+} device_t;
+
+typedef struct {
+    pthread_t thread;
+    int fd;
+    uint8_t out[SEND_BUF];
+    size_t out_len;
+    // Deque of chunk numbers: the owner pops at tail, thieves take at head
+    pthread_mutex_t lock;
+    uint32_t *chunks;
+    uint32_t head, tail;
+    uint32_t rng;
+    // Counters
+    uint64_t readings;
+    uint64_t wakes;
+    uint64_t messages;
+    uint64_t payload_bytes;
+    uint64_t wire_bytes;
+    uint64_t chunks_run;
+    uint64_t steals;
+} worker_t;
+
+static device_t *devices;
+static worker_t *workers;
+static uint32_t chunk_count;
+static uint64_t tick_end_ms;
+static pthread_barrier_t tick_start, tick_done;
+static _Atomic bool stop;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint32_t xorshift(uint32_t *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static bool write_all(int fd, const uint8_t *data, size_t len) {
+    while (len) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static void flush_out(worker_t *w) {
+    if (w->out_len && !write_all(w->fd, w->out, w->out_len)) {
+        perror("send");
+        exit(1);
+    }
+    w->out_len = 0;
+}
+
+// [send time u64][PUBLISH QoS 1: header, remaining length, topic, packet id, payload]
+static void publish(worker_t *w, device_t *d, const char *topic, const uint8_t *payload, int len) {
+    const size_t topic_len = strlen(topic);
+    uint32_t remaining = (uint32_t)(2 + topic_len + 2 + len);
+    uint8_t head[STAMP_LEN + 5];
+    size_t n = STAMP_LEN;
+
+    if (w->out_len + sizeof(head) + remaining > sizeof(w->out)) flush_out(w);
+    uint64_t stamp = now_ns();
+    memcpy(head, &stamp, STAMP_LEN);
+    head[n++] = 0x32;
+    do {
+        head[n++] = (remaining & 0x7F) | (remaining > 0x7F ? 0x80 : 0);
+        remaining >>= 7;
+    } while (remaining);
+
+    uint8_t *p = w->out + w->out_len;
+    memcpy(p, head, n);
+    p += n;
+    *p++ = (uint8_t)(topic_len >> 8);
+    *p++ = (uint8_t)topic_len;
+    memcpy(p, topic, topic_len);
+    p += topic_len;
+    d->packet_id = d->packet_id == UINT16_MAX ? 1 : d->packet_id + 1;
+    *p++ = (uint8_t)(d->packet_id >> 8);
+    *p++ = (uint8_t)d->packet_id;
+    memcpy(p, payload, len);
+    p += len;
+
+    w->wire_bytes += (uint64_t)(p - (w->out + w->out_len)) - STAMP_LEN;
+    w->out_len = (size_t)(p - w->out);
+    w->messages++;
+    w->payload_bytes += len;
+}
+
+// As mqtt_publisher_task: one sample on its own topic, more as a batch
+static void publish_batch(worker_t *w, device_t *d) {
+    static _Thread_local uint8_t payload[TELEMETRY_BATCH_BUF_SIZE];
+    const bool binary = format == TELEMETRY_FMT_BINARY;
+    int len;
+
+    if (d->batch.count == 0) return;
+    if (d->batch.count == 1) {
+        len = telemetry_serialize(format, &d->batch.samples[0], payload, sizeof(payload));
+        if (len > 0) publish(w, d, binary ? MQTT_TOPIC_BIN : MQTT_TOPIC, payload, len);
+    } else {
+        len = telemetry_serialize_batch(format, &d->batch, payload, sizeof(payload));
+        if (len > 0) publish(w, d, binary ? MQTT_TOPIC_BATCH_BIN : MQTT_TOPIC_BATCH, payload, len);
+    }
+    d->batch.count = 0;
+}
+
+static void send_sample(worker_t *w, device_t *d, const pzem_data_t *data, uint64_t now) {
+    telemetry_sample_t s = {
+        .ts_ms = (uint32_t)now,
+        .data = *data,
+        .load_class = load_classifier_predict(data),
+    };
+    if (telemetry_batch_add(&d->batch, &s, batch_max)) publish_batch(w, d);
+}
+
+static void device_init(device_t *d, uint32_t *rng) {
+    memset(d, 0, sizeof(*d));
+    change_detector_init(&d->detector, CHANGE_POLICY);
+    sample_scheduler_init(&d->scheduler, OVERLOAD_POWER_DW);
+    sample_scheduler_wake(&d->scheduler);
+    d->offset = xorshift(rng) % row_count;
+    d->next_ms = xorshift(rng) % 1000;          // Not all in step
+    d->logic.last_class = LOAD_CLASS_UNKNOWN;
+    sensor_logic_start(&d->logic, (uint32_t)d->next_ms);
+    d->awake = true;
+}
+
+// One reading at d->next_ms
+static void step(worker_t *w, device_t *d) {
+    const uint64_t now = d->next_ms;
+    pzem_data_t data;
+    row_data((uint32_t)((d->offset + now / 1000) % row_count), &data);
+    w->readings++;
+
+    if (d->batch.count && telemetry_batch_expired(&d->batch, (uint32_t)now, batch_latency_ms)) {
+        publish_batch(w, d);
+    }
+
+    if (!d->awake) {
+        // Wake check of app_main
+        uint8_t changed = change_detector_update(&d->detector, &data);
+        if (!sensor_logic_wake(&d->logic, changed, d->slept_ms)) {
+            uint32_t sleep_ms = sample_scheduler_next_sleep(&d->scheduler, data.power_dw);
+            d->slept_ms += sleep_ms;
+            d->next_ms = now + sleep_ms;
+            return;
+        }
+        w->wakes++;
+        d->awake = true;
+        d->slept_ms = 0;
+        sensor_logic_start(&d->logic, (uint32_t)now);
+        sample_scheduler_wake(&d->scheduler);
+    }
+
+    // sensor_logic_task
+#if PUBLISH_ON_CLASS_CHANGE_ONLY
+    uint8_t load_class = load_classifier_predict(&data);
+#else
+    uint8_t load_class = LOAD_CLASS_UNKNOWN;    // Not part of the decision, classified when sent
+#endif
+    sensor_decision_t decision = sensor_logic_step(&d->logic, &d->detector, &data, load_class, (uint32_t)now);
+    uint8_t changed = decision.changed;
+    if (decision.publish) send_sample(w, d, &data, now);
+
+    if (decision.sleep) {
+        publish_batch(w, d);
+        d->awake = false;
+        d->slept_ms += sample_scheduler_sleep(&d->scheduler);
+        d->next_ms = now + sample_scheduler_sleep(&d->scheduler);
+        return;
+    }
+    d->next_ms = now + sample_scheduler_next(&d->scheduler, changed != 0, data.power_dw, false);
+}
+
+static void run_chunk(worker_t *w, uint32_t chunk) {
+    uint32_t first = chunk * CHUNK_DEVICES;
+    uint32_t last = first + CHUNK_DEVICES < device_count ? first + CHUNK_DEVICES : device_count;
+    for (uint32_t i = first; i < last; i++) {
+        device_t *d = &devices[i];
+        while (d->next_ms < tick_end_ms) {
+            step(w, d);
+        }
+    }
+    w->chunks_run++;
+    flush_out(w);
+}
+
+static bool pop(worker_t *w, uint32_t *chunk) {
+    bool ok = false;
+    pthread_mutex_lock(&w->lock);
+    if (w->tail != w->head) {
+        *chunk = w->chunks[--w->tail];
+        ok = true;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return ok;
+}
+
+static bool steal(worker_t *w, uint32_t *chunk) {
+    uint32_t start = xorshift(&w->rng) % thread_count;
+    for (int k = 0; k < thread_count; k++) {
+        worker_t *v = &workers[(start + k) % thread_count];
+        if (v == w) continue;
+        pthread_mutex_lock(&v->lock);
+        bool ok = v->head != v->tail;
+        if (ok) *chunk = v->chunks[v->head++];
+        pthread_mutex_unlock(&v->lock);
+        if (ok) {
+            w->steals++;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Deques are only filled between ticks, so once every one is empty the
+// tick's work is handed out
+static void *worker(void *arg) {
+    worker_t *w = arg;
+    uint32_t chunk;
+
+    for (;;) {
+        pthread_barrier_wait(&tick_start);
+        if (atomic_load(&stop)) break;
+        while (pop(w, &chunk) || steal(w, &chunk)) {
+            run_chunk(w, chunk);
+        }
+        pthread_barrier_wait(&tick_done);
+    }
+    for (uint32_t i = 0; i < device_count; i++) {
+        // Whatever is still batched goes out at the end
+        if ((int)(i / CHUNK_DEVICES % thread_count) == (int)(w - workers)) publish_batch(w, &devices[i]);
+    }
+    flush_out(w);
+    shutdown(w->fd, SHUT_WR);
+    return NULL;
+}
+
+// --- Broker stand-in ---
+
+typedef struct {
+    int fd;
+    uint8_t buf[CONN_BUF];
+    size_t len;
+} conn_t;
+
+typedef struct {
+    uint64_t messages;
+    uint64_t wire_bytes;
+    uint64_t bad_packets;
+    uint32_t *latency_us;
+    uint64_t latency_count, latency_cap;
+    uint64_t latency_max_us;
+} broker_stats_t;
+
+static int listen_fd;
+static uint16_t broker_port;
+static broker_stats_t broker;
+
+static void record_latency(uint64_t us) {
+    if (broker.latency_count == broker.latency_cap) {
+        uint64_t cap = broker.latency_cap ? broker.latency_cap * 2 : 1 << 16;
+        uint32_t *grown = realloc(broker.latency_us, cap * sizeof(uint32_t));
+        if (!grown) return;
+        broker.latency_us = grown;
+        broker.latency_cap = cap;
+    }
+    broker.latency_us[broker.latency_count++] = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+    if (us > broker.latency_max_us) broker.latency_max_us = us;
+}
+
+// Whole packets at the front of c->buf, returns the bytes used
+static size_t parse_packets(conn_t *c) {
+    size_t pos = 0;
+    while (c->len - pos >= STAMP_LEN + 2) {
+        const uint8_t *p = c->buf + pos;
+        size_t n = STAMP_LEN + 1;
+        uint32_t remaining = 0;
+        int shift = 0;
+        do {
+            if (n >= c->len - pos) return pos;
+            remaining |= (uint32_t)(p[n] & 0x7F) << shift;
+            shift += 7;
+        } while (p[n++] & 0x80);
+        if (c->len - pos < n + remaining) return pos;
+
+        uint64_t stamp;
+        memcpy(&stamp, p, STAMP_LEN);
+        const uint8_t *v = p + n;
+        size_t topic_len = (size_t)v[0] << 8 | v[1];
+        bool ok = p[STAMP_LEN] == 0x32 && remaining >= 4 + topic_len && topic_len > 11 &&
+                  memcmp(v + 2, "esp32/pzem/", 11) == 0;
+        const uint8_t *payload = v + 2 + topic_len + 2;
+        size_t payload_len = remaining - (4 + topic_len);
+        if (ok && payload_len && payload[0] == '{') {
+            ok = memchr(payload, '}', payload_len) != NULL;   // What a JSON node would look at first
+        }
+        if (ok) {
+            broker.messages++;
+            broker.wire_bytes += n - STAMP_LEN + remaining;
+            record_latency((now_ns() - stamp) / 1000);
+        } else {
+            broker.bad_packets++;
+        }
+        pos += n + remaining;
+    }
+    return pos;
+}
+
+static void *broker_thread(void *arg) {
+    (void)arg;
+    conn_t *conns = calloc(thread_count, sizeof(conn_t));
+    struct pollfd *fds = calloc(thread_count, sizeof(struct pollfd));
+    int open = 0;
+
+    for (int i = 0; i < thread_count; i++) {
+        conns[i].fd = accept(listen_fd, NULL, NULL);
+        fds[i].fd = conns[i].fd;
+        fds[i].events = POLLIN;
+        open++;
+    }
+    while (open > 0) {
+        if (poll(fds, thread_count, 100) <= 0) continue;
+        for (int i = 0; i < thread_count; i++) {
+            if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP))) continue;
+            conn_t *c = &conns[i];
+            ssize_t n = recv(c->fd, c->buf + c->len, sizeof(c->buf) - c->len, 0);
+            if (n <= 0) {
+                close(c->fd);
+                fds[i].fd = -1;
+                open--;
+                continue;
+            }
+            c->len += (size_t)n;
+            size_t used = parse_packets(c);
+            memmove(c->buf, c->buf + used, c->len - used);
+            c->len -= used;
+        }
+    }
+    free(conns);
+    free(fds);
+    return NULL;
+}
+
+static bool broker_start(pthread_t *thread) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t len = sizeof(addr);
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(listen_fd, thread_count) < 0 || getsockname(listen_fd, (struct sockaddr *)&addr, &len) < 0) {
+        return false;
+    }
+    broker_port = ntohs(addr.sin_port);
+    return pthread_create(thread, NULL, broker_thread, NULL) == 0;
+}
+
+static int connect_broker(void) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(broker_port),
+                                .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) return -1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t percentile(uint32_t percent) {
+    if (broker.latency_count == 0) return 0;
+    uint64_t i = (broker.latency_count * percent + 99) / 100;
+    return broker.latency_us[i ? i - 1 : 0];
+}
+
+// --- Main ---
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-n devices] [-t threads] [-d seconds] [-x speed] [-b] [-B samples[:ms]] [-s seed] trace.csv [trace.csv ...]\n", prog);
+    fprintf(stderr, "  -n  virtual devices (default %u)\n", device_count);
+    fprintf(stderr, "  -t  worker threads (default: one per CPU)\n");
+    fprintf(stderr, "  -d  virtual seconds to run (default %u)\n", duration_s);
+    fprintf(stderr, "  -x  virtual seconds per wall second, 0 = as fast as possible (default %.0f)\n", speed);
+    fprintf(stderr, "  -b  binary telemetry payload instead of JSON\n");
+    fprintf(stderr, "  -B  batch up to samples (max %d) or ms per publish\n", TELEMETRY_BATCH_MAX);
+}
+
+int main(int argc, char **argv) {
+    int i;
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            device_count = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            thread_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            duration_s = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) {
+            speed = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0) {
+            format = TELEMETRY_FMT_BINARY;
+        } else if (strcmp(argv[i], "-B") == 0 && i + 1 < argc) {
+            char *rest;
+            batch_max = (int)strtol(argv[++i], &rest, 10);
+            if (*rest == ':') batch_latency_ms = (uint32_t)strtoul(rest + 1, NULL, 10);
+            if (batch_max < 1) batch_max = 1;
+            if (batch_max > TELEMETRY_BATCH_MAX) batch_max = TELEMETRY_BATCH_MAX;
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (i == argc || device_count == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    for (; i < argc; i++) {
+        if (load_csv(argv[i]) < 0) {
+            fprintf(stderr, "Cannot read %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (row_count == 0) {
+        fprintf(stderr, "No rows\n");
+        return 1;
+    }
+    if (thread_count <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = cpus > 0 ? (int)cpus : 1;
+    }
+    if (seed == 0) seed = 1;
+
+    chunk_count = (device_count + CHUNK_DEVICES - 1) / CHUNK_DEVICES;
+    devices = malloc(device_count * sizeof(device_t));
+    workers = calloc(thread_count, sizeof(worker_t));
+    if (!devices || !workers) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    uint32_t rng = seed;
+    for (uint32_t d = 0; d < device_count; d++) {
+        device_init(&devices[d], &rng);
+    }
+
+    pthread_t broker_tid;
+    if (!broker_start(&broker_tid)) {
+        perror("broker");
+        return 1;
+    }
+    pthread_barrier_init(&tick_start, NULL, thread_count + 1);
+    pthread_barrier_init(&tick_done, NULL, thread_count + 1);
+    for (int t = 0; t < thread_count; t++) {
+        worker_t *w = &workers[t];
+        w->fd = connect_broker();
+        w->chunks = malloc(chunk_count * sizeof(uint32_t));
+        w->rng = seed + t + 1;
+        if (w->fd < 0 || !w->chunks) {
+            perror("worker");
+            return 1;
+        }
+        pthread_mutex_init(&w->lock, NULL);
+        pthread_create(&w->thread, NULL, worker, w);
+    }
+
+    const uint64_t ticks = (uint64_t)duration_s * 1000 / TICK_MS;
+    const uint64_t start = now_ns();
+    uint64_t late = 0;
+    for (uint64_t t = 0; t < ticks; t++) {
+        for (int k = 0; k < thread_count; k++) {
+            workers[k].head = workers[k].tail = 0;
+        }
+        for (uint32_t c = 0; c < chunk_count; c++) {
+            worker_t *w = &workers[c % thread_count];
+            w->chunks[w->tail++] = c;
+        }
+        tick_end_ms = (t + 1) * TICK_MS;
+        pthread_barrier_wait(&tick_start);
+        pthread_barrier_wait(&tick_done);
+
+        if (speed > 0) {
+            uint64_t due = start + (uint64_t)((double)tick_end_ms * 1e6 / speed);
+            uint64_t now = now_ns();
+            if (now > due) {
+                late++;
+            } else {
+                struct timespec ts = { .tv_sec = (time_t)((due - now) / 1000000000ull),
+                                       .tv_nsec = (long)((due - now) % 1000000000ull) };
+                nanosleep(&ts, NULL);
+            }
+        }
+    }
+    const double wall_s = (now_ns() - start) / 1e9;
+
+    atomic_store(&stop, true);
+    pthread_barrier_wait(&tick_start);
+    for (int t = 0; t < thread_count; t++) {
+        pthread_join(workers[t].thread, NULL);
+    }
+    pthread_join(broker_tid, NULL);
+
+    worker_t sum = {0};
+    for (int t = 0; t < thread_count; t++) {
+        const worker_t *w = &workers[t];
+        sum.readings += w->readings;
+        sum.wakes += w->wakes;
+        sum.messages += w->messages;
+        sum.payload_bytes += w->payload_bytes;
+        sum.wire_bytes += w->wire_bytes;
+        sum.chunks_run += w->chunks_run;
+        sum.steals += w->steals;
+    }
+    qsort(broker.latency_us, broker.latency_count, sizeof(uint32_t), compare_u32);
+
+    const double device_hours = (double)device_count * duration_s / 3600.0;
+    printf("Fleet          %10u  devices on %d threads, %u s virtual in %.2f s wall (%.0fx, %llu of %llu ticks late)\n",
+           device_count, thread_count, duration_s, wall_s, duration_s / wall_s, (unsigned long long)late,
+           (unsigned long long)ticks);
+    printf("Readings       %10llu  (%.0f / s wall)\n", (unsigned long long)sum.readings, sum.readings / wall_s);
+    printf("Full wakes     %10llu  (%.1f / device-hour)\n", (unsigned long long)sum.wakes, sum.wakes / device_hours);
+    printf("Messages       %10llu  (%.0f / s wall, %.0f / s at real time, %.1f / device-hour)\n",
+           (unsigned long long)sum.messages, sum.messages / wall_s, sum.messages / (double)duration_s,
+           sum.messages / device_hours);
+    printf("Payload bytes  %10llu  (%.1f / msg, %.2f MB / s wall)\n", (unsigned long long)sum.payload_bytes,
+           sum.messages ? (double)sum.payload_bytes / sum.messages : 0.0, sum.payload_bytes / wall_s / 1e6);
+    printf("Wire bytes     %10llu  (PUBLISH packets, plus %llu in PUBACKs)\n", (unsigned long long)sum.wire_bytes,
+           (unsigned long long)broker.messages * PUBACK_LEN);
+    printf("Latency        p50 %u us, p99 %u us, max %llu us (send to parsed by the stand-in)\n", percentile(50),
+           percentile(99), (unsigned long long)broker.latency_max_us);
+    printf("Work stealing  %10llu  of %llu chunks stolen\n", (unsigned long long)sum.steals,
+           (unsigned long long)sum.chunks_run);
+
+    bool ok = broker.messages == sum.messages && broker.wire_bytes == sum.wire_bytes && broker.bad_packets == 0;
+    if (!ok) {
+        printf("Stand-in got %llu messages, %llu bytes, %llu bad packets\n", (unsigned long long)broker.messages,
+               (unsigned long long)broker.wire_bytes, (unsigned long long)broker.bad_packets);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,416 @@
+#include "hal.h"
+#include "sim.h"
+#include "dlog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <setjmp.h>
+
+// Linux implementation of hal.h
+// Time is virtual: delays, sleeps and UART transfers advance the clock
+// instead of waiting. The PZEM is emulated from CSV rows, one row per
+// SIM_ROW_PERIOD_MS of virtual time (the datasets were logged at 1 Hz).
+
+#define BOOT_TIME_MS       30      // ROM + bootloader after deep sleep wake
+#define SIM_JMP_SLEEP      1
+#define SIM_JMP_END        2
+#define OUTBOX_IO_CHUNK    256
+
+sim_stats_t sim_stats;
+int sim_log_level = 0;
+telemetry_format_t sim_payload_format = TELEMETRY_FMT_JSON;
+int sim_batch_max = 1;
+uint32_t sim_batch_latency_ms = 5000;
+const char *sim_outbox_path = NULL;
+uint32_t sim_outbox_size = 256 * 1024;
+
+static sim_row_t *rows = NULL;
+static uint32_t row_count = 0;
+
+static uint64_t now_ms = 0;
+static uint64_t boot_ms = 0;
+static jmp_buf sim_jmp;
+static hal_task_fn_t sensor_task = NULL;
+static hal_periodic_fn_t periodic_fn = NULL;
+static uint64_t periodic_due_ms = 0;
+static bool in_periodic = false;
+
+static int relay_level = 1;
+static uint32_t uart_baud = 9600;
+static uint8_t uart_rx[32];
+static int uart_rx_len = 0;
+static uint64_t uart_rx_ready_ms = 0;   // When the last reply byte is on the wire
+
+void app_main(void);
+
+// --- Simulator ---
+int sim_load_csv(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    char line[128];
+    int added = 0;
+    while (fgets(line, sizeof(line), f)) {
+        sim_row_t r;
+        if (sscanf(line, "%f,%f,%f,%f,%f,%f", &r.voltage, &r.current, &r.power,
+                   &r.energy, &r.frequency, &r.pf) != 6) {
+            continue; // Header
+        }
+        sim_row_t *grown = realloc(rows, (row_count + 1) * sizeof(sim_row_t));
+        if (!grown) break;
+        rows = grown;
+        rows[row_count++] = r;
+        added++;
+    }
+    fclose(f);
+    return added;
+}
+
+uint32_t sim_row_count(void) {
+    return row_count;
+}
+
+uint64_t sim_now_ms(void) {
+    return now_ms;
+}
+
+static void check_end(void) {
+    if (now_ms >= (uint64_t)row_count * SIM_ROW_PERIOD_MS) {
+        sim_stats.virtual_ms = now_ms;
+        longjmp(sim_jmp, SIM_JMP_END);
+    }
+}
+
+void sim_run(void) {
+    memset(&sim_stats, 0, sizeof(sim_stats));
+    now_ms = 0;
+
+    for (;;) {
+        int code = setjmp(sim_jmp);
+        if (code == SIM_JMP_END) break;
+
+        // Cold boot or deep sleep wake: RAM is lost, RTC statics survive
+        boot_ms = now_ms;
+        sensor_task = NULL;
+        periodic_fn = NULL;
+        in_periodic = false;
+        uart_rx_len = 0;
+        sim_stats.boots++;
+
+        app_main();
+        if (sensor_task) {
+            sensor_task(NULL); // Only leaves through longjmp
+        }
+        hal_log('E', "SIM", "app_main returned without sleeping or starting sensor_task");
+        break;
+    }
+    dlog_flush();
+    sim_flush();
+    sim_wake_end();
+    sim_stats.virtual_ms = now_ms;
+}
+
+static bool log_enabled(char level) {
+    int needed = (level == 'E' || level == 'W') ? 0 : (level == 'I') ? 1 : 2;
+    return needed <= sim_log_level;
+}
+
+void hal_log(char level, const char *tag, const char *fmt, ...) {
+    if (!log_enabled(level)) return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    printf("[%10llu] %c (%s) ", (unsigned long long)now_ms, level, tag);
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+}
+
+void hal_log_record(char level, const char *tag, uint32_t ms, const char *text) {
+    if (!log_enabled(level)) return;
+    printf("[%10llu] %c (%s) %s\n", (unsigned long long)(boot_ms + ms), level, tag, text);
+}
+
+// --- Platform ---
+void hal_platform_init(void) {
+}
+
+void hal_task_create(hal_task_fn_t fn, const char *name, uint32_t stack, int prio, int core) {
+    // Only the sensor core is simulated, network tasks are stubbed
+    if (core == 1) {
+        sensor_task = fn;
+    } else {
+        hal_log('D', "SIM", "Not simulating task %s", name);
+    }
+}
+
+// The highest-priority task runs whenever it is due inside a delay of
+// the sensor task, the only other task that is simulated
+void hal_periodic_create(hal_periodic_fn_t fn, const char *name, uint32_t stack, int prio, int core) {
+    periodic_fn = fn;
+    periodic_due_ms = now_ms;
+}
+
+// Only the sensor core runs, so there is no stack or heap to report
+int hal_task_stats(hal_task_stat_t *out, int max) {
+    return 0;
+}
+
+uint32_t hal_heap_min_free(void) {
+    return 0;
+}
+
+const char *hal_device_id(void) {
+    return "sim";
+}
+
+// --- Time ---
+uint32_t hal_millis(void) {
+    return (uint32_t)(now_ms - boot_ms);
+}
+
+uint32_t hal_micros(void) {
+    return (uint32_t)((now_ms - boot_ms) * 1000);
+}
+
+static void idle_until(uint64_t t) {
+    if (t > now_ms) {
+        sim_stats.light_sleep_ms += t - now_ms;
+        now_ms = t;
+    }
+    check_end();
+}
+
+void hal_delay_ms(uint32_t ms) {
+    uint64_t until = now_ms + ms;
+    dlog_flush();   // The log task runs whenever the sensor task blocks
+    while (periodic_fn && !in_periodic && periodic_due_ms < until) {
+        idle_until(periodic_due_ms);
+        in_periodic = true;
+        uint32_t next = periodic_fn(hal_millis());
+        in_periodic = false;
+        periodic_due_ms = now_ms + (next ? next : 1);
+    }
+    idle_until(until);
+}
+
+uint32_t hal_rtc_millis(void) {
+    return (uint32_t)now_ms;
+}
+
+void hal_deep_sleep(uint64_t us) {
+    sim_wake_end();
+    sim_stats.deep_sleeps++;
+    sim_stats.deep_sleep_ms += us / 1000;
+    now_ms += us / 1000 + BOOT_TIME_MS;
+    check_end();
+    longjmp(sim_jmp, SIM_JMP_SLEEP);
+}
+
+// --- Relay ---
+void hal_relay_init(void) {
+}
+
+void hal_relay_set(int level) {
+    if (level != relay_level) {
+        sim_stats.relay_toggles++;
+        relay_level = level;
+    }
+}
+
+void hal_relay_hold(void) {
+}
+
+// --- PZEM Emulation ---
+static uint16_t sim_crc(const uint8_t *data, int len) {
+    uint16_t crc = 0xFFFF;
+    for (int pos = 0; pos < len; pos++) {
+        crc ^= data[pos];
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+static void put_u16(uint8_t *p, uint32_t v) {
+    p[0] = (v >> 8) & 0xFF;
+    p[1] = v & 0xFF;
+}
+
+// 32-bit values are sent low word first
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+void sim_row_data(uint32_t row, pzem_data_t *out) {
+    const sim_row_t *r = &rows[row];
+    out->voltage_dv = (uint16_t)(r->voltage * 10.0f + 0.5f);
+    out->current_ma = (uint32_t)(r->current * 1000.0f + 0.5f);
+    out->power_dw   = (uint32_t)(r->power * 10.0f + 0.5f);
+    out->energy_wh  = (uint32_t)(r->energy * 1000.0f + 0.5f);
+    out->freq_dhz   = (uint16_t)(r->frequency * 10.0f + 0.5f);
+    out->pf_cent    = (uint16_t)(r->pf * 100.0f + 0.5f);
+    out->valid = true;
+}
+
+// Holding register 0x0001, kept by the meter across power cycles
+static uint16_t meter_alarm_w = 2300;   // Factory value
+
+// Any run of the 10 input registers or the 2 holding registers, or a
+// write of the alarm threshold, like the meter
+static void build_response(uint8_t addr, uint8_t function, uint32_t row, uint16_t reg, uint16_t value) {
+    uint8_t regs[20];
+    uint8_t *f = uart_rx;
+    pzem_data_t d;
+    sim_row_data(row, &d);
+    put_u16(&regs[0], d.voltage_dv);
+    put_u32(&regs[2], d.current_ma);
+    put_u32(&regs[6], d.power_dw);
+    put_u32(&regs[10], d.energy_wh);
+    put_u16(&regs[14], d.freq_dhz);
+    put_u16(&regs[16], d.pf_cent);
+    put_u16(&regs[18], d.power_dw / 10 > meter_alarm_w ? 0xFFFF : 0); // Alarm status
+
+    f[0] = addr;
+    f[1] = function;
+    if (function == 0x06 && reg == 0x0001) {
+        meter_alarm_w = value;
+        put_u16(&f[2], reg);
+        put_u16(&f[4], value);
+        uart_rx_len = 8;
+    } else if (function == 0x03 && value > 0 && reg >= 0x0001 && reg + value <= 0x0003) {
+        uint8_t holding[4];
+        put_u16(&holding[0], meter_alarm_w);
+        put_u16(&holding[2], addr);
+        f[2] = value * 2;
+        memcpy(&f[3], &holding[(reg - 1) * 2], value * 2);
+        uart_rx_len = 5 + value * 2;
+    } else if (function == 0x04 && value > 0 && reg + value <= 10) {
+        f[2] = value * 2;
+        memcpy(&f[3], &regs[reg * 2], value * 2);
+        uart_rx_len = 5 + value * 2;
+    } else {
+        f[1] = function | 0x80;
+        f[2] = 0x02;    // Illegal address
+        uart_rx_len = 5;
+    }
+    uint16_t crc = sim_crc(f, uart_rx_len - 2);
+    f[uart_rx_len - 2] = crc & 0xFF;
+    f[uart_rx_len - 1] = crc >> 8;
+}
+
+static uint32_t wire_ms(int bytes) {
+    return (uint32_t)((bytes * 10 * 1000 + uart_baud - 1) / uart_baud);
+}
+
+void hal_uart_init(uint32_t baud) {
+    uart_baud = baud;
+}
+
+void hal_uart_flush_input(void) {
+    uart_rx_len = 0;
+}
+
+int hal_uart_write(const uint8_t *data, size_t len) {
+    sim_stats.uart_transactions++;
+    sim_stats.uart_bytes += len;
+    now_ms += wire_ms(len);
+    if (len == 8 && (data[1] == 0x03 || data[1] == 0x04 || data[1] == 0x06) && sim_crc(data, 8) == 0) {
+        uint32_t row = (uint32_t)(now_ms / SIM_ROW_PERIOD_MS);
+        if (row < row_count) {
+            build_response(data[0], data[1], row, (uint16_t)(data[2] << 8 | data[3]),
+                           (uint16_t)(data[4] << 8 | data[5]));
+            uart_rx_ready_ms = now_ms + wire_ms(uart_rx_len);
+            sim_stats.uart_bytes += uart_rx_len;
+        }
+    }
+    return (int)len;
+}
+
+// The reply is handed over whole once it has crossed the wire
+int hal_uart_read(uint8_t *data, size_t len, uint32_t timeout_ms) {
+    if (uart_rx_len == 0 || now_ms + timeout_ms < uart_rx_ready_ms) {
+        now_ms += timeout_ms;
+        check_end();
+        return 0;
+    }
+    if (now_ms < uart_rx_ready_ms) {
+        now_ms = uart_rx_ready_ms;
+    }
+    int n = (int)len < uart_rx_len ? (int)len : uart_rx_len;
+    memcpy(data, uart_rx, n);
+    uart_rx_len -= n;
+    memmove(uart_rx, uart_rx + n, uart_rx_len);
+    return n;
+}
+
+// --- Outbox storage: a file standing in for the flash partition ---
+static FILE *outbox_file = NULL;
+
+static FILE *get_outbox_file(void) {
+    if (!outbox_file && sim_outbox_path) {
+        outbox_file = fopen(sim_outbox_path, "r+b");
+        if (!outbox_file) {
+            // New "chip": fully erased
+            outbox_file = fopen(sim_outbox_path, "w+b");
+            if (outbox_file) {
+                uint8_t erased[256];
+                memset(erased, 0xFF, sizeof(erased));
+                for (uint32_t off = 0; off < sim_outbox_size; off += sizeof(erased)) {
+                    fwrite(erased, 1, sizeof(erased), outbox_file);
+                }
+            }
+        }
+    }
+    return outbox_file;
+}
+
+uint32_t hal_outbox_size(void) {
+    return get_outbox_file() ? sim_outbox_size : 0;
+}
+
+bool hal_outbox_read(uint32_t offset, void *buf, size_t len) {
+    FILE *f = get_outbox_file();
+    if (!f || offset + len > sim_outbox_size) return false;
+    fseek(f, offset, SEEK_SET);
+    return fread(buf, 1, len, f) == len;
+}
+
+bool hal_outbox_write(uint32_t offset, const void *buf, size_t len) {
+    uint8_t old[OUTBOX_IO_CHUNK];
+    const uint8_t *src = buf;
+    FILE *f = get_outbox_file();
+    if (!f || offset + len > sim_outbox_size) return false;
+
+    // NOR flash can only clear bits
+    while (len > 0) {
+        size_t n = len < sizeof(old) ? len : sizeof(old);
+        fseek(f, offset, SEEK_SET);
+        if (fread(old, 1, n, f) != n) return false;
+        for (size_t i = 0; i < n; i++) old[i] &= src[i];
+        fseek(f, offset, SEEK_SET);
+        if (fwrite(old, 1, n, f) != n) return false;
+        offset += n;
+        src += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool hal_outbox_erase(uint32_t offset, size_t len) {
+    uint8_t erased[OUTBOX_IO_CHUNK];
+    FILE *f = get_outbox_file();
+    if (!f || offset + len > sim_outbox_size) return false;
+
+    memset(erased, 0xFF, sizeof(erased));
+    fseek(f, offset, SEEK_SET);
+    while (len > 0) {
+        size_t n = len < sizeof(erased) ? len : sizeof(erased);
+        if (fwrite(erased, 1, n, f) != n) return false;
+        len -= n;
+    }
+    return true;
+}
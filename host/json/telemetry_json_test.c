@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "cJSON.h"
+#include "telemetry.h"
+#include "load_classifier.h"
+
+// JSON payload check against the real cJSON printer. For every trace row
+// and for random samples over the whole range of each register, the
+// payload of telemetry_serialize must be byte-identical to what
+// cJSON_PrintUnformatted gives for the same object built from doubles
+// (raw / scale), and cJSON_Parse must read back exactly raw / scale.
+//
+// It also builds each sample the way the firmware did before
+// src/telemetry.c: float fields rounded by roundto4, which cJSON prints
+// with "%1.17g" whenever "%1.15g" does not round-trip (230.1 became
+// 230.10000610351562). That form was dropped on purpose, so it is only
+// counted, not checked. Then both serializers are timed.
+//
+// Build (from the repo root), with the cJSON of ESP-IDF:
+//   cc -O2 -DHAL_HOST -Iinclude -I$IDF_PATH/components/json/cJSON -o telemetry_json_test host/json/telemetry_json_test.c src/telemetry.c src/load_classifier.c $IDF_PATH/components/json/cJSON/cJSON.c -lm
+// or with a system libcjson: -I/usr/include/cjson ... -lcjson instead of cJSON.c
+// Run:
+//   ./telemetry_json_test [-n random] [-r rounds] [dataset/*.csv ...]
+// Exits non-zero if a check fails.
+
+#define JSON_FIELDS 6
+#define BENCH_SAMPLES 20000        // Timed over the first ones only
+
+static const char *const field_name[JSON_FIELDS] = { "voltage", "current", "power", "energy", "frequency", "pf" };
+static const double field_scale[JSON_FIELDS] = {
+    PZEM_VOLTAGE_SCALE, PZEM_CURRENT_SCALE, PZEM_POWER_SCALE, PZEM_ENERGY_SCALE, PZEM_FREQ_SCALE, PZEM_PF_SCALE,
+};
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    printf("  %-52s %s\n", what, ok ? "pass" : "FAIL");
+    if (!ok) failures++;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void raw_fields(const pzem_data_t *d, uint32_t raw[JSON_FIELDS]) {
+    raw[0] = d->voltage_dv;
+    raw[1] = d->current_ma;
+    raw[2] = d->power_dw;
+    raw[3] = d->energy_wh;
+    raw[4] = d->freq_dhz;
+    raw[5] = d->pf_cent;
+}
+
+// --- Samples ---
+
+static telemetry_sample_t *samples = NULL;
+static int sample_count = 0;
+
+static void add_sample(const pzem_data_t *d, bool relay, uint8_t load_class) {
+    telemetry_sample_t *grown = realloc(samples, (sample_count + 1) * sizeof(telemetry_sample_t));
+    if (!grown) {
+        perror("realloc");
+        exit(1);
+    }
+    samples = grown;
+    samples[sample_count++] = (telemetry_sample_t){ .data = *d, .relay = relay, .load_class = load_class };
+}
+
+// As the emulated PZEM of the host simulator reports a row
+static int load_csv(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    char line[128];
+    int added = 0;
+    while (fgets(line, sizeof(line), f)) {
+        float v, a, w, kwh, hz, pf;
+        if (sscanf(line, "%f,%f,%f,%f,%f,%f", &v, &a, &w, &kwh, &hz, &pf) != 6) continue; // Header
+        pzem_data_t d = {
+            .voltage_dv = (uint16_t)(v * 10.0f + 0.5f),
+            .current_ma = (uint32_t)(a * 1000.0f + 0.5f),
+            .power_dw   = (uint32_t)(w * 10.0f + 0.5f),
+            .energy_wh  = (uint32_t)(kwh * 1000.0f + 0.5f),
+            .freq_dhz   = (uint16_t)(hz * 10.0f + 0.5f),
+            .pf_cent    = (uint16_t)(pf * 100.0f + 0.5f),
+            .valid = true,
+        };
+        add_sample(&d, sample_count & 1, load_classifier_predict(&d));
+        added++;
+    }
+    fclose(f);
+    return added;
+}
+
+static uint32_t xorshift(uint32_t *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+// Full register range, with small values and round numbers mixed in
+static uint32_t random_raw(uint32_t *rng, uint32_t max) {
+    uint32_t r = xorshift(rng);
+    switch (xorshift(rng) % 4) {
+    case 0:
+        r %= 1000;
+        break;
+    case 1:
+        r = r / 1000 * 1000;
+        break;
+    default:
+        break;
+    }
+    return max ? r % (max + 1) : r;
+}
+
+static void add_random(int count) {
+    uint32_t rng = 1;
+    for (int i = 0; i < count; i++) {
+        pzem_data_t d = {
+            .voltage_dv = random_raw(&rng, UINT16_MAX),
+            .current_ma = random_raw(&rng, 0),
+            .power_dw   = random_raw(&rng, 0),
+            .energy_wh  = random_raw(&rng, 0),
+            .freq_dhz   = random_raw(&rng, UINT16_MAX),
+            .pf_cent    = random_raw(&rng, UINT16_MAX),
+            .valid = true,
+        };
+        uint8_t load_class = xorshift(&rng) % (load_classifier_class_count() + 1);
+        if (load_class == load_classifier_class_count()) load_class = LOAD_CLASS_UNKNOWN;
+        add_sample(&d, xorshift(&rng) & 1, load_class);
+    }
+}
+
+// --- Reference ---
+
+static char *cjson_payload(const telemetry_sample_t *s, bool as_float) {
+    uint32_t raw[JSON_FIELDS];
+    const char *name = load_classifier_name(s->load_class);
+    cJSON *root = cJSON_CreateObject();
+
+    raw_fields(&s->data, raw);
+    for (int k = 0; k < JSON_FIELDS; k++) {
+        double value = raw[k] / field_scale[k];
+        if (as_float) {
+            // The old pzem_read_registers: float fields, all but frequency through roundto4
+            float f = (float)value;
+            if (k != 4) f = roundf(f * 10000.0f) / 10000.0f;
+            value = f;
+        }
+        cJSON_AddNumberToObject(root, field_name[k], value);
+    }
+    cJSON_AddBoolToObject(root, "relay", s->relay);
+    if (name) cJSON_AddStringToObject(root, "class", name);
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
+
+static bool parses_back(const telemetry_sample_t *s, const char *json) {
+    uint32_t raw[JSON_FIELDS];
+    cJSON *root = cJSON_Parse(json);
+    bool ok = root != NULL;
+
+    raw_fields(&s->data, raw);
+    for (int k = 0; ok && k < JSON_FIELDS; k++) {
+        const cJSON *item = cJSON_GetObjectItemCaseSensitive(root, field_name[k]);
+        ok = cJSON_IsNumber(item) && item->valuedouble == raw[k] / field_scale[k];
+    }
+    cJSON_Delete(root);
+    return ok;
+}
+
+// --- Checks ---
+
+static void test_payloads(void) {
+    uint8_t buf[TELEMETRY_JSON_MAX];
+    int differ = 0, unparsed = 0, old_differ = 0, overflow = 0;
+    long new_bytes = 0, old_bytes = 0;
+    char first_diff[2][TELEMETRY_JSON_MAX * 2] = { "", "" };
+
+    for (int i = 0; i < sample_count; i++) {
+        const telemetry_sample_t *s = &samples[i];
+        int len = telemetry_serialize(TELEMETRY_FMT_JSON, s, buf, sizeof(buf));
+        if (len < 0) {
+            overflow++;
+            continue;
+        }
+
+        char *ref = cjson_payload(s, false);
+        if (strlen(ref) != (size_t)len || memcmp(ref, buf, len) != 0) {
+            if (differ++ == 0) printf("  got  %s\n  want %s\n", (char *)buf, ref);
+        }
+        cJSON_free(ref);
+        unparsed += !parses_back(s, (char *)buf);
+
+        char *old = cjson_payload(s, true);
+        old_bytes += strlen(old);
+        new_bytes += len;
+        if (strcmp(old, (char *)buf) != 0 && old_differ++ == 0) {
+            snprintf(first_diff[0], sizeof(first_diff[0]), "%s", old);
+            snprintf(first_diff[1], sizeof(first_diff[1]), "%s", (char *)buf);
+        }
+        cJSON_free(old);
+    }
+
+    char what[64];
+    snprintf(what, sizeof(what), "%d samples fit in TELEMETRY_JSON_MAX", sample_count);
+    check(overflow == 0, what);
+    check(differ == 0, "byte-identical to cJSON over raw / scale");
+    check(unparsed == 0, "cJSON_Parse reads back raw / scale");
+
+    printf("Old float payload differs in %d of %d samples, %.1f vs %.1f bytes per message\n", old_differ,
+           sample_count, (double)old_bytes / sample_count, (double)new_bytes / sample_count);
+    if (old_differ) printf("  old  %s\n  new  %s\n", first_diff[0], first_diff[1]);
+}
+
+// --- Timing ---
+
+static volatile size_t sink;
+
+static void bench(int rounds) {
+    uint8_t buf[TELEMETRY_JSON_MAX];
+    const int count = sample_count < BENCH_SAMPLES ? sample_count : BENCH_SAMPLES;
+    size_t acc = 0;
+
+    uint64_t start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count; i++) {
+            acc += telemetry_serialize(TELEMETRY_FMT_JSON, &samples[i], buf, sizeof(buf));
+        }
+    }
+    double ours = (double)(now_ns() - start) / ((double)rounds * count);
+
+    start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count; i++) {
+            char *json = cjson_payload(&samples[i], true);
+            acc += strlen(json);
+            cJSON_free(json);
+        }
+    }
+    double cjson = (double)(now_ns() - start) / ((double)rounds * count);
+    sink = acc;
+
+    printf("Serialize, %d x %d samples (host):\n", rounds, count);
+    printf("  %-20s %7.1f ns/msg\n", "cJSON, heap", cjson);
+    printf("  %-20s %7.1f ns/msg  x%.1f\n", "telemetry_serialize", ours, cjson / ours);
+}
+
+int main(int argc, char **argv) {
+    int random_count = 200000;
+    int rounds = 20;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            random_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else if (argv[i][0] != '-') {
+            if (load_csv(argv[i]) < 0) {
+                perror(argv[i]);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Usage: %s [-n random] [-r rounds] [dataset/*.csv ...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (random_count > 0) add_random(random_count);
+    if (sample_count == 0) {
+        fprintf(stderr, "No samples\n");
+        return 1;
+    }
+    if (rounds < 1) rounds = 1;
+
+    printf("JSON payload against cJSON_PrintUnformatted:\n");
+    test_payloads();
+    bench(rounds);
+
+    free(samples);
+    if (failures) printf("%d checks failed\n", failures);
+    return failures != 0;
+}
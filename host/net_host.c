@@ -0,0 +1,221 @@
+#include "hal.h"
+#include "sim.h"
+#include "wifi_manager.h"
+#include "mqtt_manager.h"
+#include "ota_manager.h"
+#include "telemetry.h"
+#include "rtc_journal.h"
+#include "metrics.h"
+#include "wake_trace.h"
+#include "rollup.h"
+#include <stdlib.h>
+
+// Network stubs for the host simulator: nothing leaves the process,
+// publishes and full wakes are only counted.
+//
+// Connecting takes no simulated time, but each stage is stamped into the
+// wake trace at the time it would take on a device, so the time to first
+// publish can be measured. Samples sent before the session is up count
+// as published the moment it is. Typical ESP32 figures:
+#define SIM_WIFI_START_MS    80    // esp_wifi_init and start, PHY calibration
+#define SIM_WIFI_SCAN_MS   1200    // Active scan of all channels
+#define SIM_WIFI_PROBE_MS    20    // Known BSSID on a known channel
+#define SIM_WIFI_ASSOC_MS   150    // Authentication, association, WPA2 handshake
+#define SIM_DHCP_MS         600
+#define SIM_MQTT_CONNECT_MS 250    // DNS, TCP and CONNACK
+
+static const char *TAG = "NET_HOST";
+static uint32_t ip_ms;
+static uint32_t mqtt_up_ms;
+static bool mqtt_up = false;
+RTC_DATA_ATTR static bool ap_cached = false;
+RTC_DATA_ATTR static uint32_t ap_cached_ms;
+
+// Same cache rule as wifi_manager.c: the AP and lease of the last DHCP
+void wifi_init_sta(wifi_connected_fn_t on_connected) {
+    uint32_t t = hal_millis();
+    bool cached = ap_cached && hal_rtc_millis() - ap_cached_ms < WIFI_CACHE_MAX_AGE_MS;
+
+    sim_stats.full_wakes++;
+    wake_trace_mark_at(WAKE_WIFI_START, t);
+    wake_trace_set_cached(cached);
+    t += SIM_WIFI_START_MS + (cached ? SIM_WIFI_PROBE_MS : SIM_WIFI_SCAN_MS) + SIM_WIFI_ASSOC_MS;
+    wake_trace_mark_at(WAKE_ASSOCIATED, t);
+    if (!cached) {
+        t += SIM_DHCP_MS;
+        ap_cached = true;
+        ap_cached_ms = hal_rtc_millis() + (t - hal_millis());
+    }
+    wake_trace_mark_at(WAKE_GOT_IP, t);
+    ip_ms = t;
+    on_connected();
+}
+
+void mqtt_manager_init(void) {
+    mqtt_up = false;
+}
+
+// The sleep journal goes out as soon as the session is up
+void mqtt_manager_start(void) {
+    uint8_t journal[RTC_JOURNAL_EXPORT_MAX];
+    mqtt_up_ms = ip_ms + SIM_MQTT_CONNECT_MS;
+    mqtt_up = true;
+    wake_trace_mark_at(WAKE_MQTT_CONNECTED, mqtt_up_ms);
+    if (rtc_journal_count() == 0) return;
+
+    int len = rtc_journal_export(journal, sizeof(journal));
+    if (len < 0) return;
+    sim_stats.publishes++;
+    metrics_inc(METRIC_PUBLISHES);
+    sim_stats.payload_bytes += len;
+    sim_stats.journal_samples += rtc_journal_count();
+    ESP_LOGD(TAG, "JOURNAL %lu samples, %d bytes", (unsigned long)rtc_journal_count(), len);
+    rtc_journal_clear();
+}
+
+static telemetry_batch_t batch;
+static uint64_t *sent_ms = NULL;
+static uint32_t sent_count = 0;
+static uint32_t sent_cap = 0;
+
+const uint64_t *sim_sent_times(uint32_t *count) {
+    *count = sent_count;
+    return sent_ms;
+}
+
+static void mark_first_publish(void) {
+    uint32_t now = hal_millis();
+    if (mqtt_up) {
+        wake_trace_mark_at(WAKE_FIRST_PUBLISH, now > mqtt_up_ms ? now : mqtt_up_ms);
+    }
+}
+
+// Called at each deep sleep and at the end, adds a full wake's trace
+void sim_wake_end(void) {
+    char text[WAKE_TRACE_TEXT_MAX];
+    uint32_t ms;
+    if (!wake_trace_get(WAKE_WIFI_START, &ms)) return;
+
+    sim_wake_stats_t *w = &sim_stats.wakes[wake_trace_cached() ? 1 : 0];
+    w->count++;
+    for (int i = 0; i < WAKE_PHASE_COUNT; i++) {
+        if (wake_trace_get((wake_phase_t)i, &ms)) {
+            w->phase_sum_ms[i] += ms;
+        }
+    }
+    if (wake_trace_get(WAKE_FIRST_PUBLISH, &ms) && ms > w->first_publish_max_ms) {
+        w->first_publish_max_ms = ms;
+    }
+    if (wake_trace_format(text, sizeof(text)) >= 0) {
+        ESP_LOGD(TAG, "Wake: %s", text);
+    }
+    wake_trace_begin();
+}
+
+// Same batching rules as mqtt_publisher_task. The deadline is only
+// checked when a sample arrives, and by sim_flush() at the end.
+static void publish_batch(void) {
+    static uint8_t payload[TELEMETRY_BATCH_BUF_SIZE];
+    int len;
+
+    if (batch.count == 0) return;
+    if (batch.count == 1) {
+        len = telemetry_serialize(sim_payload_format, &batch.samples[0], payload, sizeof(payload));
+    } else {
+        len = telemetry_serialize_batch(sim_payload_format, &batch, payload, sizeof(payload));
+    }
+    if (len < 0) {
+        ESP_LOGE(TAG, "Payload does not fit");
+    } else {
+        sim_stats.publishes++;
+        metrics_inc(METRIC_PUBLISHES);
+        sim_stats.payload_bytes += len;
+        if (sim_payload_format == TELEMETRY_FMT_JSON) {
+            ESP_LOGD(TAG, "PUBLISH %s", (const char *)payload);
+        } else {
+            ESP_LOGD(TAG, "PUBLISH %d bytes", len);
+        }
+    }
+    batch.count = 0;
+}
+
+void sim_flush(void) {
+    publish_batch();
+}
+
+void mqtt_send_pzem_data(pzem_data_t data, bool relay_state, uint8_t load_class) {
+    telemetry_sample_t sample = {
+        .ts_ms = (uint32_t)sim_now_ms(),
+        .data = data,
+        .relay = relay_state,
+        .load_class = load_class,
+    };
+    sim_stats.samples_sent++;
+    if (sent_count == sent_cap) {
+        uint32_t cap = sent_cap ? sent_cap * 2 : 1024;
+        uint64_t *grown = realloc(sent_ms, cap * sizeof(uint64_t));
+        if (grown) {
+            sent_ms = grown;
+            sent_cap = cap;
+        }
+    }
+    if (sent_count < sent_cap) {
+        sent_ms[sent_count++] = sim_now_ms();
+    }
+    if (load_class < SIM_CLASS_MAX) {
+        sim_stats.class_samples[load_class]++;
+    }
+    mark_first_publish();
+
+    if (telemetry_batch_expired(&batch, sample.ts_ms, sim_batch_latency_ms)) {
+        publish_batch();
+    }
+    if (telemetry_batch_add(&batch, &sample, sim_batch_max)) {
+        publish_batch();
+    }
+}
+
+void mqtt_send_grid_event(const grid_event_t *event) {
+    char json[GRID_EVENT_JSON_MAX];
+    sim_stats.grid_events++;
+    sim_stats.publishes++;
+    mark_first_publish();
+    metrics_inc(METRIC_PUBLISHES);
+    int len = grid_event_json(event, json, sizeof(json));
+    if (len > 0) {
+        sim_stats.payload_bytes += len;
+        ESP_LOGD(TAG, "EVENT %s", json);
+    }
+}
+
+// Closed buckets not sent yet, as many per message as fit, like the publisher
+void mqtt_send_rollups(void) {
+    static char json[ROLLUP_JSON_MAX];
+    static uint32_t sent[ROLLUP_LEVELS];
+    rollup_bucket_t buckets[ROLLUP_MINUTES];
+
+    for (int level = 0; level < ROLLUP_LEVELS; level++) {
+        uint32_t seq = sent[level], end = rollup_closed(level);
+        if ((int32_t)(rollup_oldest(level) - seq) > 0) seq = rollup_oldest(level);
+        int n = 0, done;
+        for (; seq != end && n < ROLLUP_MINUTES; seq++) {
+            if (rollup_get(level, seq, &buckets[n])) n++;
+        }
+        sent[level] = seq;
+        for (int i = 0; i < n; i += done) {
+            int len = rollup_render(level, buckets + i, n - i, hal_rtc_millis(), json, sizeof(json), &done);
+            if (len < 0) break;
+            sim_stats.rollup_messages++;
+            sim_stats.publishes++;
+            metrics_inc(METRIC_PUBLISHES);
+            sim_stats.payload_bytes += len;
+            ESP_LOGD(TAG, "ROLLUP %s", json);
+        }
+    }
+}
+
+void mqtt_publisher_task(void *arg) {
+}
+
+void ota_task(void *pvParam) {
+}
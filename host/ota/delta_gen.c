@@ -0,0 +1,172 @@
+#include <stdlib.h>
+#include <string.h>
+#include "delta_gen.h"
+#include "ota_delta.h"
+
+#define BLOCK        8          // Bytes hashed per source position
+#define HASH_BITS    20
+#define CHAIN_MAX    32         // Candidates tried per target position
+#define MATCH_MIN    12
+#define GIVE_UP      64         // Approximate match ends this long after its best point
+#define MERGE_GAP    1          // Equal bytes worth sending as zero adds to save a fixup
+
+static void put(delta_patch_t *p, uint8_t c) {
+    if (p->len == p->cap) {
+        p->cap = p->cap ? p->cap * 2 : 4096;
+        p->data = realloc(p->data, p->cap);
+    }
+    p->data[p->len++] = c;
+}
+
+static void put_bytes(delta_patch_t *p, const uint8_t *data, size_t len) {
+    while (len--) put(p, *data++);
+}
+
+static void put_varint(delta_patch_t *p, uint32_t v) {
+    while (v >= 0x80) {
+        put(p, (uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    put(p, (uint8_t)v);
+}
+
+static void put_u32(delta_patch_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) put(p, (uint8_t)(v >> (8 * i)));
+}
+
+static uint32_t hash_block(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return (uint32_t)((v * 0x9E3779B97F4A7C15ull) >> (64 - HASH_BITS));
+}
+
+static void put_data(delta_patch_t *p, const uint8_t *data, size_t len) {
+    if (len == 0) return;
+    put(p, OTA_DELTA_OP_DATA);
+    put_varint(p, (uint32_t)len);
+    put_bytes(p, data, len);
+    p->literal += len;
+}
+
+// Extends a match allowing differences, like bsdiff: keeps the length
+// where (matching - differing) bytes peaked
+static size_t extend(const uint8_t *src, size_t src_len, size_t s, const uint8_t *dst, size_t dst_len, size_t t) {
+    size_t best = 0;
+    long score = 0, best_score = 0;
+    for (size_t i = 0; s + i < src_len && t + i < dst_len; i++) {
+        score += (src[s + i] == dst[t + i]) ? 1 : -1;
+        if (score > best_score) {
+            best_score = score;
+            best = i + 1;
+        } else if (i + 1 - best > GIVE_UP) {
+            break;
+        }
+    }
+    return best;
+}
+
+static void put_diff(delta_patch_t *p, const uint8_t *src, size_t s, size_t *source_pos,
+                     const uint8_t *dst, size_t t, size_t len) {
+    // Runs of differing bytes, close runs merged
+    size_t *starts = malloc((len / 2 + 1) * sizeof(size_t));
+    size_t *ends = malloc((len / 2 + 1) * sizeof(size_t));
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (src[s + i] == dst[t + i]) continue;
+        if (n && i - ends[n - 1] <= MERGE_GAP) {
+            ends[n - 1] = i + 1;
+        } else {
+            starts[n] = i;
+            ends[n++] = i + 1;
+        }
+    }
+
+    int64_t move = (int64_t)s - (int64_t)*source_pos;
+    put(p, OTA_DELTA_OP_DIFF);
+    put_varint(p, (uint32_t)((move << 1) ^ (move >> 63)));
+    put_varint(p, (uint32_t)len);
+    put_varint(p, (uint32_t)n);
+    for (size_t i = 0, at = 0; i < n; i++) {
+        // Skip and a short count share one varint
+        uint32_t skip = (uint32_t)(starts[i] - at), count = (uint32_t)(ends[i] - starts[i]);
+        put_varint(p, skip << 3 | (count < 8 ? count - 1 : 7));
+        if (count >= 8) put_varint(p, count - 8);
+        for (size_t j = starts[i]; j < ends[i]; j++) {
+            put(p, (uint8_t)(dst[t + j] - src[s + j]));
+        }
+        at = ends[i];
+    }
+    free(starts);
+    free(ends);
+    *source_pos = s + len;
+    p->diffs++;
+    p->fixups += n;
+    p->copied += len;
+}
+
+void delta_generate(const uint8_t *src, size_t src_len, const uint8_t *dst, size_t dst_len, delta_patch_t *p) {
+    uint8_t digest[SHA256_DIGEST_LEN];
+    sha256_ctx_t ctx;
+    uint32_t *head = calloc(1u << HASH_BITS, sizeof(uint32_t));
+    uint32_t *chain = calloc(src_len + 1, sizeof(uint32_t));
+
+    memset(p, 0, sizeof(*p));
+    put_bytes(p, (const uint8_t *)OTA_DELTA_MAGIC, 4);
+    put_u32(p, (uint32_t)src_len);
+    put_u32(p, (uint32_t)dst_len);
+    sha256_init(&ctx);
+    sha256_update(&ctx, src, src_len);
+    sha256_final(&ctx, digest);
+    put_bytes(p, digest, sizeof(digest));
+    sha256_init(&ctx);
+    sha256_update(&ctx, dst, dst_len);
+    sha256_final(&ctx, digest);
+    put_bytes(p, digest, sizeof(digest));
+
+    // Positions stored +1, 0 ends a chain. Later positions first.
+    for (size_t i = 0; i + BLOCK <= src_len; i++) {
+        uint32_t h = hash_block(src + i);
+        chain[i + 1] = head[h];
+        head[h] = (uint32_t)(i + 1);
+    }
+
+    size_t t = 0, literal_start = 0, source_pos = 0;
+    int64_t diagonal = 0;        // Source minus target offset of the last match
+    while (t + BLOCK <= dst_len) {
+        size_t best_s = 0, best_len = 0;
+
+        // Code after an insertion keeps the offset of the code before it
+        int64_t s0 = (int64_t)t + diagonal;
+        if (s0 >= 0 && (size_t)s0 + BLOCK <= src_len && memcmp(src + s0, dst + t, BLOCK) == 0) {
+            best_s = (size_t)s0;
+            best_len = extend(src, src_len, best_s, dst, dst_len, t);
+        }
+        uint32_t at = head[hash_block(dst + t)];
+        for (int tries = 0; at && tries < CHAIN_MAX; tries++, at = chain[at]) {
+            size_t s = at - 1, len = 0;
+            while (s + len < src_len && t + len < dst_len && src[s + len] == dst[t + len]) len++;
+            if (len >= BLOCK && len > best_len) {
+                size_t approx = extend(src, src_len, s, dst, dst_len, t);
+                if (approx > best_len) {
+                    best_s = s;
+                    best_len = approx;
+                }
+            }
+        }
+
+        if (best_len < MATCH_MIN) {
+            t++;
+            continue;
+        }
+        put_data(p, dst + literal_start, t - literal_start);
+        put_diff(p, src, best_s, &source_pos, dst, t, best_len);
+        diagonal = (int64_t)best_s - (int64_t)t;
+        t += best_len;
+        literal_start = t;
+    }
+    put_data(p, dst + literal_start, dst_len - literal_start);
+    put(p, OTA_DELTA_OP_END);
+
+    free(head);
+    free(chain);
+}
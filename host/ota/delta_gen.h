@@ -0,0 +1,20 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Patch generator for src/ota_delta.c (format in include/ota_delta.h).
+// Host only: indexes the old image in RAM.
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+    // What went into it
+    uint32_t diffs;
+    uint32_t fixups;
+    uint64_t copied;             // Target bytes taken from the source
+    uint64_t literal;            // Target bytes sent as DATA
+} delta_patch_t;
+
+// Builds the patch turning src into dst; free patch->data afterwards
+void delta_generate(const uint8_t *src, size_t src_len, const uint8_t *dst, size_t dst_len, delta_patch_t *patch);
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "delta_gen.h"
+
+// Writes the delta patch from the running image to a new one, to be
+// published next to the full image (manifest keys patch_from, patch_url).
+//
+// Build (from the repo root):
+//   cc -O2 -Iinclude -Ihost/ota -o delta_make host/ota/delta_make.c host/ota/delta_gen.c src/sha256.c
+// Run:
+//   ./delta_make old.bin new.bin patch.bin
+
+static uint8_t *load(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    uint8_t *data = NULL;
+    long size;
+
+    if (!f) return NULL;
+    if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+        data = malloc(size ? (size_t)size : 1);
+        if (data && fread(data, 1, (size_t)size, f) != (size_t)size) {
+            free(data);
+            data = NULL;
+        }
+        *len = (size_t)size;
+    }
+    fclose(f);
+    return data;
+}
+
+int main(int argc, char **argv) {
+    size_t old_len, new_len;
+    delta_patch_t patch;
+
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s old.bin new.bin patch.bin\n", argv[0]);
+        return 1;
+    }
+    uint8_t *old_image = load(argv[1], &old_len);
+    uint8_t *new_image = load(argv[2], &new_len);
+    if (!old_image || !new_image) {
+        perror("read");
+        return 1;
+    }
+
+    delta_generate(old_image, old_len, new_image, new_len, &patch);
+    FILE *f = fopen(argv[3], "wb");
+    if (!f || fwrite(patch.data, 1, patch.len, f) != patch.len || fclose(f) != 0) {
+        perror(argv[3]);
+        return 1;
+    }
+    printf("%zu -> %zu bytes, patch %zu bytes (%.1f%% of the image): %u diffs, %u fixups, %llu bytes literal\n",
+           old_len, new_len, patch.len, 100.0 * patch.len / (new_len ? new_len : 1), patch.diffs, patch.fixups,
+           (unsigned long long)patch.literal);
+    free(patch.data);
+    free(old_image);
+    free(new_image);
+    return 0;
+}
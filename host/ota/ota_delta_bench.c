@@ -0,0 +1,404 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "delta_gen.h"
+#include "ota_delta.h"
+
+// Delta OTA test and benchmark. Two app images (synthetic by default, or
+// real ones from the command line) are diffed with delta_gen.c, and the
+// patch is applied by src/ota_delta.c between file-backed "partitions":
+// the running one read at random offsets, the update one written in
+// order, the patch fed in TCP-segment sized pieces as the HTTP client
+// would. The full image goes through the same write and hash path for
+// comparison.
+//
+// The synthetic images mimic an ESP32 app: functions with literal pools of
+// absolute addresses and PC-relative calls, a string table, and the image
+// hash at the end. The new one changes a few functions, inserts some,
+// grows others and bumps the version string, so most code moves.
+//
+// Also checked: every piece size gives the same image, and a corrupted
+// or truncated patch, a different running image or a failing flash
+// write never ends in OTA_DELTA_DONE (the firmware then falls back to
+// the full image).
+//
+// Build (from the repo root):
+//   cc -O2 -Iinclude -Ihost/ota -o ota_delta_bench host/ota/ota_delta_bench.c host/ota/delta_gen.c src/ota_delta.c src/sha256.c
+// Run:
+//   ./ota_delta_bench [-k link_kbit_s] [old.bin new.bin]
+// Exits non-zero on any mismatch.
+
+#define SEGMENT          1460     // Patch bytes per feed, one TCP segment
+#define FUNCTIONS        4000
+#define STRINGS          3000
+#define IROM_BASE        0x400D0020u
+#define DROM_BASE        0x3F400020u
+
+// --- Synthetic images ---
+
+typedef struct {
+    uint32_t seed;
+    uint32_t id;                  // Callers refer to ids, not positions
+    uint16_t len;
+} func_t;
+
+typedef struct {
+    func_t funcs[FUNCTIONS + 64];
+    int nfuncs;
+    uint32_t string_seed[STRINGS + 64];
+    int nstrings;
+    const char *version;
+} model_t;
+
+static uint32_t rng(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    memcpy(p, &v, 4);
+}
+
+static size_t build_image(const model_t *m, uint8_t *out) {
+    static uint32_t addr_of[FUNCTIONS + 64];
+    static uint32_t string_addr[STRINGS + 64];
+    uint32_t at = 0;
+
+    // Layout first, so pointers can be filled in
+    for (int i = 0; i < m->nfuncs; i++) {
+        addr_of[m->funcs[i].id] = IROM_BASE + 24 + at;
+        at += (m->funcs[i].len + 3u) & ~3u;
+    }
+    size_t code_len = at;
+    size_t rodata = 24 + code_len;
+    at = 0;
+    for (int i = 0; i < m->nstrings; i++) {
+        string_addr[i] = DROM_BASE + at;
+        at += 8 + m->string_seed[i] % 40;
+    }
+
+    // Header: magic, segment count, entry point
+    size_t n = 0;
+    memset(out, 0, 24);
+    out[0] = 0xE9;
+    out[1] = 2;
+    put32(out + 4, addr_of[m->funcs[0].id]);
+    n = 24;
+
+    for (int i = 0; i < m->nfuncs; i++) {
+        const func_t *f = &m->funcs[i];
+        uint32_t s = f->seed, here = addr_of[f->id];
+        size_t end = n + ((f->len + 3u) & ~3u);
+        // Literal pool: absolute addresses of callees and strings
+        int pool = 1 + s % 6;
+        for (int k = 0; k < pool && n + 4 <= end; k++) {
+            uint32_t r = rng(&s);
+            uint32_t target = (r & 1) ? addr_of[r % (FUNCTIONS / 2)] : string_addr[r % (STRINGS / 2)];
+            put32(out + n, target);
+            n += 4;
+        }
+        // Code: 3-byte instructions from a small set, with CALL8s
+        while (n + 3 <= end) {
+            uint32_t r = rng(&s);
+            if (r % 7 == 0) {
+                int32_t rel = (int32_t)(addr_of[(r >> 8) % (FUNCTIONS / 2)] - ((here + (n - 24)) & ~3u)) >> 2;
+                out[n] = (uint8_t)(0x25 | (rel & 0x3) << 6);
+                out[n + 1] = (uint8_t)(rel >> 2);
+                out[n + 2] = (uint8_t)(rel >> 10);
+            } else {
+                static const uint8_t ops[16] = { 0x0c, 0x1c, 0x22, 0x32, 0x42, 0x62, 0x66, 0x80,
+                                                  0x90, 0xa0, 0xa2, 0xb0, 0xc0, 0xd0, 0xe0, 0xf0 };
+                out[n] = ops[r % 16];
+                out[n + 1] = (uint8_t)((r >> 4) & 0x3F);
+                out[n + 2] = (uint8_t)((r >> 12) & 0x1F);
+            }
+            n += 3;
+        }
+        while (n < end) out[n++] = 0;
+    }
+
+    // Strings
+    n = rodata;
+    for (int i = 0; i < m->nstrings; i++) {
+        uint32_t s = m->string_seed[i];
+        size_t len = 8 + s % 40;
+        if (i == 0) {
+            n += (size_t)snprintf((char *)out + n, len, "fw %s", m->version) + 1;
+            memset(out + n, 0, len - (size_t)snprintf(NULL, 0, "fw %s", m->version) - 1);
+            n = rodata + len;
+            rodata = n;
+            continue;
+        }
+        for (size_t k = 0; k + 1 < len; k++) {
+            out[n++] = (uint8_t)("etaoinshrdlu _:%d"[rng(&s) % 17]);
+        }
+        out[n++] = 0;
+        rodata = n;
+    }
+
+    // Appended image hash, changes completely with any byte
+    sha256_ctx_t ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, out, n);
+    sha256_final(&ctx, out + n);
+    return n + SHA256_DIGEST_LEN;
+}
+
+static void make_models(model_t *old_m, model_t *new_m) {
+    uint32_t s = 12345;
+
+    old_m->nfuncs = FUNCTIONS;
+    for (int i = 0; i < FUNCTIONS; i++) {
+        old_m->funcs[i] = (func_t){ rng(&s), (uint32_t)i, (uint16_t)(24 + rng(&s) % 360) };
+    }
+    old_m->nstrings = STRINGS;
+    for (int i = 0; i < STRINGS; i++) old_m->string_seed[i] = rng(&s);
+    old_m->version = "3.0";
+
+    // A typical point release
+    *new_m = *old_m;
+    new_m->version = "3.1";
+    for (int k = 0; k < 40; k++) {                    // 1 % of functions rewritten
+        new_m->funcs[rng(&s) % FUNCTIONS].seed = rng(&s);
+    }
+    for (int k = 0; k < 20; k++) {                    // Some grow
+        new_m->funcs[rng(&s) % FUNCTIONS].len += 40;
+    }
+    for (int k = 0; k < 8; k++) {                     // New functions
+        int at = (int)(rng(&s) % (uint32_t)new_m->nfuncs);
+        memmove(&new_m->funcs[at + 1], &new_m->funcs[at], (size_t)(new_m->nfuncs - at) * sizeof(func_t));
+        new_m->funcs[at] = (func_t){ rng(&s), (uint32_t)new_m->nfuncs, (uint16_t)(64 + rng(&s) % 200) };
+        new_m->nfuncs++;
+    }
+    for (int k = 0; k < 10; k++) {                    // New strings
+        new_m->string_seed[new_m->nstrings++] = rng(&s);
+    }
+}
+
+// --- File-backed partitions ---
+
+typedef struct {
+    int source_fd;
+    int target_fd;
+    uint64_t read_bytes;
+    uint32_t reads;
+    bool fail_writes;
+} partitions_t;
+
+static bool part_read(void *ctx, uint32_t offset, void *buf, size_t len) {
+    partitions_t *p = ctx;
+    p->reads++;
+    p->read_bytes += len;
+    return pread(p->source_fd, buf, len, offset) == (ssize_t)len;
+}
+
+static bool part_write(void *ctx, const void *buf, size_t len) {
+    partitions_t *p = ctx;
+    return !p->fail_writes && write(p->target_fd, buf, len) == (ssize_t)len;
+}
+
+static int temp_file(const uint8_t *data, size_t len) {
+    char path[] = "/tmp/ota_delta_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return -1;
+    unlink(path);
+    if (len && write(fd, data, len) != (ssize_t)len) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool target_is(int fd, const uint8_t *expect, size_t len) {
+    uint8_t *got = malloc(len + 1);
+    bool same = pread(fd, got, len + 1, 0) == (ssize_t)len && memcmp(got, expect, len) == 0;
+    free(got);
+    return same;
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Feeds the patch in pieces of the given size into an empty target
+static ota_delta_status_t apply(const uint8_t *patch, size_t len, size_t piece, int source_fd,
+                                partitions_t *parts, bool fail_writes) {
+    static ota_delta_t d;
+    ota_delta_status_t status = OTA_DELTA_MORE;
+
+    memset(parts, 0, sizeof(*parts));
+    parts->source_fd = source_fd;
+    parts->target_fd = temp_file(NULL, 0);
+    parts->fail_writes = fail_writes;
+    ota_delta_init(&d, part_read, part_write, parts);
+    for (size_t off = 0; off < len && status == OTA_DELTA_MORE; off += piece) {
+        status = ota_delta_feed(&d, patch + off, off + piece <= len ? piece : len - off);
+    }
+    return status;
+}
+
+// What esp_https_ota does with the full image: write and hash it
+static double full_image_ms(const uint8_t *image, size_t len) {
+    uint8_t digest[SHA256_DIGEST_LEN];
+    sha256_ctx_t ctx;
+    int fd = temp_file(NULL, 0);
+    double start = now_ms();
+
+    sha256_init(&ctx);
+    for (size_t off = 0; off < len; off += SEGMENT) {
+        size_t n = off + SEGMENT <= len ? SEGMENT : len - off;
+        sha256_update(&ctx, image + off, n);
+        if (write(fd, image + off, n) != (ssize_t)n) break;
+    }
+    sha256_final(&ctx, digest);
+    double ms = now_ms() - start;
+    close(fd);
+    return ms;
+}
+
+static uint8_t *load(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    uint8_t *data = NULL;
+    long size;
+
+    if (!f) return NULL;
+    if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+        data = malloc(size ? (size_t)size : 1);
+        if (data && fread(data, 1, (size_t)size, f) != (size_t)size) {
+            free(data);
+            data = NULL;
+        }
+        *len = (size_t)size;
+    }
+    fclose(f);
+    return data;
+}
+
+static int expect_status(const char *what, ota_delta_status_t got, ota_delta_status_t want) {
+    printf("  %-28s %-20s %s\n", what, ota_delta_status_name(got), got == want ? "ok" : "FAIL");
+    return got != want;
+}
+
+int main(int argc, char **argv) {
+    static model_t old_m, new_m;
+    const char *paths[2] = { NULL, NULL };
+    int npaths = 0, failed = 0;
+    double kbit_s = 1000;
+    uint8_t *old_image, *new_image;
+    size_t old_len, new_len;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            kbit_s = atof(argv[++i]);
+        } else if (argv[i][0] != '-' && npaths < 2) {
+            paths[npaths++] = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s [-k link_kbit_s] [old.bin new.bin]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (npaths == 2) {
+        old_image = load(paths[0], &old_len);
+        new_image = load(paths[1], &new_len);
+        if (!old_image || !new_image) {
+            perror("read");
+            return 1;
+        }
+    } else if (npaths == 0) {
+        old_image = malloc(2 << 20);
+        new_image = malloc(2 << 20);
+        make_models(&old_m, &new_m);
+        old_len = build_image(&old_m, old_image);
+        new_len = build_image(&new_m, new_image);
+    } else {
+        fprintf(stderr, "Give both images or neither\n");
+        return 1;
+    }
+
+    delta_patch_t patch;
+    double start = now_ms();
+    delta_generate(old_image, old_len, new_image, new_len, &patch);
+    double gen_ms = now_ms() - start;
+
+    int source_fd = temp_file(old_image, old_len);
+    partitions_t parts;
+    start = now_ms();
+    ota_delta_status_t status = apply(patch.data, patch.len, SEGMENT, source_fd, &parts, false);
+    double apply_ms = now_ms() - start;
+    bool same = status == OTA_DELTA_DONE && target_is(parts.target_fd, new_image, new_len);
+    close(parts.target_fd);
+    double full_ms = full_image_ms(new_image, new_len);
+
+    printf("images: %zu -> %zu bytes%s\n", old_len, new_len, npaths ? "" : " (synthetic)");
+    printf("patch:  %zu bytes, %.1f%% of the full image: %u diffs, %u fixups, %llu bytes literal, made in %.0f ms\n",
+           patch.len, 100.0 * patch.len / new_len, patch.diffs, patch.fixups,
+           (unsigned long long)patch.literal, gen_ms);
+    printf("apply:  %s, %.1f ms (full image write+hash %.1f ms), %u source reads / %llu bytes, %zu bytes of state\n",
+           same ? "image matches" : "IMAGE DIFFERS", apply_ms, full_ms, parts.reads,
+           (unsigned long long)parts.read_bytes, sizeof(ota_delta_t));
+    printf("radio:  %.1f s for the patch vs %.1f s for the full image at %.0f kbit/s\n",
+           patch.len * 8 / kbit_s / 1000, new_len * 8 / kbit_s / 1000, kbit_s);
+    failed |= !same;
+
+    printf("pieces:\n");
+    static const size_t pieces[] = { 1, 7, 64, 4096 };
+    for (size_t i = 0; i < sizeof(pieces) / sizeof(pieces[0]); i++) {
+        char what[32];
+        snprintf(what, sizeof(what), "%zu byte pieces", pieces[i]);
+        status = apply(patch.data, patch.len, pieces[i], source_fd, &parts, false);
+        if (status == OTA_DELTA_DONE && !target_is(parts.target_fd, new_image, new_len)) status = OTA_DELTA_ERR_HASH;
+        close(parts.target_fd);
+        failed |= expect_status(what, status, OTA_DELTA_DONE);
+    }
+
+    printf("faults (each must fall back to the full image):\n");
+    uint8_t *bad = malloc(patch.len);
+    memcpy(bad, patch.data, patch.len);
+    bad[patch.len - 2] ^= 0x01;                      // Inside the last op, after the header
+    status = apply(bad, patch.len, SEGMENT, source_fd, &parts, false);
+    close(parts.target_fd);
+    failed |= status == OTA_DELTA_DONE || expect_status("flipped bit", status, status);
+
+    status = apply(patch.data, patch.len - 1, SEGMENT, source_fd, &parts, false);
+    close(parts.target_fd);
+    failed |= expect_status("truncated patch", status, OTA_DELTA_MORE);
+
+    uint8_t *other = malloc(old_len);
+    memcpy(other, old_image, old_len);
+    other[old_len / 2] ^= 0x80;
+    int other_fd = temp_file(other, old_len);
+    status = apply(patch.data, patch.len, SEGMENT, other_fd, &parts, false);
+    close(parts.target_fd);
+    close(other_fd);
+    failed |= expect_status("different running image", status, OTA_DELTA_ERR_SOURCE);
+
+    status = apply(patch.data, patch.len, SEGMENT, source_fd, &parts, true);
+    close(parts.target_fd);
+    failed |= expect_status("flash write fails", status, OTA_DELTA_ERR_IO);
+
+    // A patch from an image to itself is nearly free
+    delta_patch_t same_patch;
+    delta_generate(old_image, old_len, old_image, old_len, &same_patch);
+    status = apply(same_patch.data, same_patch.len, SEGMENT, source_fd, &parts, false);
+    if (status == OTA_DELTA_DONE && !target_is(parts.target_fd, old_image, old_len)) status = OTA_DELTA_ERR_HASH;
+    close(parts.target_fd);
+    printf("identical images: patch %zu bytes\n", same_patch.len);
+    failed |= expect_status("identical images", status, OTA_DELTA_DONE);
+
+    close(source_fd);
+    free(same_patch.data);
+    free(other);
+    free(bad);
+    free(patch.data);
+    free(old_image);
+    free(new_image);
+    return failed;
+}
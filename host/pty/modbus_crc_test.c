@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pty_hal.h"
+#include "modbus_crc.h"
+#include "pzem_driver.h"
+
+// CRC and decoder check against the bit-wise reference the driver used
+// to carry. Both builds of src/modbus_crc.c, one lookup per byte and
+// MODBUS_CRC_SLICE_BY_4, are compiled in here under their own names,
+// next to the one the driver links.
+//
+// Every row of the traces becomes a reply frame as the meter sends it,
+// plus the read request. Each path must give the reference CRC on every
+// prefix of every frame and on a random buffer at all lengths 0..N and
+// all four alignments. pzem_parse_reply must agree with a bit-wise
+// decode on every frame, and reject every truncation and every single
+// bit error of it. Then each path is timed over the frames.
+//
+// Build (from the repo root):
+//   cc -O2 -DHAL_HOST -Iinclude -o modbus_crc_test host/pty/modbus_crc_test.c host/pty/pty_hal.c src/pzem_driver.c src/pzem_async.c src/modbus_crc.c src/metrics.c src/dlog.c -lpthread
+// Run:
+//   ./modbus_crc_test [-n length] [-r rounds] dataset/*.csv
+// Exits non-zero if a check fails.
+
+#define modbus_crc_init   table_crc_init
+#define modbus_crc16      table_crc16
+#define modbus_crc_append table_crc_append
+#include "../../src/modbus_crc.c"
+#undef modbus_crc_init
+#undef modbus_crc16
+#undef modbus_crc_append
+
+#define MODBUS_CRC_SLICE_BY_4
+#define crc_table         slice_crc_table
+#define modbus_crc_init   slice_crc_init
+#define modbus_crc16      slice_crc16
+#define modbus_crc_append slice_crc_append
+#include "../../src/modbus_crc.c"
+#undef crc_table
+#undef modbus_crc_init
+#undef modbus_crc16
+#undef modbus_crc_append
+#undef MODBUS_CRC_SLICE_BY_4
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    printf("  %-52s %s\n", what, ok ? "pass" : "FAIL");
+    if (!ok) failures++;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// --- Reference ---
+
+static uint16_t ref_crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t pos = 0; pos < len; pos++) {
+        crc ^= data[pos];
+        for (int i = 8; i != 0; i--) {
+            if ((crc & 0x0001) != 0) crc = (crc >> 1) ^ 0xA001;
+            else crc >>= 1;
+        }
+    }
+    return crc;
+}
+
+static inline uint32_t ref_word32(const uint8_t *p) {
+    uint32_t low = (p[0] << 8) | p[1];
+    uint32_t high = (p[2] << 8) | p[3];
+    return (high << 16) | low;
+}
+
+static bool ref_decode(const uint8_t *data, int len, pzem_data_t *out) {
+    out->valid = false;
+    if (len < PZEM_RESPONSE_LEN) return false;
+    if (data[1] != PZEM_CMD_READ_INPUT || data[2] != PZEM_INPUT_REGS * 2) return false;
+    uint16_t received_crc = (data[24] << 8) | data[23];
+    if (received_crc != ref_crc16(data, 23)) return false;
+
+    out->voltage_dv = (data[3] << 8) | data[4];
+    out->current_ma = ref_word32(&data[5]);
+    out->power_dw   = ref_word32(&data[9]);
+    out->energy_wh  = ref_word32(&data[13]);
+    out->freq_dhz   = (data[17] << 8) | data[18];
+    out->pf_cent    = (data[19] << 8) | data[20];
+    out->slave      = data[0];
+    out->valid = true;
+    return true;
+}
+
+static bool same_data(const pzem_data_t *a, const pzem_data_t *b) {
+    return a->valid == b->valid && a->voltage_dv == b->voltage_dv && a->current_ma == b->current_ma &&
+           a->power_dw == b->power_dw && a->energy_wh == b->energy_wh && a->freq_dhz == b->freq_dhz &&
+           a->pf_cent == b->pf_cent && a->slave == b->slave;
+}
+
+// --- Frames ---
+
+typedef struct {
+    uint8_t reply[PZEM_RESPONSE_LEN];
+    uint8_t request[PZEM_REQUEST_LEN];
+    uint8_t addr;
+} frame_t;
+
+static frame_t *frames = NULL;
+static int frame_count = 0;
+
+// As the emulated PZEM of the host simulator reports a row, from a meter
+// at an address that walks through the valid range
+static int load_csv(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    char line[128];
+    int added = 0;
+    while (fgets(line, sizeof(line), f)) {
+        float v, a, w, kwh, hz, pf;
+        if (sscanf(line, "%f,%f,%f,%f,%f,%f", &v, &a, &w, &kwh, &hz, &pf) != 6) continue; // Header
+        frame_t *grown = realloc(frames, (frame_count + 1) * sizeof(frame_t));
+        if (!grown) break;
+        frames = grown;
+
+        frame_t *fr = &frames[frame_count];
+        pzem_data_t d = {
+            .voltage_dv = (uint16_t)(v * 10.0f + 0.5f),
+            .current_ma = (uint32_t)(a * 1000.0f + 0.5f),
+            .power_dw   = (uint32_t)(w * 10.0f + 0.5f),
+            .energy_wh  = (uint32_t)(kwh * 1000.0f + 0.5f),
+            .freq_dhz   = (uint16_t)(hz * 10.0f + 0.5f),
+            .pf_cent    = (uint16_t)(pf * 100.0f + 0.5f),
+        };
+        fr->addr = 1 + frame_count % 0xF7;
+        pty_pzem_reply(fr->addr, &d, fr->reply);
+        pzem_build_read_request(fr->addr, fr->request);
+        frame_count++;
+        added++;
+    }
+    fclose(f);
+    return added;
+}
+
+// --- Checks ---
+
+typedef uint16_t (*crc_fn)(const uint8_t *data, size_t len);
+
+static void test_crc(int max_len) {
+    int frame_bad = 0, buffer_bad = 0, append_bad = 0;
+
+    for (int i = 0; i < frame_count; i++) {
+        const frame_t *fr = &frames[i];
+        for (int len = 0; len <= PZEM_RESPONSE_LEN; len++) {
+            uint16_t ref = ref_crc16(fr->reply, len);
+            frame_bad += table_crc16(fr->reply, len) != ref;
+            frame_bad += slice_crc16(fr->reply, len) != ref;
+        }
+        for (int len = 0; len <= PZEM_REQUEST_LEN; len++) {
+            uint16_t ref = ref_crc16(fr->request, len);
+            frame_bad += table_crc16(fr->request, len) != ref;
+            frame_bad += slice_crc16(fr->request, len) != ref;
+        }
+        frame_bad += ref_crc16(fr->reply, PZEM_RESPONSE_LEN) != 0;     // A good frame runs to zero
+    }
+
+    uint8_t *buf = malloc(max_len + 3);
+    uint8_t *out = malloc(max_len + 5);
+    srand(1);
+    for (int i = 0; i < max_len + 3; i++) buf[i] = rand() & 0xFF;
+    for (int align = 0; align < 4; align++) {
+        for (int len = 0; len <= max_len; len++) {
+            const uint8_t *p = buf + align;
+            uint16_t ref = ref_crc16(p, len);
+            buffer_bad += table_crc16(p, len) != ref;
+            buffer_bad += slice_crc16(p, len) != ref;
+
+            memcpy(out, p, len);
+            table_crc_append(out, len);
+            append_bad += (uint16_t)(out[len] | (out[len + 1] << 8)) != ref;
+            slice_crc_append(out, len);
+            append_bad += (uint16_t)(out[len] | (out[len + 1] << 8)) != ref;
+        }
+    }
+    free(buf);
+    free(out);
+
+    char what[64];
+    snprintf(what, sizeof(what), "every prefix of %d replies and requests", frame_count);
+    check(frame_bad == 0, what);
+    snprintf(what, sizeof(what), "random buffer, lengths 0..%d, 4 alignments", max_len);
+    check(buffer_bad == 0, what);
+    check(append_bad == 0, "modbus_crc_append, both paths");
+}
+
+static void test_decoder(void) {
+    int agree_bad = 0, short_bad = 0, flip_bad = 0, addr_bad = 0;
+
+    for (int i = 0; i < frame_count; i++) {
+        frame_t *fr = &frames[i];
+        pzem_data_t got = {0}, want = {0};
+
+        ref_decode(fr->reply, PZEM_RESPONSE_LEN, &want);
+        agree_bad += pzem_parse_reply(PZEM_DEFAULT_ADDR, fr->reply, PZEM_RESPONSE_LEN, &got) != PZEM_OK ||
+                     !same_data(&got, &want);
+        agree_bad += pzem_parse_reply(fr->addr, fr->reply, PZEM_RESPONSE_LEN, &got) != PZEM_OK ||
+                     !same_data(&got, &want);
+        addr_bad += pzem_parse_reply(fr->addr % 0xF7 + 1, fr->reply, PZEM_RESPONSE_LEN, &got) != PZEM_ERR_FRAME;
+
+        for (int len = 0; len < PZEM_RESPONSE_LEN; len++) {
+            short_bad += pzem_parse_reply(PZEM_DEFAULT_ADDR, fr->reply, len, &got) == PZEM_OK || got.valid;
+        }
+        for (int bit = 0; bit < PZEM_RESPONSE_LEN * 8; bit++) {
+            fr->reply[bit / 8] ^= 1 << (bit % 8);
+            bool ref_ok = ref_decode(fr->reply, PZEM_RESPONSE_LEN, &want);
+            flip_bad += ref_ok || pzem_parse_reply(PZEM_DEFAULT_ADDR, fr->reply, PZEM_RESPONSE_LEN, &got) == PZEM_OK;
+            fr->reply[bit / 8] ^= 1 << (bit % 8);
+        }
+    }
+
+    check(agree_bad == 0, "decode matches the reference on every reply");
+    check(addr_bad == 0, "reply from another address refused");
+    check(short_bad == 0, "every truncated reply refused");
+    check(flip_bad == 0, "every single bit error refused");
+}
+
+// --- Timing ---
+
+static volatile uint32_t sink;
+
+static void time_crc(const char *name, crc_fn fn, int rounds, double ref_ns) {
+    uint32_t acc = 0;
+    uint64_t start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < frame_count; i++) acc += fn(frames[i].reply, PZEM_RESPONSE_LEN - 2);
+    }
+    double ns = (double)(now_ns() - start) / ((double)rounds * frame_count);
+    sink = acc;
+    printf("  %-12s %7.1f ns/reply  %6.1f MB/s", name, ns, (PZEM_RESPONSE_LEN - 2) / ns * 1000.0);
+    if (ref_ns > 0) printf("  x%.1f", ref_ns / ns);
+    printf("\n");
+}
+
+static double time_decode(const char *name, bool reference, int rounds, double ref_ns) {
+    uint32_t acc = 0;
+    pzem_data_t d;
+    uint64_t start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < frame_count; i++) {
+            if (reference) ref_decode(frames[i].reply, PZEM_RESPONSE_LEN, &d);
+            else pzem_parse_reply(PZEM_DEFAULT_ADDR, frames[i].reply, PZEM_RESPONSE_LEN, &d);
+            acc += d.power_dw;
+        }
+    }
+    double ns = (double)(now_ns() - start) / ((double)rounds * frame_count);
+    sink = acc;
+    printf("  %-12s %7.1f ns/reply", name, ns);
+    if (ref_ns > 0) printf("  x%.1f", ref_ns / ns);
+    printf("\n");
+    return ns;
+}
+
+static void bench(int rounds) {
+    uint32_t acc = 0;
+    uint64_t start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < frame_count; i++) acc += ref_crc16(frames[i].reply, PZEM_RESPONSE_LEN - 2);
+    }
+    double ref_ns = (double)(now_ns() - start) / ((double)rounds * frame_count);
+    sink = acc;
+
+    printf("CRC over the %d checked bytes of a reply, %d x %d replies:\n", PZEM_RESPONSE_LEN - 2, rounds,
+           frame_count);
+    printf("  %-12s %7.1f ns/reply  %6.1f MB/s\n", "bit-wise", ref_ns, (PZEM_RESPONSE_LEN - 2) / ref_ns * 1000.0);
+    time_crc("table", table_crc16, rounds, ref_ns);
+    time_crc("slice-by-4", slice_crc16, rounds, ref_ns);
+
+    printf("Decode of a whole reply:\n");
+    double ref_decode_ns = time_decode("reference", true, rounds, 0);
+    time_decode("parse_reply", false, rounds, ref_decode_ns);
+}
+
+int main(int argc, char **argv) {
+    int max_len = 1024;
+    int rounds = 200;
+    int files = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            max_len = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else if (argv[i][0] != '-') {
+            if (load_csv(argv[i]) < 0) {
+                perror(argv[i]);
+                return 1;
+            }
+            files++;
+        } else {
+            files = 0;
+            break;
+        }
+    }
+    if (files == 0 || frame_count == 0) {
+        fprintf(stderr, "Usage: %s [-n length] [-r rounds] dataset/*.csv\n", argv[0]);
+        return 1;
+    }
+    if (max_len < 0) max_len = 0;
+    if (rounds < 1) rounds = 1;
+
+    modbus_crc_init();
+    table_crc_init();
+    slice_crc_init();
+
+    printf("CRC against the bit-wise reference:\n");
+    test_crc(max_len);
+    printf("Decoder against the bit-wise reference:\n");
+    test_decoder();
+    bench(rounds);
+
+    free(frames);
+    if (failures) printf("%d checks failed\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,126 @@
+#define _GNU_SOURCE
+#include "pty_hal.h"
+#include "modbus_crc.h"
+#include "dlog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+int pty_log_level = 0;
+
+static int uart_fd = -1;        // Firmware side
+static struct timespec t0;
+
+static void make_raw(int fd) {
+    struct termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+}
+
+int pty_hal_open(void) {
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int bus_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (bus_fd < 0 || grantpt(bus_fd) < 0 || unlockpt(bus_fd) < 0) return -1;
+    uart_fd = open(ptsname(bus_fd), O_RDWR | O_NOCTTY);
+    if (uart_fd < 0) return -1;
+    make_raw(bus_fd);
+    make_raw(uart_fd);
+    return bus_fd;
+}
+
+void pty_sleep_us(long us) {
+    struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+    while (nanosleep(&ts, &ts) != 0) {
+    }
+}
+
+long pty_wire_us(int bytes) {
+    return bytes * 10 * 1000000L / PTY_BAUD;
+}
+
+static void put16(uint8_t *p, uint32_t v) {
+    p[0] = (v >> 8) & 0xFF;
+    p[1] = v & 0xFF;
+}
+
+// 32-bit values are sent low word first
+static void put32_lowfirst(uint8_t *p, uint32_t v) {
+    put16(p, v & 0xFFFF);
+    put16(p + 2, v >> 16);
+}
+
+void pty_pzem_reply(uint8_t addr, const pzem_data_t *d, uint8_t *frame) {
+    frame[0] = addr;
+    frame[1] = 0x04;
+    frame[2] = 20;
+    put16(&frame[3], d->voltage_dv);
+    put32_lowfirst(&frame[5], d->current_ma);
+    put32_lowfirst(&frame[9], d->power_dw);
+    put32_lowfirst(&frame[13], d->energy_wh);
+    put16(&frame[17], d->freq_dhz);
+    put16(&frame[19], d->pf_cent);
+    put16(&frame[21], 0);   // Alarm status
+    modbus_crc_append(frame, 23);
+}
+
+void hal_log(char level, const char *tag, const char *fmt, ...) {
+    if ((level == 'I' || level == 'D') && !pty_log_level) return;
+    va_list ap;
+    va_start(ap, fmt);
+    printf("[%10lu] %c (%s) ", (unsigned long)hal_millis(), level, tag);
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+}
+
+void hal_log_record(char level, const char *tag, uint32_t ms, const char *text) {
+    if ((level == 'I' || level == 'D') && !pty_log_level) return;
+    printf("[%10lu] %c (%s) %s\n", (unsigned long)ms, level, tag, text);
+}
+
+uint32_t hal_millis(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((now.tv_sec - t0.tv_sec) * 1000 + (now.tv_nsec - t0.tv_nsec) / 1000000);
+}
+
+void hal_delay_ms(uint32_t ms) {
+    dlog_flush();
+    pty_sleep_us((long)ms * 1000);
+}
+
+void hal_uart_init(uint32_t baud) {
+    struct termios tio;
+    tcgetattr(uart_fd, &tio);
+    cfsetspeed(&tio, baud == 9600 ? B9600 : B115200);
+    tcsetattr(uart_fd, TCSANOW, &tio);
+}
+
+void hal_uart_flush_input(void) {
+    tcflush(uart_fd, TCIFLUSH);
+}
+
+int hal_uart_write(const uint8_t *data, size_t len) {
+    return (int)write(uart_fd, data, len);
+}
+
+// Like uart_read_bytes: returns once len bytes arrived or the timeout passed
+int hal_uart_read(uint8_t *data, size_t len, uint32_t timeout_ms) {
+    uint32_t deadline = hal_millis() + timeout_ms;
+    size_t got = 0;
+    while (got < len) {
+        int32_t left = (int32_t)(deadline - hal_millis());
+        struct pollfd p = { uart_fd, POLLIN, 0 };
+        if (poll(&p, 1, left > 0 ? left : 0) <= 0) break;
+        ssize_t n = read(uart_fd, data + got, len - got);
+        if (n <= 0) break;
+        got += n;
+    }
+    return (int)got;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "hal.h"
+#include "common_structs.h"
+
+// Real-time UART HAL over a Linux pseudo-terminal, for the standalone
+// harnesses in host/pty/. The firmware side gets the hal_uart_*,
+// hal_millis, hal_delay_ms and hal_log calls; the test plays the meters
+// on the returned fd.
+
+#define PTY_BAUD 9600
+
+extern int pty_log_level;             // 0: warnings and errors, 1: everything
+
+// Opens the pty pair, both ends raw. Returns the meter side fd or -1.
+int pty_hal_open(void);
+
+void pty_sleep_us(long us);
+
+// Time a frame of this many bytes takes at PTY_BAUD, 8N1
+long pty_wire_us(int bytes);
+
+// A read-input-registers reply carrying d, PZEM_RESPONSE_LEN bytes
+void pty_pzem_reply(uint8_t addr, const pzem_data_t *d, uint8_t *frame);
@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "pty_hal.h"
+#include "modbus_crc.h"
+#include "pzem_async.h"
+
+// Fault-injection test for the non-blocking PZEM transaction engine. A
+// responder thread on the far end of a pty answers with 9600 baud timing
+// and, per scenario, prefixes noise, splits replies into small writes,
+// corrupts replies, answers after the timeout, or stays silent. Each
+// scenario runs back-to-back transactions, checks the outcome and prints
+// the engine counters with a latency histogram.
+//
+// Build (from the repo root):
+//   cc -O2 -DHAL_HOST -Iinclude -o pzem_async_test host/pty/pzem_async_test.c host/pty/pty_hal.c src/pzem_async.c src/pzem_driver.c src/modbus_crc.c src/metrics.c src/dlog.c -lpthread
+// Run:
+//   ./pzem_async_test [-n transactions] [-v]
+// Exits non-zero if a scenario ends differently than expected or a
+// reply is handed to the wrong transaction.
+
+#define METER_ADDR            0x01
+#define METER_LATENCY_MS      5
+
+typedef struct {
+    const char *name;
+    int noise_bytes;          // Random bytes before every reply
+    int chunk;                // Write replies this many bytes at a time
+    int corrupt_every;        // Flip a bit in every Nth reply
+    int late_every;           // Answer every Nth request after the timeout
+    bool silent;
+    // Expected outcome
+    bool expect_ok;
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    { "clean",     0,  0, 0, 0, false, true },
+    { "noise",     12, 0, 0, 0, false, true },
+    { "partial",   0,  3, 0, 0, false, true },
+    { "corrupt",   0,  0, 4, 0, false, true },
+    { "late",      0,  0, 0, 5, false, true },
+    { "all",       6,  5, 7, 9, false, true },
+    { "silent",    0,  0, 0, 0, true,  false },
+};
+#define SCENARIO_COUNT ((int)(sizeof(scenarios) / sizeof(scenarios[0])))
+
+static int bus_fd = -1;
+static const scenario_t *volatile active = NULL;
+static volatile bool stop = false;
+static uint32_t requests_seen = 0;    // Reset between scenarios, while the bus is quiet
+
+// Every reply carries the sequence number of the request it answers in
+// energy_wh, and current is tied to power so mixed-up bytes show
+static void meter_reply(uint32_t seq, uint8_t *frame) {
+    pzem_data_t d = {
+        .voltage_dv = 2300,
+        .power_dw = 100 + seq % 5000,
+        .energy_wh = seq,
+        .freq_dhz = 500,
+        .pf_cent = 95,
+    };
+    d.current_ma = d.power_dw * 3 + 7;
+    pty_pzem_reply(METER_ADDR, &d, frame);
+}
+
+static void send_reply(const scenario_t *sc, const uint8_t *reply) {
+    uint8_t noise[32];
+    for (int i = 0; i < sc->noise_bytes; i++) noise[i] = (uint8_t)rand();
+    if (sc->noise_bytes && write(bus_fd, noise, sc->noise_bytes) < 0) perror("write");
+
+    int step = sc->chunk ? sc->chunk : PZEM_RESPONSE_LEN;
+    for (int off = 0; off < PZEM_RESPONSE_LEN; off += step) {
+        int n = PZEM_RESPONSE_LEN - off < step ? PZEM_RESPONSE_LEN - off : step;
+        if (write(bus_fd, reply + off, n) < 0) perror("write");
+        if (sc->chunk) pty_sleep_us(pty_wire_us(n));
+    }
+}
+
+static void *responder(void *arg) {
+    uint8_t req[PZEM_REQUEST_LEN];
+    size_t got = 0;
+    (void)arg;
+
+    while (!stop) {
+        struct pollfd p = { bus_fd, POLLIN, 0 };
+        int ready = poll(&p, 1, got ? 4 : 50);
+        if (ready <= 0) {
+            got = 0;
+            continue;
+        }
+        ssize_t n = read(bus_fd, req + got, sizeof(req) - got);
+        if (n <= 0) continue;
+        got += n;
+        if (got < sizeof(req)) continue;
+        got = 0;
+
+        const scenario_t *sc = active;
+        uint32_t seq = requests_seen++;
+        if (!sc || sc->silent || req[0] != METER_ADDR || !modbus_crc_check(req, sizeof(req))) continue;
+
+        uint8_t reply[PZEM_RESPONSE_LEN];
+        meter_reply(seq, reply);
+        if (sc->corrupt_every && seq % sc->corrupt_every == 0) {
+            reply[3 + rand() % 20] ^= 1 << (rand() % 8);
+        }
+        long delay_us = pty_wire_us(PZEM_REQUEST_LEN) + METER_LATENCY_MS * 1000;
+        if (!sc->chunk) delay_us += pty_wire_us(PZEM_RESPONSE_LEN);
+        if (sc->late_every && seq % sc->late_every == 0) {
+            delay_us += (PZEM_ASYNC_TIMEOUT_MS + 10) * 1000;
+        }
+        pty_sleep_us(delay_us);
+        send_reply(sc, reply);
+    }
+    return NULL;
+}
+
+// --- Firmware side ---
+typedef struct {
+    bool done;
+    pzem_status_t status;
+    pzem_data_t data;
+} outcome_t;
+
+static void on_complete(void *user, pzem_status_t status, const pzem_data_t *data) {
+    outcome_t *o = user;
+    o->done = true;
+    o->status = status;
+    o->data = *data;
+}
+
+static void print_histogram(const pzem_async_stats_t *st) {
+    uint32_t peak = 1;
+    for (int i = 0; i < PZEM_ASYNC_HIST_BUCKETS; i++) {
+        if (st->latency_hist[i] > peak) peak = st->latency_hist[i];
+    }
+    for (int i = 0; i < PZEM_ASYNC_HIST_BUCKETS; i++) {
+        if (!st->latency_hist[i]) continue;
+        char bar[41];
+        int len = (int)(st->latency_hist[i] * 40 / peak);
+        memset(bar, '#', len);
+        bar[len] = '\0';
+        if (i == PZEM_ASYNC_HIST_BUCKETS - 1) {
+            printf("    %4d+    ms %5u %s\n", i * PZEM_ASYNC_HIST_STEP_MS, st->latency_hist[i], bar);
+        } else {
+            printf("    %4d-%-4d ms %5u %s\n", i * PZEM_ASYNC_HIST_STEP_MS, (i + 1) * PZEM_ASYNC_HIST_STEP_MS,
+                   st->latency_hist[i], bar);
+        }
+    }
+}
+
+static int run(const scenario_t *sc, int transactions) {
+    pzem_async_t link;
+    outcome_t o;
+    int wrong = 0, unexpected = 0;
+
+    if (sc->silent && transactions > 10) transactions = 10;   // 300 ms each
+    pzem_async_init(&link, on_complete, &o);
+    active = sc;
+
+    for (int t = 0; t < transactions; t++) {
+        // Requests sent before this transaction; its reply must answer a later one
+        uint32_t sent_before = link.stats.issued + link.stats.retries;
+        memset(&o, 0, sizeof(o));
+        pzem_async_issue(&link, METER_ADDR, hal_millis());
+        while (!o.done) {
+            hal_delay_ms(1);
+            pzem_async_poll(&link, hal_millis());
+        }
+
+        if ((o.status == PZEM_OK) != sc->expect_ok) unexpected++;
+        if (o.status == PZEM_OK &&
+            (o.data.energy_wh < sent_before || o.data.current_ma != o.data.power_dw * 3 + 7 ||
+             o.data.slave != METER_ADDR)) {
+            wrong++;
+        }
+    }
+
+    // Let stragglers land so the next scenario starts clean
+    active = NULL;
+    hal_delay_ms(PZEM_ASYNC_TIMEOUT_MS * 2);
+    pzem_async_poll(&link, hal_millis());
+    requests_seen = 0;
+
+    const pzem_async_stats_t *st = &link.stats;
+    printf("%-8s %4u ok %3u failed | retries %3u timeouts %3u crc %3u noise %4u resync %4u late %3u holdoff %3u | %s\n",
+           sc->name, st->ok, st->failed, st->retries, st->timeouts, st->crc_errors, st->noise_bytes,
+           st->resyncs, st->late, st->holdoffs, (wrong || unexpected) ? "FAIL" : "pass");
+    if (st->ok) {
+        printf("    latency min %u mean %.1f p50 %u p90 %u p99 %u max %u ms\n", st->latency_min_ms,
+               (double)st->latency_sum_ms / st->ok, pzem_async_latency_percentile(st, 50),
+               pzem_async_latency_percentile(st, 90), pzem_async_latency_percentile(st, 99), st->latency_max_ms);
+        print_histogram(st);
+    }
+    if (wrong) printf("    %d replies handed to the wrong transaction\n", wrong);
+    if (unexpected) printf("    %d transactions ended unexpectedly\n", unexpected);
+    return wrong || unexpected;
+}
+
+int main(int argc, char **argv) {
+    int transactions = 100;
+    pthread_t thread;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            transactions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            pty_log_level = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [-n transactions] [-v]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bus_fd = pty_hal_open();
+    if (bus_fd < 0) {
+        perror("pty");
+        return 1;
+    }
+    srand(1);
+    modbus_crc_init();
+    hal_uart_init(PZEM_BAUD_RATE);
+    pthread_create(&thread, NULL, responder, NULL);
+
+    int failed = 0;
+    for (int i = 0; i < SCENARIO_COUNT; i++) {
+        failed |= run(&scenarios[i], transactions);
+    }
+
+    stop = true;
+    pthread_join(thread, NULL);
+    return failed;
+}
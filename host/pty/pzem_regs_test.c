@@ -0,0 +1,324 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "pty_hal.h"
+#include "modbus_crc.h"
+#include "pzem_driver.h"
+#include "pzem_async.h"
+
+// Register API test and wire-cost benchmark. A responder thread on the
+// far end of a pty plays one PZEM-004T with its whole register map: the
+// ten input registers with the alarm status following the threshold, the
+// alarm threshold and address holding registers, energy reset and the
+// Modbus exceptions for unknown functions, registers and values.
+//
+// The test goes through the blocking API of pzem_driver.c: reads and
+// writes of both holding registers, short reads, energy reset, an address
+// change and the refused requests. The benchmark then times each kind of
+// read through the non-blocking engine and prints the bytes on the wire
+// and UART time per decision, and what the protection fast path spends
+// per second with and without short reads.
+//
+// Build (from the repo root):
+//   cc -O2 -DHAL_HOST -Iinclude -o pzem_regs_test host/pty/pzem_regs_test.c host/pty/pty_hal.c src/pzem_driver.c src/pzem_async.c src/modbus_crc.c src/metrics.c src/dlog.c -lpthread
+// Run:
+//   ./pzem_regs_test [-n transactions] [-v]
+// Exits non-zero if a check fails.
+
+#define METER_ADDR        0x01
+#define METER_LATENCY_MS  5
+#define METER_ALARM_W     2300        // Factory threshold
+
+// --- Meter ---
+
+typedef struct {
+    uint8_t addr;
+    uint16_t alarm_w;
+    pzem_data_t d;
+    uint32_t requests;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+} sim_meter_t;
+
+static sim_meter_t meter;
+static int bus_fd = -1;
+static volatile bool stop = false;
+
+static void put16(uint8_t *p, uint32_t v) {
+    p[0] = (v >> 8) & 0xFF;
+    p[1] = v & 0xFF;
+}
+
+static void input_regs(uint16_t *r) {
+    const pzem_data_t *d = &meter.d;
+    r[0] = d->voltage_dv;
+    r[1] = d->current_ma & 0xFFFF;
+    r[2] = d->current_ma >> 16;
+    r[3] = d->power_dw & 0xFFFF;
+    r[4] = d->power_dw >> 16;
+    r[5] = d->energy_wh & 0xFFFF;
+    r[6] = d->energy_wh >> 16;
+    r[7] = d->freq_dhz;
+    r[8] = d->pf_cent;
+    r[9] = d->power_dw / 10 > meter.alarm_w ? PZEM_ALARM_ON : 0;
+}
+
+static int exception(const uint8_t *req, uint8_t code, uint8_t *reply) {
+    reply[0] = meter.addr;
+    reply[1] = req[1] | PZEM_CMD_EXCEPTION;
+    reply[2] = code;
+    modbus_crc_append(reply, 3);
+    return PZEM_EXCEPTION_LEN;
+}
+
+// Reply length, 0 for none
+static int serve(const uint8_t *req, uint8_t *reply) {
+    const uint16_t reg = (uint16_t)(req[2] << 8 | req[3]);
+    const uint16_t value = (uint16_t)(req[4] << 8 | req[5]);
+    uint16_t regs[PZEM_INPUT_REGS];
+    const uint16_t holding[PZEM_HOLDING_REGS] = { meter.alarm_w, meter.addr };
+
+    switch (req[1]) {
+    case PZEM_CMD_READ_INPUT:
+    case PZEM_CMD_READ_HOLDING: {
+        const bool input = req[1] == PZEM_CMD_READ_INPUT;
+        const uint16_t first = input ? 0 : PZEM_HREG_ALARM_W;
+        const uint16_t n = input ? PZEM_INPUT_REGS : PZEM_HOLDING_REGS;
+        if (value == 0 || reg < first || reg + value > first + n) return exception(req, 0x02, reply);
+        input_regs(regs);
+        reply[0] = meter.addr;
+        reply[1] = req[1];
+        reply[2] = (uint8_t)(value * 2);
+        for (int i = 0; i < value; i++) {
+            put16(&reply[3 + i * 2], input ? regs[reg + i] : holding[reg - first + i]);
+        }
+        modbus_crc_append(reply, 3 + value * 2);
+        return 5 + value * 2;
+    }
+    case PZEM_CMD_WRITE_SINGLE:
+        if (reg == PZEM_HREG_ALARM_W) {
+            meter.alarm_w = value;
+        } else if (reg == PZEM_HREG_ADDRESS) {
+            if (value < 0x01 || value > 0xF7) return exception(req, 0x03, reply);
+            meter.addr = (uint8_t)value;
+        } else {
+            return exception(req, 0x02, reply);
+        }
+        memcpy(reply, req, PZEM_REQUEST_LEN);
+        return PZEM_REQUEST_LEN;
+    case PZEM_CMD_RESET_ENERGY:
+        meter.d.energy_wh = 0;
+        memcpy(reply, req, 4);
+        return 4;
+    default:
+        return exception(req, 0x01, reply);
+    }
+}
+
+// An energy reset is 4 bytes, everything else 8. Known after 2 bytes.
+static size_t request_len(const uint8_t *req, size_t got) {
+    if (got < 2) return 2;
+    return req[1] == PZEM_CMD_RESET_ENERGY ? 4 : PZEM_REQUEST_LEN;
+}
+
+static void *responder(void *arg) {
+    uint8_t req[PZEM_REQUEST_LEN];
+    size_t got = 0;
+    (void)arg;
+
+    while (!stop) {
+        struct pollfd p = { bus_fd, POLLIN, 0 };
+        // A gap longer than 3.5 characters ends a frame
+        int ready = poll(&p, 1, got ? 4 : 50);
+        if (ready <= 0) {
+            got = 0;
+            continue;
+        }
+        ssize_t n = read(bus_fd, req + got, request_len(req, got) - got);
+        if (n <= 0) continue;
+        got += n;
+        if (got < request_len(req, got)) continue;
+        const size_t len = got;
+        got = 0;
+
+        if (!modbus_crc_check(req, len) || (req[0] != meter.addr && req[0] != PZEM_DEFAULT_ADDR)) continue;
+        meter.requests++;
+        meter.bytes_in += len;
+        meter.d.energy_wh++;
+
+        uint8_t reply[PZEM_RESPONSE_LEN];
+        int reply_len = serve(req, reply);
+        pty_sleep_us(pty_wire_us((int)len) + METER_LATENCY_MS * 1000 + pty_wire_us(reply_len));
+        if (write(bus_fd, reply, reply_len) < 0) perror("write");
+        meter.bytes_out += reply_len;
+    }
+    return NULL;
+}
+
+// --- Firmware side ---
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    printf("  %-44s %s\n", what, ok ? "pass" : "FAIL");
+    if (!ok) failures++;
+}
+
+static void test_api(void) {
+    uint16_t regs[PZEM_INPUT_REGS];
+    uint32_t power;
+    bool alarm = true;
+
+    printf("Register API\n");
+    pzem_set_address(METER_ADDR);
+    pzem_data_t d = pzem_read_registers();
+    check(d.valid && d.voltage_dv == meter.d.voltage_dv && d.power_dw == meter.d.power_dw &&
+              d.pf_cent == meter.d.pf_cent && d.slave == METER_ADDR && !d.alarm,
+          "full read");
+    check(pzem_read_power(&power) == PZEM_OK && power == meter.d.power_dw, "power only");
+    check(pzem_read_alarm(&alarm) == PZEM_OK && !alarm, "alarm only, under the threshold");
+    check(pzem_read_input(PZEM_REG_FREQ, 2, regs) == PZEM_OK && regs[0] == meter.d.freq_dhz &&
+              regs[1] == meter.d.pf_cent,
+          "frequency and power factor");
+    check(pzem_read_holding(PZEM_HREG_ALARM_W, 2, regs) == PZEM_OK && regs[0] == METER_ALARM_W &&
+              regs[1] == METER_ADDR,
+          "holding registers");
+
+    // 120 W against a 100 W threshold
+    check(pzem_write_holding(PZEM_HREG_ALARM_W, 100) == PZEM_OK && meter.alarm_w == 100, "write alarm threshold");
+    check(pzem_read_alarm(&alarm) == PZEM_OK && alarm, "alarm only, over the threshold");
+    check(pzem_read_registers().alarm, "full read, over the threshold");
+    check(pzem_write_holding(PZEM_HREG_ALARM_W, METER_ALARM_W) == PZEM_OK, "restore alarm threshold");
+
+    check(pzem_reset_energy() == PZEM_OK, "energy reset");
+    d = pzem_read_registers();
+    check(d.valid && d.energy_wh == 1, "energy counts again from zero");
+
+    check(pzem_change_address(0x07) == PZEM_OK && meter.addr == 0x07 && pzem_get_address() == 0x07,
+          "change address");
+    d = pzem_read_registers();
+    check(d.valid && d.slave == 0x07, "read at the new address");
+    pzem_set_address(METER_ADDR);
+    check(pzem_read_power(&power) == PZEM_ERR_TIMEOUT, "old address is silent");
+    pzem_set_address(0x07);
+    check(pzem_change_address(METER_ADDR) == PZEM_OK && meter.addr == METER_ADDR, "change address back");
+
+    const uint32_t refused = pzem_link_stats()->exceptions, retries = pzem_link_stats()->retries;
+    check(pzem_write_holding(PZEM_HREG_ADDRESS, 0) == PZEM_ERR_EXCEPTION && meter.addr == METER_ADDR,
+          "address 0 refused");
+    check(pzem_read_input(PZEM_REG_PF, 4, regs) == PZEM_ERR_EXCEPTION, "read past the last register refused");
+    check(pzem_read_holding(0x0000, 1, regs) == PZEM_ERR_EXCEPTION, "unknown holding register refused");
+    check(pzem_link_stats()->exceptions == refused + 3 && pzem_link_stats()->retries == retries,
+          "refusals complete without retries");
+    d = pzem_read_registers();
+    check(d.valid, "full read after the refusals");
+}
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+typedef struct {
+    const char *name;
+    pzem_request_t req;
+    double wire_bytes;
+    double uart_ms;
+} read_kind_t;
+
+// Issue to completion, polled at 1 ms like a task waiting on the engine
+static void bench_kind(pzem_async_t *link, read_kind_t *k, int transactions) {
+    const uint64_t bytes_before = meter.bytes_in + meter.bytes_out;
+    uint64_t busy_us = 0, max_us = 0;
+    int ok = 0;
+
+    for (int t = 0; t < transactions; t++) {
+        pzem_status_t status;
+        uint64_t start = now_us();
+        pzem_async_issue_request(link, METER_ADDR, &k->req, hal_millis());
+        for (;;) {
+            pzem_async_poll(link, hal_millis());
+            if (pzem_async_result(link, &status, NULL)) break;
+            pty_sleep_us(1000);
+        }
+        uint64_t us = now_us() - start;
+        busy_us += us;
+        if (us > max_us) max_us = us;
+        ok += status == PZEM_OK;
+    }
+    k->wire_bytes = (double)(meter.bytes_in + meter.bytes_out - bytes_before) / transactions;
+    k->uart_ms = busy_us / 1000.0 / transactions;
+    printf("%-22s %7d %5d %10.1f %8.1f / %4.1f ms  %d/%d ok\n", k->name, pzem_request_len(&k->req),
+           pzem_reply_len(&k->req), k->wire_bytes, k->uart_ms, max_us / 1000.0, ok, transactions);
+    if (ok != transactions) failures++;
+}
+
+static void bench(int transactions) {
+    read_kind_t kinds[] = {
+        { "all registers", PZEM_READ_ALL, 0, 0 },
+        { "voltage/current/power", PZEM_READ_VIP, 0, 0 },
+        { "power only", PZEM_READ_POWER, 0, 0 },
+        { "alarm status only", PZEM_READ_ALARM, 0, 0 },
+    };
+    pzem_async_t link;
+
+    pzem_async_init(&link, NULL, NULL);
+    printf("\nRead                   request reply wire bytes UART time (mean / max)\n");
+    for (unsigned i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++) {
+        bench_kind(&link, &kinds[i], transactions);
+    }
+
+    // The fast path reads every 250 ms: four full reads a second before,
+    // now one full read (the meter's update) and three short ones
+    const double per_s = 1000.0 / 250;
+    const read_kind_t *all = &kinds[0], *vip = &kinds[1];
+    printf("\nProtection fast path   %.0f -> %.0f bytes / s, %.0f -> %.0f ms of UART time / s\n",
+           per_s * all->wire_bytes, all->wire_bytes + (per_s - 1) * vip->wire_bytes, per_s * all->uart_ms,
+           all->uart_ms + (per_s - 1) * vip->uart_ms);
+    printf("Overload decision      %.0f -> %.0f bytes, %.1f -> %.1f ms from request to reading\n", all->wire_bytes,
+           vip->wire_bytes, all->uart_ms, vip->uart_ms);
+}
+
+int main(int argc, char **argv) {
+    int transactions = 50;
+    pthread_t thread;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            transactions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            pty_log_level = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [-n transactions] [-v]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (transactions < 1) transactions = 1;
+
+    bus_fd = pty_hal_open();
+    if (bus_fd < 0) {
+        perror("pty");
+        return 1;
+    }
+    meter = (sim_meter_t){
+        .addr = METER_ADDR,
+        .alarm_w = METER_ALARM_W,
+        .d = { .voltage_dv = 2301, .current_ma = 70123, .power_dw = 1200, .energy_wh = 0x12345,
+               .freq_dhz = 501, .pf_cent = 74 },
+    };
+    pzem_init();
+    pthread_create(&thread, NULL, responder, NULL);
+
+    test_api();
+    bench(transactions);
+
+    stop = true;
+    pthread_join(thread, NULL);
+    if (failures) printf("%d checks failed\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "sample_ring.h"
+
+// Stress test of the sample ring between the sensor task and the
+// publisher (src/sample_ring.c). A producer thread claims, fills and
+// commits samples, as the sensor task does; a consumer thread peeks,
+// copies and releases them, as the publisher does. Both spin for about
+// the same time per sample, the consumer while it holds the slot, so the
+// two sides keep meeting on the same slots. The consumer also pauses now
+// and then so the ring fills. Both policies are run in turn.
+//
+// Every sample carries its sequence number in ts_ms and values derived
+// from it in every other field. The consumer checks that sequence numbers
+// only go up, that each sample released as intact is whole (no field from
+// another sample), and that every sample produced is either delivered or
+// counted by the ring as dropped or overwritten. BACKPRESSURE must never
+// overwrite.
+//
+// Build (from the repo root):
+//   cc -O2 -DHAL_HOST -Iinclude -o sample_ring_stress host/pty/sample_ring_stress.c src/sample_ring.c -lpthread
+// Run:
+//   ./sample_ring_stress [-n samples] [-d depth] [-s spin] [-p pause_every]
+// Exits non-zero if a check fails.
+
+#define PAUSE_US 200
+
+static uint32_t sample_count = 2000000;
+static uint32_t depth = 32;                // MQTT_RING_DEPTH
+static uint32_t spin = 100;                // Busy loop per sample, each side
+static uint32_t pause_every = 4096;        // Consumer samples between pauses, 0 for none
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    printf("  %-44s %s\n", what, ok ? "pass" : "FAIL");
+    if (!ok) failures++;
+}
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void spin_for(uint32_t n) {
+    for (volatile uint32_t i = 0; i < n; i++) {
+    }
+}
+
+static void pause_us(long us) {
+    struct timespec ts = { 0, us * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+// --- Samples ---
+
+static void fill(telemetry_sample_t *s, uint32_t seq) {
+    s->ts_ms = seq;
+    s->data.current_ma = seq * 2654435761u;
+    s->data.power_dw = ~seq;
+    s->data.energy_wh = seq ^ 0x5A5A5A5A;
+    s->data.voltage_dv = seq & 0xFFFF;
+    s->data.freq_dhz = seq >> 16;
+    s->data.pf_cent = (seq * 7) & 0xFFFF;
+    s->data.valid = true;
+    s->data.slave = seq & 0xFF;
+    s->relay = seq & 1;
+    s->load_class = seq >> 24;
+}
+
+static bool whole(const telemetry_sample_t *s) {
+    telemetry_sample_t want;
+    memset(&want, 0, sizeof(want));
+    fill(&want, s->ts_ms);
+    return s->data.current_ma == want.data.current_ma && s->data.power_dw == want.data.power_dw &&
+           s->data.energy_wh == want.data.energy_wh && s->data.voltage_dv == want.data.voltage_dv &&
+           s->data.freq_dhz == want.data.freq_dhz && s->data.pf_cent == want.data.pf_cent &&
+           s->data.valid && s->data.slave == want.data.slave && s->relay == want.relay &&
+           s->load_class == want.load_class;
+}
+
+// --- Threads ---
+
+typedef struct {
+    sample_ring_t ring;
+    _Atomic bool done;
+
+    // Consumer results
+    uint32_t delivered;
+    uint32_t discarded;            // Overwritten while copied, release said so
+    uint32_t skipped;              // Sequence numbers never seen
+    uint32_t backwards;            // Repeated or out of order
+    uint32_t torn;                 // Released as intact but mixed
+} run_t;
+
+static void *producer(void *arg) {
+    run_t *run = arg;
+
+    for (uint32_t seq = 0; seq < sample_count; seq++) {
+        spin_for(spin);
+        telemetry_sample_t *slot = sample_ring_claim(&run->ring);
+        if (!slot) continue;       // Dropped, counted by the ring
+        fill(slot, seq);
+        sample_ring_commit(&run->ring);
+        // The sensor task sleeps between readings; on a single core this
+        // lets the consumer in before the ring is lapped
+        if (seq % (depth / 2 + 1) == 0) sched_yield();
+    }
+    atomic_store_explicit(&run->done, true, memory_order_release);
+    return NULL;
+}
+
+static void *consumer(void *arg) {
+    run_t *run = arg;
+    uint32_t expect = 0;
+    uint32_t taken = 0;
+    uint32_t rng = 1;
+
+    for (;;) {
+        bool done = atomic_load_explicit(&run->done, memory_order_acquire);
+        const telemetry_sample_t *s = sample_ring_peek(&run->ring);
+        if (!s) {
+            if (done) break;
+            sched_yield();         // The publisher would block on its notification
+            continue;
+        }
+
+        telemetry_sample_t copy = *s;
+        rng = rng * 1103515245 + 12345;
+        spin_for((rng >> 16) % (2 * spin + 1));
+        if (!sample_ring_release(&run->ring)) {
+            run->discarded++;
+        } else {
+            if (!whole(&copy)) run->torn++;
+            if (copy.ts_ms < expect) {
+                run->backwards++;
+            } else {
+                run->skipped += copy.ts_ms - expect;
+                expect = copy.ts_ms + 1;
+            }
+            run->delivered++;
+        }
+
+        if (pause_every && ++taken % pause_every == 0) pause_us(PAUSE_US);
+    }
+    run->skipped += sample_count - expect;   // Lost after the last delivered
+    return NULL;
+}
+
+// --- Runs ---
+
+static void run_policy(sample_ring_policy_t policy, const char *name) {
+    static run_t run;
+    sample_slot_t *slots = calloc(depth, sizeof(sample_slot_t));
+    pthread_t prod, cons;
+
+    memset(&run, 0, sizeof(run));
+    sample_ring_init(&run.ring, slots, depth, policy);
+    atomic_init(&run.done, false);
+
+    uint64_t start = now_us();
+    pthread_create(&cons, NULL, consumer, &run);
+    pthread_create(&prod, NULL, producer, &run);
+    pthread_join(prod, NULL);
+    pthread_join(cons, NULL);
+    double s = (now_us() - start) / 1e6;
+
+    sample_ring_stats_t st;
+    sample_ring_get_stats(&run.ring, &st);
+    uint32_t lost = st.dropped + st.overwritten;
+
+    printf("%s, depth %u, %u samples in %.2f s (%.1f M/s):\n", name, st.depth, sample_count, s,
+           sample_count / s / 1e6);
+    printf("  delivered %u, dropped %u, overwritten %u (%u while copied), high water %u\n", run.delivered,
+           st.dropped, st.overwritten, run.discarded, st.high_water);
+
+    check(run.backwards == 0, "sequence numbers only go up");
+    check(run.torn == 0, "no torn sample released as intact");
+    check(run.delivered + lost == sample_count, "delivered + dropped + overwritten = produced");
+    check(run.skipped == lost, "every gap in the sequence is counted");
+    if (policy == SAMPLE_RING_BACKPRESSURE) {
+        check(st.overwritten == 0, "nothing overwritten");
+    } else {
+        check(st.dropped == 0, "nothing dropped");
+    }
+    free(slots);
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            sample_count = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            depth = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            spin = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            pause_every = strtoul(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "Usage: %s [-n samples] [-d depth] [-s spin] [-p pause_every]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (depth == 0 || (depth & (depth - 1)) != 0) {
+        fprintf(stderr, "depth must be a power of two\n");
+        return 1;
+    }
+
+    run_policy(SAMPLE_RING_BACKPRESSURE, "BACKPRESSURE");
+    run_policy(SAMPLE_RING_OVERWRITE, "OVERWRITE");
+
+    if (failures) printf("%d checks failed\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "telemetry.h"
+#include "wake_trace.h"
+
+#define SIM_CLASS_MAX LOAD_CLASS_UNKNOWN
+#define SIM_ROW_PERIOD_MS 1000      // One CSV row per second of virtual time
+
+// Host simulator glue between host/hal_host.c, host/net_host.c and
+// host/sim_main.c. Not part of the firmware build.
+
+typedef struct {
+    float voltage;
+    float current;
+    float power;
+    float energy;
+    float frequency;
+    float pf;
+} sim_row_t;
+
+// Wake trace totals of the full wakes of one kind
+typedef struct {
+    uint32_t count;
+    uint64_t phase_sum_ms[WAKE_PHASE_COUNT];
+    uint32_t first_publish_max_ms;
+} sim_wake_stats_t;
+
+typedef struct {
+    uint64_t virtual_ms;
+    uint32_t boots;
+    uint32_t full_wakes;
+    uint32_t deep_sleeps;
+    uint32_t samples_sent;
+    uint32_t publishes;
+    uint32_t relay_toggles;
+    uint32_t uart_transactions;
+    uint64_t uart_bytes;         // Requests and replies on the wire
+    uint64_t payload_bytes;
+    uint32_t journal_samples;
+    uint32_t grid_events;
+    uint32_t rollup_messages;
+    uint64_t light_sleep_ms;     // hal_delay_ms, light sleep on the device
+    uint64_t deep_sleep_ms;      // Everything else is awake time
+    uint32_t class_samples[SIM_CLASS_MAX];   // Samples sent per load class
+    sim_wake_stats_t wakes[2];               // Full connect, cached AP
+} sim_stats_t;
+
+extern sim_stats_t sim_stats;
+extern int sim_log_level;    // 0 = E/W, 1 = +I, 2 = +D
+extern telemetry_format_t sim_payload_format;
+extern int sim_batch_max;
+extern uint32_t sim_batch_latency_ms;
+extern const char *sim_outbox_path;   // File standing in for the outbox partition
+extern uint32_t sim_outbox_size;
+
+int sim_load_csv(const char *path);
+uint32_t sim_row_count(void);
+void sim_row_data(uint32_t row, pzem_data_t *out);   // Row as the emulated PZEM reports it
+void sim_run(void);
+void sim_flush(void);
+void sim_wake_end(void);
+const uint64_t *sim_sent_times(uint32_t *count);     // Virtual ms of every sample sent
+uint64_t sim_now_ms(void);
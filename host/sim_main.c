@@ -0,0 +1,832 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sim.h"
+#include "hal.h"
+#include "outbox.h"
+#include "feature_window.h"
+#include "change_detector.h"
+#include "sample_scheduler.h"
+#include "protection.h"
+#include "metrics.h"
+#include "dlog.h"
+#include "grid_anomaly.h"
+#include "rollup.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+// Host simulator: replays dataset/*.csv through the real app_main and
+// sensor_logic_task on a virtual clock and reports what the firmware
+// would have done per hour of load.
+//
+// Build (from the repo root):
+//   cc -O2 -DHAL_HOST -Iinclude -Ihost -o pzem_sim main.c src/pzem_driver.c src/pzem_async.c src/modbus_crc.c src/telemetry.c src/outbox.c src/rtc_journal.c src/load_classifier.c src/feature_window.c src/change_detector.c src/sample_scheduler.c src/overload_guard.c src/protection.c src/grid_anomaly.c src/metrics.c src/dlog.c src/wake_trace.c src/rollup.c src/sensor_logic.c host/*.c -lm
+// Run:
+//   ./pzem_sim [-v] [-b] [-B samples[:ms]] [-O outbox.bin] [-C] [-G] [-M] [-r repeats] dataset/laptopdansolder.csv [more.csv ...]
+// Several files are concatenated into one continuous trace.
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-v|-vv] [-b] [-B samples[:ms]] [-O outbox.bin] [-C] [-G] [-M] [-r repeats] trace.csv [trace.csv ...]\n", prog);
+    fprintf(stderr, "  -b  binary telemetry payload instead of JSON\n");
+    fprintf(stderr, "  -B  batch up to samples (max %d) or ms per publish\n", TELEMETRY_BATCH_MAX);
+    fprintf(stderr, "  -O  benchmark the outbox on a one-day backlog in this file\n");
+    fprintf(stderr, "  -C  compare change detection policies on the trace at 1 Hz\n");
+    fprintf(stderr, "  -G  score the grid event detector on the trace with injected anomalies\n");
+    fprintf(stderr, "  -M  print the metrics snapshot as it would be published\n");
+}
+
+static void report(const char *label, uint32_t count, double hours) {
+    printf("%-18s %8u  (%9.1f / h)\n", label, count, hours > 0 ? count / hours : 0.0);
+}
+
+// Serializer cost on the host CPU, one sample re-encoded in a tight loop
+static void bench_serializer(void) {
+    const int iterations = 1000000;
+    telemetry_sample_t s = { .load_class = 1,
+                             .data = { .current_ma = 292, .power_dw = 585, .energy_wh = 216,
+                                       .voltage_dv = 2245, .freq_dhz = 500, .pf_cent = 90, .valid = true } };
+    uint8_t buf[TELEMETRY_JSON_MAX];
+    volatile int sink = 0;
+
+    clock_t start = clock();
+    for (int i = 0; i < iterations; i++) {
+        s.data.power_dw = 585 + (i & 0xFF);
+        s.relay = i & 1;
+        sink += telemetry_serialize(sim_payload_format, &s, buf, sizeof(buf));
+    }
+    double ns = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / iterations;
+    printf("Serialize time     %8.1f ns / msg (host)\n", ns);
+    (void)sink;
+}
+
+// Forest inference cost on the host CPU, spread over the dataset's range
+static void bench_classifier(void) {
+    const int iterations = 1000000;
+    pzem_data_t d = { .voltage_dv = 2240, .freq_dhz = 500, .valid = true };
+    uint32_t seed = 1;
+    volatile int sink = 0;
+
+    clock_t start = clock();
+    for (int i = 0; i < iterations; i++) {
+        seed = seed * 1103515245 + 12345;
+        d.power_dw = (seed >> 8) % 1500;
+        d.current_ma = (seed >> 4) % 1000;
+        d.pf_cent = (seed >> 16) % 101;
+        sink += load_classifier_predict(&d);
+    }
+    double ns = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / iterations;
+    printf("Classify time      %8.1f ns / sample (host)\n", ns);
+    (void)sink;
+}
+
+// Replays the loaded trace through a feature window, checks every channel
+// against a full recomputation of the same window, then times the update
+static void bench_features(void) {
+    enum { DEPTH = 32, SHIFT = 3 };
+    static feature_slot_t slots[DEPTH];
+    static uint32_t history[FEATURE_CHANNELS][DEPTH];
+    static int32_t ewma_q8[FEATURE_CHANNELS];
+    const uint32_t rows = sim_row_count();
+    pzem_data_t *trace = malloc(rows * sizeof(pzem_data_t));
+    feature_window_t fw;
+    uint32_t mismatches = 0;
+
+    if (!trace) return;
+    feature_window_init(&fw, slots, DEPTH, SHIFT);
+    for (uint32_t r = 0; r < rows; r++) {
+        pzem_data_t d;
+        sim_row_data(r, &d);
+        trace[r] = d;
+        feature_window_update(&fw, &d, r * 1000);
+
+        const uint32_t x[FEATURE_CHANNELS] = { d.power_dw, d.current_ma, d.voltage_dv, d.pf_cent };
+        const uint32_t n = r + 1 < DEPTH ? r + 1 : DEPTH;
+        for (int ch = 0; ch < FEATURE_CHANNELS; ch++) {
+            history[ch][r % DEPTH] = x[ch];
+            ewma_q8[ch] = r == 0 ? (int32_t)(x[ch] << 8) : ewma_q8[ch] + (((int32_t)(x[ch] << 8) - ewma_q8[ch]) >> SHIFT);
+
+            int64_t sum = 0, sum_kx = 0;
+            uint64_t sum_sq = 0;
+            uint32_t lo = UINT32_MAX, hi = 0;
+            for (uint32_t k = 0; k < n; k++) {
+                uint32_t v = history[ch][(r + 1 - n + k) % DEPTH];
+                sum += v;
+                sum_sq += (uint64_t)v * v;
+                sum_kx += (int64_t)k * v;
+                if (v < lo) lo = v;
+                if (v > hi) hi = v;
+            }
+            feature_stats_t st;
+            feature_window_get(&fw, ch, &st);
+            int64_t nn = n;
+            int32_t slope = n > 1 ? (int32_t)((nn * sum_kx - nn * (nn - 1) / 2 * sum) * 256 / (nn * nn * (nn * nn - 1) / 12)) : 0;
+            if (st.mean != (int32_t)(sum / nn) || st.min != lo || st.max != hi || st.slope_q8 != slope ||
+                st.variance != (uint64_t)(nn * (int64_t)sum_sq - sum * sum) / (uint64_t)(nn * nn) ||
+                st.ewma != ewma_q8[ch] >> 8) {
+                mismatches++;
+            }
+        }
+    }
+
+    const int passes = rows ? (1000000 + rows - 1) / rows : 0;
+    volatile uint32_t sink = 0;
+    clock_t start = clock();
+    for (int p = 0; p < passes; p++) {
+        for (uint32_t r = 0; r < rows; r++) {
+            feature_window_update(&fw, &trace[r], r * 1000);
+        }
+        sink += fw.ch[FEATURE_POWER].ewma_q8;
+    }
+    double ns = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / ((double)passes * rows);
+    printf("Feature window     %8.1f ns / sample (host, %u samples checked, %u mismatches)\n", ns, rows, mismatches);
+    free(trace);
+    (void)sink;
+}
+
+// The loaded trace at 1 Hz into a cleared rollup store: message volume of
+// publishing every reading raw against the closed buckets, a check of
+// the counts and energy, then the update cost
+static void bench_rollup(void) {
+    static char json[ROLLUP_JSON_MAX];
+    uint8_t raw[TELEMETRY_JSON_MAX];
+    const uint32_t rows = sim_row_count();
+    pzem_data_t *trace = malloc(rows * sizeof(pzem_data_t));
+    uint64_t raw_bytes = 0, rollup_bytes = 0;
+    uint32_t messages = 0, readings = 0, energy = 0;
+
+    if (!trace || rows == 0) {
+        free(trace);
+        return;
+    }
+    rollup_clear();
+    for (uint32_t r = 0; r < rows; r++) {
+        sim_row_data(r, &trace[r]);
+        telemetry_sample_t s = { .ts_ms = r * 1000, .data = trace[r] };
+        int len = telemetry_serialize(TELEMETRY_FMT_JSON, &s, raw, sizeof(raw));
+        raw_bytes += len > 0 ? len : 0;
+
+        uint8_t closed = rollup_add(&trace[r], r * 1000);
+        for (int level = 0; level < ROLLUP_LEVELS; level++) {
+            rollup_bucket_t b;
+            int done;
+            if (!(closed & (1 << level)) || !rollup_get(level, rollup_closed(level) - 1, &b)) continue;
+            len = rollup_render(level, &b, 1, r * 1000, json, sizeof(json), &done);
+            messages++;
+            rollup_bytes += len > 0 ? len : 0;
+            if (level == ROLLUP_MINUTE) {
+                readings += b.count;
+                energy += b.energy_wh;
+            }
+        }
+    }
+    // The open minute has the readings since the last close
+    uint32_t minute_end = (rows - 1) / 60;
+    uint32_t expected = minute_end * 60 < rows ? minute_end * 60 : rows;
+    uint32_t expected_wh = 0;
+    for (uint32_t r = 1; r < expected; r++) {
+        if (trace[r].energy_wh >= trace[r - 1].energy_wh) expected_wh += trace[r].energy_wh - trace[r - 1].energy_wh;
+    }
+    uint32_t mismatches = (readings != expected) + (energy != expected_wh);
+    printf("Rollups            %8u  messages, %llu bytes, against %u readings raw at 1 Hz in %llu bytes (%.1f %% of the messages, %.1f %% of the bytes)\n",
+           messages, (unsigned long long)rollup_bytes, rows, (unsigned long long)raw_bytes,
+           100.0 * messages / rows, raw_bytes ? 100.0 * rollup_bytes / raw_bytes : 0.0);
+
+    const int passes = (1000000 + rows - 1) / rows;
+    volatile uint32_t sink = 0;
+    rollup_clear();
+    clock_t start = clock();
+    for (int p = 0; p < passes; p++) {
+        for (uint32_t r = 0; r < rows; r++) {
+            sink += rollup_add(&trace[r], ((uint32_t)p * rows + r) * 1000);
+        }
+    }
+    double ns = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / ((double)passes * rows);
+    printf("Rollup update      %8.1f ns / reading (host), %u bytes of RTC state, %u mismatches\n", ns,
+           (unsigned)rollup_state_size(), mismatches);
+    rollup_clear();
+    free(trace);
+    (void)sink;
+}
+
+#define STEP_HALF_WINDOW  5     // Samples on each side of a reference step
+#define STEP_MIN_DW       50    // 5 W
+#define STEP_MATCH_S      30    // A publish this soon after a step detects it
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t median_power(const pzem_data_t *trace, uint32_t from) {
+    uint32_t v[STEP_HALF_WINDOW];
+    for (int i = 0; i < STEP_HALF_WINDOW; i++) v[i] = trace[from + i].power_dw;
+    qsort(v, STEP_HALF_WINDOW, sizeof(v[0]), cmp_u32);
+    return v[STEP_HALF_WINDOW / 2];
+}
+
+// Reference steps: the median power of the next samples differs from the
+// median of the previous ones by more than 5 W and 10 %, keeping only the
+// strongest point of each step. Returns a 0/1 flag per sample.
+static uint8_t *find_steps(const pzem_data_t *trace, uint32_t rows, uint32_t *count) {
+    uint8_t *step = calloc(rows, 1);
+    uint32_t *score = calloc(rows, sizeof(uint32_t));
+    *count = 0;
+    if (!step || !score) {
+        free(score);
+        return step;
+    }
+
+    for (uint32_t t = STEP_HALF_WINDOW; t + STEP_HALF_WINDOW <= rows; t++) {
+        uint32_t before = median_power(trace, t - STEP_HALF_WINDOW);
+        uint32_t after = median_power(trace, t);
+        uint32_t diff = before > after ? before - after : after - before;
+        uint32_t big = before > after ? before : after;
+        if (diff > STEP_MIN_DW && diff * 10 > big) score[t] = diff;
+    }
+    for (uint32_t t = 0; t < rows; t++) {
+        if (score[t] == 0) continue;
+        bool peak = true;
+        for (uint32_t u = t > STEP_HALF_WINDOW ? t - STEP_HALF_WINDOW : 0; u < rows && u <= t + STEP_HALF_WINDOW; u++) {
+            if (score[u] > score[t] || (score[u] == score[t] && u < t)) peak = false;
+        }
+        if (peak) {
+            step[t] = 1;
+            (*count)++;
+        }
+    }
+    free(score);
+    return step;
+}
+
+// Runs every policy over the loaded trace, one sample per second with no
+// sleep, and scores its publishes against the reference steps
+static void bench_change(void) {
+    static const struct { change_policy_t policy; const char *name; } policies[] = {
+        { CHANGE_POLICY_THRESHOLD, "threshold" },
+        { CHANGE_POLICY_CUSUM, "cusum" },
+        { CHANGE_POLICY_PAGE_HINKLEY, "page-hinkley" },
+    };
+    const uint32_t rows = sim_row_count();
+    pzem_data_t *trace = malloc(rows * sizeof(pzem_data_t));
+    uint32_t steps;
+
+    if (!trace) return;
+    for (uint32_t r = 0; r < rows; r++) sim_row_data(r, &trace[r]);
+    uint8_t *step = find_steps(trace, rows, &steps);
+    if (!step) {
+        free(trace);
+        return;
+    }
+
+    double hours = rows / 3600.0;
+    printf("Change detection over %u samples, %u reference steps\n", rows, steps);
+    printf("  %-13s %8s %8s %10s %8s %10s\n", "policy", "msgs", "detected", "delay (s)", "false", "false / h");
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        change_detector_t det;
+        uint32_t msgs = 0, detected = 0, false_msgs = 0, delay_sum = 0;
+        int64_t open_step = -1;   // Last step still waiting for its publish
+
+        change_detector_init(&det, policies[p].policy);
+        for (uint32_t t = 0; t < rows; t++) {
+            if (step[t]) open_step = t;
+            if (open_step >= 0 && t - open_step > STEP_MATCH_S) open_step = -1;
+            if (!change_detector_update(&det, &trace[t])) continue;
+
+            msgs++;
+            if (open_step >= 0) {
+                detected++;
+                delay_sum += t - (uint32_t)open_step;
+                open_step = -1;
+            } else {
+                false_msgs++;
+            }
+        }
+        printf("  %-13s %8u %5u/%-3u %10.1f %8u %10.1f\n", policies[p].name, msgs, detected, steps,
+               detected ? (double)delay_sum / detected : 0.0, false_msgs, false_msgs / hours);
+    }
+    free(step);
+    free(trace);
+}
+
+#define GRID_INJECT_EVERY_S  90    // One synthetic anomaly per this many samples
+#define GRID_INJECT_CLEAR_S  15    // Kept this far from load steps and each other
+
+typedef struct {
+    grid_event_type_t type;
+    uint32_t start;
+    uint32_t len;
+    bool matched;
+} grid_truth_t;
+
+// A resistive load follows the voltage: I ~ V, P ~ V^2
+static void scale_voltage(pzem_data_t *d, int32_t dv) {
+    double k = (d->voltage_dv + dv) / (double)d->voltage_dv;
+    d->voltage_dv += dv;
+    d->current_ma = (uint32_t)(d->current_ma * k + 0.5);
+    d->power_dw = (uint32_t)(d->power_dw * k * k + 0.5);
+}
+
+// Replays the trace at 1 Hz through the grid detector with surges, sags
+// and frequency excursions injected between the load steps. Load events
+// are scored against the reference steps, the rest against the
+// injections: detection latency, precision and false events per hour.
+static void bench_grid(void) {
+    const grid_config_t cfg = GRID_CONFIG_DEFAULTS;
+    const uint32_t rows = sim_row_count();
+    pzem_data_t *trace = malloc(rows * sizeof(pzem_data_t));
+    grid_truth_t *truth = calloc(rows / 4 + 1, sizeof(grid_truth_t));
+    uint32_t steps, n = 0, seed = 12345;
+
+    if (!trace || !truth) {
+        free(trace);
+        free(truth);
+        return;
+    }
+    for (uint32_t r = 0; r < rows; r++) sim_row_data(r, &trace[r]);
+    uint8_t *step = find_steps(trace, rows, &steps);
+    if (!step) {
+        free(trace);
+        free(truth);
+        return;
+    }
+
+    // Reference load steps, on or off by the medians around them
+    for (uint32_t t = 0; t < rows; t++) {
+        if (!step[t]) continue;
+        bool on = median_power(trace, t) > median_power(trace, t - STEP_HALF_WINDOW);
+        truth[n++] = (grid_truth_t){ on ? GRID_EVENT_LOAD_ON : GRID_EVENT_LOAD_OFF, t, 1, false };
+    }
+
+    // Injections, cycling through the types, where nothing else happens
+    static const grid_event_type_t kinds[] = { GRID_EVENT_SURGE, GRID_EVENT_SAG, GRID_EVENT_FREQUENCY };
+    uint32_t injected = 0;
+    for (uint32_t t = GRID_INJECT_EVERY_S; t + GRID_INJECT_CLEAR_S < rows; t += GRID_INJECT_EVERY_S) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t start = t + (seed >> 16) % (GRID_INJECT_EVERY_S / 2);
+        uint32_t len = 1 + (seed >> 8) % 5;
+        bool clear = start + len + GRID_INJECT_CLEAR_S < rows;
+        for (uint32_t u = start > GRID_INJECT_CLEAR_S ? start - GRID_INJECT_CLEAR_S : 0;
+             clear && u < start + len + GRID_INJECT_CLEAR_S; u++) {
+            if (step[u]) clear = false;
+        }
+        if (!clear) continue;
+
+        grid_event_type_t kind = kinds[injected++ % 3];
+        int32_t size = 60 + (int32_t)((seed >> 4) % 250);   // 6 .. 31 V
+        for (uint32_t u = start; u < start + len; u++) {
+            if (kind == GRID_EVENT_SURGE) {
+                scale_voltage(&trace[u], size);
+            } else if (kind == GRID_EVENT_SAG) {
+                scale_voltage(&trace[u], -size);
+            } else {
+                trace[u].freq_dhz = (uint16_t)(cfg.nominal_dhz + ((seed & 1) ? 1 : -1) * (6 + (int32_t)(seed >> 20) % 10));
+            }
+        }
+        truth[n++] = (grid_truth_t){ kind, start, len, false };
+    }
+
+    grid_anomaly_t g;
+    grid_event_t ev;
+    uint32_t reported[GRID_EVENT_TYPES] = {0}, hits[GRID_EVENT_TYPES] = {0}, total[GRID_EVENT_TYPES] = {0};
+    uint32_t delay_sum[GRID_EVENT_TYPES] = {0}, critical = 0, trips = 0;
+    bool was_open = false;
+    for (uint32_t k = 0; k < n; k++) total[truth[k].type]++;
+
+    grid_anomaly_init(&g, &cfg);
+    for (uint32_t t = 0; t < rows; t++) {
+        bool fired = grid_anomaly_update(&g, &trace[t], t * 1000, &ev);
+        if (grid_anomaly_open(&g) && !was_open) trips++;
+        was_open = grid_anomaly_open(&g);
+        if (!fired) continue;
+
+        reported[ev.type]++;
+        if (ev.severity == GRID_SEVERITY_CRITICAL) critical++;
+        bool load = ev.type == GRID_EVENT_LOAD_ON || ev.type == GRID_EVENT_LOAD_OFF;
+        for (uint32_t k = 0; k < n; k++) {
+            grid_truth_t *tr = &truth[k];
+            bool in_time = load ? t + STEP_HALF_WINDOW >= tr->start && t <= tr->start + STEP_HALF_WINDOW
+                                : t >= tr->start && t <= tr->start + tr->len;
+            if (tr->type == ev.type && !tr->matched && in_time) {
+                tr->matched = true;
+                hits[ev.type]++;
+                delay_sum[ev.type] += t > tr->start ? t - tr->start : 0;
+                break;
+            }
+        }
+    }
+
+    double hours = rows / 3600.0;
+    printf("Grid events over %u samples, %u reference steps, %u injected\n", rows, steps, injected);
+    printf("  %-10s %8s %8s %10s %10s %10s\n", "event", "truth", "detected", "delay (s)", "precision", "false / h");
+    for (int type = GRID_EVENT_LOAD_ON; type < GRID_EVENT_TYPES; type++) {
+        uint32_t false_events = reported[type] - hits[type];
+        printf("  %-10s %8u %5u/%-3u %10.1f %9.1f%% %10.1f\n", grid_event_name(type), total[type], hits[type],
+               total[type], hits[type] ? (double)delay_sum[type] / hits[type] : 0.0,
+               reported[type] ? 100.0 * hits[type] / reported[type] : 100.0, false_events / hours);
+    }
+    printf("  %u critical, %u relay trips\n", critical, trips);
+
+    // Cost per reading on the unmodified trace
+    const int passes = rows ? (1000000 + rows - 1) / rows : 0;
+    volatile uint32_t sink = 0;
+    for (uint32_t r = 0; r < rows; r++) sim_row_data(r, &trace[r]);
+    clock_t start = clock();
+    for (int p = 0; p < passes; p++) {
+        grid_anomaly_init(&g, &cfg);
+        for (uint32_t r = 0; r < rows; r++) {
+            sink += grid_anomaly_update(&g, &trace[r], r * 1000, &ev);
+        }
+    }
+    double ns = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / ((double)passes * rows);
+    printf("  %.1f ns / reading (host), %zu bytes of state\n", ns, sizeof(grid_anomaly_t));
+    (void)sink;
+    free(step);
+    free(truth);
+    free(trace);
+}
+
+// Rough ESP32 supply current per state, only meant to compare policies
+#define MA_AWAKE          40.0             // CPU on, UART, WiFi in modem sleep
+#define MA_LIGHT_SLEEP    2.0              // Between samples, WiFi associated
+#define MA_DEEP_SLEEP     0.01
+#define MAS_PUBLISH       (150.0 * 0.02)   // TX burst per MQTT publish
+#define MAS_FULL_WAKE     (120.0 * 1.5)    // WiFi association and DHCP
+
+static void report_power(void) {
+    double awake_s = (sim_stats.virtual_ms - sim_stats.light_sleep_ms - sim_stats.deep_sleep_ms) / 1e3;
+    double mas = awake_s * MA_AWAKE + sim_stats.light_sleep_ms / 1e3 * MA_LIGHT_SLEEP +
+                 sim_stats.deep_sleep_ms / 1e3 * MA_DEEP_SLEEP +
+                 sim_stats.publishes * MAS_PUBLISH + sim_stats.full_wakes * MAS_FULL_WAKE;
+    printf("Time awake/light/deep  %.0f / %.0f / %.0f s\n", awake_s, sim_stats.light_sleep_ms / 1e3,
+           sim_stats.deep_sleep_ms / 1e3);
+    printf("Avg supply current %8.2f mA (model)\n", sim_stats.virtual_ms ? mas / (sim_stats.virtual_ms / 1e3) : 0.0);
+}
+
+// How long after each reference step the firmware sent its first sample
+static void report_step_latency(void) {
+    const uint32_t rows = sim_row_count();
+    pzem_data_t *trace = malloc(rows * sizeof(pzem_data_t));
+    uint32_t steps, sent_count, detected = 0, next = 0;
+    uint64_t sum = 0, worst = 0;
+
+    if (!trace) return;
+    for (uint32_t r = 0; r < rows; r++) sim_row_data(r, &trace[r]);
+    uint8_t *step = find_steps(trace, rows, &steps);
+    const uint64_t *sent = sim_sent_times(&sent_count);
+
+    for (uint32_t t = 0; step && t < rows; t++) {
+        if (!step[t]) continue;
+        uint64_t at = (uint64_t)t * SIM_ROW_PERIOD_MS;
+        while (next < sent_count && sent[next] < at) next++;
+        if (next < sent_count && sent[next] - at <= STEP_MATCH_S * 1000) {
+            uint64_t latency = sent[next] - at;
+            detected++;
+            sum += latency;
+            if (latency > worst) worst = latency;
+        }
+    }
+    printf("Step latency       %8.0f ms mean, %llu ms max (%u/%u steps)\n", detected ? (double)sum / detected : 0.0,
+           (unsigned long long)worst, detected, steps);
+    free(step);
+    free(trace);
+}
+
+// Full wakes by how WiFi connected: mean time of each phase after boot
+static void report_wakes(void) {
+    static const char *const kinds[] = { "full connect", "cached AP" };
+    for (int k = 0; k < 2; k++) {
+        const sim_wake_stats_t *w = &sim_stats.wakes[k];
+        if (w->count == 0) continue;
+        printf("Wake, %-12s %3u  ", kinds[k], w->count);
+        for (int i = 0; i < WAKE_PHASE_COUNT; i++) {
+            printf("%s%s %llu", i ? ", " : "", wake_phase_name((wake_phase_t)i),
+                   (unsigned long long)(w->phase_sum_ms[i] / w->count));
+        }
+        printf(" ms mean, first publish max %u ms\n", w->first_publish_max_ms);
+    }
+}
+
+// Overload fast path: trips and the time from request to relay
+static void report_protection(void) {
+    protection_stats_t st;
+    protection_get_stats(&st);
+    printf("Overload trips     %8u  (%u instantaneous, %u curve, %u recloses, %u lockouts)\n",
+           st.trips_instant + st.trips_curve, st.trips_instant, st.trips_curve, st.recloses, st.lockouts);
+    printf("Grid events        %8u  (%u load on, %u load off, %u surge, %u sag, %u frequency, %u surge trips)\n",
+           st.grid_events[GRID_EVENT_LOAD_ON] + st.grid_events[GRID_EVENT_LOAD_OFF] +
+               st.grid_events[GRID_EVENT_SURGE] + st.grid_events[GRID_EVENT_SAG] + st.grid_events[GRID_EVENT_FREQUENCY],
+           st.grid_events[GRID_EVENT_LOAD_ON], st.grid_events[GRID_EVENT_LOAD_OFF], st.grid_events[GRID_EVENT_SURGE],
+           st.grid_events[GRID_EVENT_SAG], st.grid_events[GRID_EVENT_FREQUENCY], st.grid_trips);
+    if (st.actuations) {
+        printf("Relay actuation    %8.1f ms mean, p50 %u, p99 %u, max %u ms after the request (%u reads, %u failed)\n",
+               (double)st.latency_sum_ms / st.actuations, protection_latency_percentile(&st, 50),
+               protection_latency_percentile(&st, 99), st.latency_max_ms, st.samples, st.failed_reads);
+    }
+    if (st.samples) {
+        printf("Fast path reads    %8u  (%u full, %u voltage / current / power only, %u alarm threshold writes)\n",
+               st.samples, st.full_reads, st.samples - st.full_reads, st.alarm_writes);
+    }
+}
+
+// Each curve fed a constant overload from cold at the fast-path rate:
+// measured trip time against the closed form, for 1.1x to 1.9x rated
+static void bench_trip_curves(void) {
+    static const char *names[] = { "I2t", "inverse", "definite" };
+    const uint16_t loads[] = { 110, 125, 150, 175, 190 };
+    uint32_t worst = 0;
+
+    printf("Trip curve (ms)    ");
+    for (unsigned l = 0; l < sizeof(loads) / sizeof(loads[0]); l++) printf(" %6u%%", loads[l]);
+    printf("\n");
+    for (int c = OVERLOAD_CURVE_I2T; c <= OVERLOAD_CURVE_DEFINITE; c++) {
+        overload_config_t cfg = { .rated_dw = 800, .instant_dw = 1600, .curve = c, .ref_ratio_pct = 150,
+                                  .ref_ms = 2000, .hysteresis_pct = 5, .reset_ms = 10000,
+                                  .reclose = OVERLOAD_RECLOSE_NEVER };
+        printf("  %-16s ", names[c]);
+        for (unsigned l = 0; l < sizeof(loads) / sizeof(loads[0]); l++) {
+            overload_guard_t g;
+            uint32_t p = cfg.rated_dw * loads[l] / 100, t = 0;
+            overload_guard_init(&g, &cfg);
+            while (overload_guard_update(&g, p, t) == OVERLOAD_NONE && t < 600000) t += PROTECTION_PERIOD_MS;
+            uint32_t expect = overload_guard_trip_ms(&g, p);
+            if (t - expect > worst) worst = t - expect;
+            printf(" %7u", t);
+        }
+        printf("\n");
+    }
+    printf("  %-16s  %u ms (one read period is %d ms)\n", "Worst overshoot", worst, PROTECTION_PERIOD_MS);
+}
+
+// The registry against the simulator's own counts, then its cost
+static void report_metrics(bool dump) {
+    static char text[METRICS_RENDER_MAX];
+    const int iterations = 10000000;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int len = metrics_render(text, sizeof(text), "sim");
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double render_us = (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) / 1e3;
+
+    bool agree = metrics_counter(METRIC_DEEP_SLEEPS) == sim_stats.deep_sleeps &&
+                 metrics_counter(METRIC_PUBLISHES) == sim_stats.publishes;
+    printf("Metrics            %8u samples, %u failed reads, %u CRC errors, %u deep sleeps (%s)\n",
+           metrics_counter(METRIC_PZEM_SAMPLES), metrics_counter(METRIC_PZEM_READ_FAILURES),
+           metrics_counter(METRIC_PZEM_CRC_ERRORS), metrics_counter(METRIC_DEEP_SLEEPS),
+           agree ? "match the simulator" : "MISMATCH");
+    printf("Metrics snapshot   %8d bytes, rendered in %.1f us (host)\n", len, render_us);
+    if (dump && len > 0) {
+        fwrite(text, 1, (size_t)len, stdout);
+    }
+
+    // Recording cost, after the snapshot since it adds to the counts
+    clock_t start = clock();
+    for (int i = 0; i < iterations; i++) {
+        metrics_inc(METRIC_OTA_CHECKS);
+    }
+    double inc_ns = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / iterations;
+    start = clock();
+    for (int i = 0; i < iterations; i++) {
+        metrics_observe_us(METRIC_SERIALIZE, (uint32_t)i & 0xFFFFF);
+    }
+    double observe_ns = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / iterations;
+    printf("Metrics cost       %8.1f ns / counter, %.1f ns / histogram sample (host)\n", inc_ns, observe_ns);
+}
+
+static uint64_t tsc(void) {
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// The per-sample reading line: formatted in place, as ESP_LOGI does before
+// the text even reaches the console UART, against a deferred record. The
+// ring is drained between batches, outside the timed part.
+static void bench_dlog(void) {
+    enum { BATCH = DLOG_DEPTH / 2, BATCHES = 20000 };
+    pzem_data_t d = { .voltage_dv = 2245, .current_ma = 292, .power_dw = 585, .energy_wh = 216,
+                      .freq_dhz = 500, .pf_cent = 90, .valid = true };
+    char line[DLOG_TEXT_MAX];
+    dlog_record_t rec;
+    volatile int sink = 0;
+    uint64_t direct = 0, deferred = 0, drain = 0;
+    uint64_t direct_ns = 0, deferred_ns = 0, drain_ns = 0;
+    struct timespec t0, t1;
+
+    for (int b = 0; b < BATCHES; b++) {
+        uint64_t c0 = tsc();
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int i = 0; i < BATCH; i++) {
+            d.power_dw = 585 + i;
+            sink += snprintf(line, sizeof(line), "V: %u.%u V | I: %lu.%03lu A | P: %lu.%lu W | F: %u.%u | E: %lu Wh | PF : %u.%02u",
+                             d.voltage_dv / 10, d.voltage_dv % 10,
+                             (unsigned long)d.current_ma / 1000, (unsigned long)d.current_ma % 1000,
+                             (unsigned long)d.power_dw / 10, (unsigned long)d.power_dw % 10,
+                             d.freq_dhz / 10, d.freq_dhz % 10, (unsigned long)d.energy_wh,
+                             d.pf_cent / 100, d.pf_cent % 100);
+        }
+        uint64_t c1 = tsc();
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        direct += c1 - c0;
+        direct_ns += (t1.tv_sec - t0.tv_sec) * 1000000000ull + t1.tv_nsec - t0.tv_nsec;
+
+        t0 = t1;
+        for (int i = 0; i < BATCH; i++) {
+            d.power_dw = 585 + i;
+            DLOG(DLOG_READING, d.voltage_dv / 10, d.voltage_dv % 10, d.current_ma / 1000, d.current_ma % 1000,
+                 d.power_dw / 10, d.power_dw % 10, d.freq_dhz / 10, d.freq_dhz % 10, d.energy_wh,
+                 d.pf_cent / 100, d.pf_cent % 100);
+        }
+        uint64_t c2 = tsc();
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        deferred += c2 - c1;
+        deferred_ns += (t1.tv_sec - t0.tv_sec) * 1000000000ull + t1.tv_nsec - t0.tv_nsec;
+
+        t0 = t1;
+        while (dlog_read(&rec)) {
+            sink += dlog_format(&rec, line, sizeof(line));
+        }
+        drain += tsc() - c2;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        drain_ns += (t1.tv_sec - t0.tv_sec) * 1000000000ull + t1.tv_nsec - t0.tv_nsec;
+    }
+
+    double calls = (double)BATCH * BATCHES;
+    printf("Log call           %8.1f ns formatted, %.1f ns deferred, %.1f ns to drain later (host)\n",
+           direct_ns / calls, deferred_ns / calls, drain_ns / calls);
+#ifdef HAVE_TSC
+    printf("Log call cycles    %8.0f formatted, %.0f deferred, %.0f to drain later (TSC)\n", direct / calls,
+           deferred / calls, drain / calls);
+#endif
+    printf("Log records lost   %8lu  (ring of %d)\n", (unsigned long)dlog_dropped(), DLOG_DEPTH);
+    (void)sink;
+}
+
+static double elapsed_ms(struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// A day of 1 Hz samples appended while offline, then replayed in
+// publisher-sized batches, with a reboot (recovery) in between. The RTC
+// restarts about halfway through, as on a power cycle, and no batch may span it.
+// The first record is torn and its first batch refused once: it must be
+// counted as dropped once and never as replayed.
+static void bench_outbox(void) {
+    const uint32_t samples = 86400;
+    const uint32_t power_cycle = samples / 2 + 7;      // Not on a batch boundary
+    telemetry_sample_t batch[TELEMETRY_BATCH_MAX];
+    struct timespec start;
+    outbox_stats_t st;
+
+    sim_outbox_size = ((samples / (OUTBOX_SEGMENT_SIZE / OUTBOX_RECORD_SIZE - 1)) + 2) * OUTBOX_SEGMENT_SIZE;
+    remove(sim_outbox_path);
+    if (!outbox_init()) {
+        printf("Outbox             unavailable\n");
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < samples; i++) {
+        telemetry_sample_t s = { .ts_ms = (i < power_cycle ? i : i - power_cycle) * 1000, .relay = false, .load_class = LOAD_CLASS_UNKNOWN,
+                                 .data = { .voltage_dv = 2240, .current_ma = 290 + i % 50,
+                                           .power_dw = 585 + i % 100, .energy_wh = 216 + i / 3600,
+                                           .freq_dhz = 500, .pf_cent = 90, .valid = true } };
+        outbox_append(&s);
+    }
+    double append_ms = elapsed_ms(&start);
+    outbox_get_stats(&st);
+    printf("Outbox append      %8u  (%.0f records/s, %lu KB, %lu erases)\n", samples,
+           samples / (append_ms / 1e3), (unsigned long)(st.segments * OUTBOX_SEGMENT_SIZE / 1024), (unsigned long)st.erases);
+
+    static const uint8_t torn = 0x00;
+    hal_outbox_write(OUTBOX_RECORD_SIZE + 8, &torn, 1);   // Segment 0 slot 1, the oldest
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    outbox_init();
+    double recover_ms = elapsed_ms(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint32_t replayed = 0, batches = 0, spanning = 0;
+    int n;
+    outbox_peek(batch, TELEMETRY_BATCH_MAX);               // Publish refused, peeked again below
+    while ((n = outbox_peek(batch, TELEMETRY_BATCH_MAX)) > 0) {
+        outbox_consume();
+        replayed += n;
+        batches++;
+        spanning += batch[n - 1].ts_ms < batch[0].ts_ms;
+    }
+    double replay_ms = elapsed_ms(&start);
+    outbox_get_stats(&st);
+
+    printf("Outbox recovery    %8.2f ms\n", recover_ms);
+    printf("Outbox replay      %8u  (%.1f ms, %lu dropped, %lu counted as replayed)\n", replayed, replay_ms,
+           (unsigned long)st.dropped, (unsigned long)st.replayed);
+    printf("Outbox batches     %8u  (%u across a power cycle)\n", batches, spanning);
+}
+
+int main(int argc, char **argv) {
+    int repeats = 1;
+    bool change_bench = false;
+    bool metrics_dump = false;
+    bool grid_bench = false;
+    int first_file = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            sim_log_level = 1;
+        } else if (strcmp(argv[i], "-vv") == 0) {
+            sim_log_level = 2;
+        } else if (strcmp(argv[i], "-b") == 0) {
+            sim_payload_format = TELEMETRY_FMT_BINARY;
+        } else if (strcmp(argv[i], "-B") == 0 && i + 1 < argc) {
+            char *colon;
+            sim_batch_max = (int)strtol(argv[++i], &colon, 10);
+            if (*colon == ':') sim_batch_latency_ms = (uint32_t)strtoul(colon + 1, NULL, 10);
+            if (sim_batch_max < 1 || sim_batch_max > TELEMETRY_BATCH_MAX) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-O") == 0 && i + 1 < argc) {
+            sim_outbox_path = argv[++i];
+        } else if (strcmp(argv[i], "-C") == 0) {
+            change_bench = true;
+        } else if (strcmp(argv[i], "-M") == 0) {
+            metrics_dump = true;
+        } else if (strcmp(argv[i], "-G") == 0) {
+            grid_bench = true;
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            repeats = atoi(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            first_file = i;
+            break;
+        }
+    }
+    if (first_file == 0 || repeats < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (int r = 0; r < repeats; r++) {
+        for (int i = first_file; i < argc; i++) {
+            if (sim_load_csv(argv[i]) < 0) {
+                fprintf(stderr, "Cannot read %s\n", argv[i]);
+                return 1;
+            }
+        }
+    }
+
+    sim_run();
+
+    double hours = sim_stats.virtual_ms / 3600000.0;
+    printf("Samples replayed   %8u  (%.2f h virtual)\n", sim_row_count(), hours);
+    report("Boots", sim_stats.boots, hours);
+    report("Full wakes", sim_stats.full_wakes, hours);
+    report("Deep sleeps", sim_stats.deep_sleeps, hours);
+    report("Samples sent", sim_stats.samples_sent, hours);
+    report("Journal samples", sim_stats.journal_samples, hours);
+    report("MQTT publishes", sim_stats.publishes, hours);
+    report("Relay toggles", sim_stats.relay_toggles, hours);
+    report("Grid events", sim_stats.grid_events, hours);
+    report("Rollup messages", sim_stats.rollup_messages, hours);
+    report("UART transactions", sim_stats.uart_transactions, hours);
+    printf("UART bytes         %8llu  (%.1f / transaction)\n", (unsigned long long)sim_stats.uart_bytes,
+           sim_stats.uart_transactions ? (double)sim_stats.uart_bytes / sim_stats.uart_transactions : 0.0);
+    printf("Payload bytes      %8llu  (%.1f / msg)\n", (unsigned long long)sim_stats.payload_bytes,
+           sim_stats.publishes ? (double)sim_stats.payload_bytes / sim_stats.publishes : 0.0);
+    for (int c = 0; c < load_classifier_class_count(); c++) {
+        if (sim_stats.class_samples[c] == 0) continue;
+        printf("  %-16s %8u  (%5.1f %%)\n", load_classifier_name(c), sim_stats.class_samples[c],
+               100.0 * sim_stats.class_samples[c] / sim_stats.samples_sent);
+    }
+    report_wakes();
+    report_protection();
+    bench_trip_curves();
+    report_power();
+    report_step_latency();
+    bench_serializer();
+    bench_classifier();
+    bench_features();
+    bench_rollup();
+    bench_dlog();
+    report_metrics(metrics_dump);
+    if (sim_outbox_path) {
+        bench_outbox();
+    }
+    if (change_bench) {
+        bench_change();
+    }
+    if (grid_bench) {
+        bench_grid();
+    }
+    return 0;
+}
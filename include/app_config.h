@@ -0,0 +1,32 @@
+#pragma once
+
+// Settings shared by the firmware and the host tools that stand in for
+// it (host/fleet/fleet_sim.c), so the two cannot drift apart.
+
+// Thresholds in raw PZEM units (see common_structs.h)
+#define OVERLOAD_POWER_DW     800   // 80.0 W
+
+// What counts as a load change, for both the wake check and the task.
+// CHANGE_POLICY_THRESHOLD is the old fixed 1.0 W / 0.1 A / 1.0 V test.
+#define CHANGE_POLICY CHANGE_POLICY_CUSUM
+
+// 1 = publish only when the load classifier changes its mind,
+// 0 = publish when the change detector fires (every sample carries its class)
+#define PUBLISH_ON_CLASS_CHANGE_ONLY 0
+
+// 90s to give OTA time to finish
+#define IDLE_TIMEOUT_MS 90000
+
+// MQTT topics
+#define MQTT_TOPIC      "esp32/pzem/data"
+#define MQTT_TOPIC_BIN  "esp32/pzem/bin"
+#define MQTT_TOPIC_BATCH     "esp32/pzem/batch"
+#define MQTT_TOPIC_BATCH_BIN "esp32/pzem/batch/bin"
+#define MQTT_TOPIC_REPLAY     "esp32/pzem/replay"
+#define MQTT_TOPIC_REPLAY_BIN "esp32/pzem/replay/bin"
+#define MQTT_TOPIC_JOURNAL    "esp32/pzem/journal"
+#define MQTT_TOPIC_METRICS    "esp32/pzem/metrics"
+#define MQTT_TOPIC_EVENTS     "esp32/pzem/events"
+#define MQTT_TOPIC_ROLLUP       "esp32/pzem/rollup"
+#define MQTT_TOPIC_ROLLUP_QUERY "esp32/pzem/rollup/query"
+#define MQTT_TOPIC_ROLLUP_REPLY "esp32/pzem/rollup/reply"
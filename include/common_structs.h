@@ -1,12 +1,24 @@
 #pragma once
+#include <stdint.h>
 #include <stdbool.h>
 
+// Raw PZEM register units, convert only at the output edge
 typedef struct {
-    float voltage;
-    float current;
-    float power;
-    float energy;
-    float frequency;
-    float pf;
+    uint32_t current_ma;    // mA
+    uint32_t power_dw;      // 0.1 W
+    uint32_t energy_wh;     // Wh
+    uint16_t voltage_dv;    // 0.1 V
+    uint16_t freq_dhz;      // 0.1 Hz
+    uint16_t pf_cent;       // 0.01
     bool valid;
-} pzem_data_t;
\ No newline at end of file
+    uint8_t slave;          // Modbus address of the meter that answered
+    bool alarm;             // Power over the meter's alarm threshold, if register 0x0009 was read
+} pzem_data_t;
+
+// Unit scales (raw / scale = engineering unit)
+#define PZEM_VOLTAGE_SCALE   10
+#define PZEM_CURRENT_SCALE   1000
+#define PZEM_POWER_SCALE     10
+#define PZEM_ENERGY_SCALE    1000   // Wh -> kWh
+#define PZEM_FREQ_SCALE      10
+#define PZEM_PF_SCALE        100
@@ -0,0 +1,74 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "dlog_messages.h"
+
+// Deferred logging for hot paths. DLOG records a message id, a timestamp
+// and the raw argument words into a lock-free RAM ring, nothing else: no
+// printf, no console UART. The lowest-priority task (dlog_task) formats
+// the records later from the string table in dlog_messages.h and hands
+// them to the normal log output.
+//
+// Any task on either core may log (multi-producer, Vyukov-style slots).
+// When the ring is full the new record is dropped and counted, the drain
+// reports how many were lost. The ring is in RAM, so dlog_flush before
+// deep sleep to keep what is in it.
+
+#define DLOG_DEPTH       64      // Records, power of two
+#define DLOG_MAX_ARGS    12
+#define DLOG_TEXT_MAX    192     // Formatted message, longer is cut
+#define DLOG_DRAIN_MS    50      // dlog_task polling period
+
+// Records below this level are compiled out ('E', 'W', 'I' or 'D').
+// The simulator keeps everything and filters on -v at output.
+#ifndef DLOG_LEVEL
+#ifdef HAL_HOST
+#define DLOG_LEVEL 'D'
+#else
+#define DLOG_LEVEL 'I'
+#endif
+#endif
+
+#define DLOG_RANK(level) ((level) == 'E' ? 1 : (level) == 'W' ? 2 : (level) == 'I' ? 3 : 4)
+
+typedef uintptr_t dlog_arg_t;
+
+#define DLOG_ENUM(id, level, tag, fmt) id,
+typedef enum { DLOG_MESSAGES(DLOG_ENUM) DLOG_MESSAGE_COUNT } dlog_id_t;
+#undef DLOG_ENUM
+
+#define DLOG_LEVEL_ENUM(id, level, tag, fmt) id##_RANK = DLOG_RANK(level),
+enum { DLOG_MESSAGES(DLOG_LEVEL_ENUM) };
+#undef DLOG_LEVEL_ENUM
+
+// DLOG(DLOG_READING, a, b, ...): arguments in the order of the format
+#define DLOG(id, ...) do { \
+    if (id##_RANK <= DLOG_RANK(DLOG_LEVEL)) { \
+        const dlog_arg_t dlog_args_[] = { 0, ##__VA_ARGS__ }; \
+        dlog_write(id, sizeof(dlog_args_) / sizeof(dlog_args_[0]) - 1, dlog_args_ + 1); \
+    } \
+} while (0)
+
+// For %s: the string must outlive the record
+#define DLOG_STR(s) ((dlog_arg_t)(const char *)(s))
+
+typedef struct {
+    uint16_t id;
+    uint8_t nargs;
+    uint32_t ts_ms;                 // hal_millis when recorded
+    dlog_arg_t args[DLOG_MAX_ARGS];
+} dlog_record_t;
+
+void dlog_write(dlog_id_t id, int nargs, const dlog_arg_t *args);
+
+// Consumer side, one at a time (dlog_flush and dlog_task take turns)
+bool dlog_read(dlog_record_t *rec);
+int dlog_format(const dlog_record_t *rec, char *buf, size_t len);
+void dlog_flush(void);
+void dlog_task(void *arg);
+
+char dlog_level(dlog_id_t id);
+const char *dlog_tag(dlog_id_t id);
+const char *dlog_format_string(dlog_id_t id);
+uint32_t dlog_dropped(void);
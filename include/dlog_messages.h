@@ -0,0 +1,26 @@
+#pragma once
+
+// String table of the deferred log (dlog.h). The position in this list is
+// the id a record carries, so append rather than reorder if something
+// outside the firmware keeps records.
+//
+// Arguments are integers or, with DLOG_STR, pointers to strings that live
+// for the whole run (literals, name tables). Formats use printf syntax
+// with d i u x X c s and an optional l.
+
+// id, level, tag, format
+#define DLOG_MESSAGES(X) \
+    X(DLOG_CHANGE,            'I', "MAIN_APP",    "Change detected (0x%x). Sending MQTT (P noise: %lu dW, %s)") \
+    X(DLOG_NO_CHANGE,         'D', "MAIN_APP",    "No change. (Idle for %lu ms)") \
+    X(DLOG_READING,           'I', "MAIN_APP",    "V: %u.%u V | I: %lu.%03lu A | P: %lu.%lu W | F: %u.%u | E: %lu Wh | PF : %u.%02u") \
+    X(DLOG_POWER_WINDOW,      'D', "MAIN_APP",    "P window (%lu): mean %ld dW | min %lu | max %lu | ewma %ld | slope %ld/256 per sample | E rate %lu dW") \
+    X(DLOG_NEXT_SAMPLE,       'D', "MAIN_APP",    "Next sample in %lu ms (%s)") \
+    X(DLOG_READ_FAILED,       'W', "MAIN_APP",    "Sensor Read Failed") \
+    X(DLOG_OVERLOAD_TRIP,     'E', "PROTECTION",  "Overload %lu dW, %s trip%s") \
+    X(DLOG_OVERLOAD_RECLOSE,  'I', "PROTECTION",  "Overload cleared, relay reclosed") \
+    X(DLOG_PZEM_NO_REPLY,     'W', "PZEM_ASYNC",  "No reply from 0x%02X (status %d)") \
+    X(DLOG_PZEM_CRC,          'W', "PZEM_DRIVER", "CRC Error") \
+    X(DLOG_RING_FULL,         'W', "MQTT_MGR",    "Ring full, dropping packet") \
+    X(DLOG_REPLAYED,          'I', "MQTT_MGR",    "Replayed %d samples, %lu left") \
+    X(DLOG_GRID_EVENT,        'I', "PROTECTION",  "Grid %s (%s): V %u dV (%+d), P %+ld dW, F %+d dHz") \
+    X(DLOG_PZEM_EXCEPTION,    'W', "PZEM_ASYNC",  "Function 0x%02X refused by 0x%02X (exception %u)")
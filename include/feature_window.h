@@ -0,0 +1,71 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "common_structs.h"
+
+// Streaming window statistics over the last N samples of power, current,
+// voltage and PF. Every update is O(1) (min/max amortized O(1) through
+// monotonic queues), the history lives in caller-provided slots and
+// everything is integer raw PZEM units (see common_structs.h).
+//
+// One window is fed once per sample by the sensor task; classification,
+// change detection and publishing read their features from it instead
+// of keeping their own history.
+
+typedef enum {
+    FEATURE_POWER,      // power_dw
+    FEATURE_CURRENT,    // current_ma
+    FEATURE_VOLTAGE,    // voltage_dv
+    FEATURE_PF,         // pf_cent
+    FEATURE_CHANNELS
+} feature_channel_t;
+
+typedef struct {
+    uint32_t ts_ms;
+    uint32_t energy_wh;
+    uint32_t value[FEATURE_CHANNELS];
+    uint32_t min_queue[FEATURE_CHANNELS];   // Sample numbers, see feature_window.c
+    uint32_t max_queue[FEATURE_CHANNELS];
+} feature_slot_t;
+
+typedef struct {
+    int64_t sum;
+    uint64_t sum_sq;
+    int64_t sum_kx;         // Sum of position * value, for the slope
+    int32_t ewma_q8;        // value * 256
+    uint32_t min_head, min_tail;
+    uint32_t max_head, max_tail;
+} feature_channel_state_t;
+
+typedef struct {
+    feature_slot_t *slots;
+    uint32_t mask;
+    uint32_t count;         // Samples in the window, <= depth
+    uint32_t next;          // Sample number of the next update
+    uint8_t ewma_shift;     // EWMA alpha = 1 / 2^shift
+    feature_channel_state_t ch[FEATURE_CHANNELS];
+} feature_window_t;
+
+typedef struct {
+    int32_t mean;
+    uint64_t variance;      // Population variance, raw units^2
+    uint32_t min;
+    uint32_t max;
+    int32_t ewma;
+    int32_t slope_q8;       // Least squares slope, raw units * 256 per sample
+} feature_stats_t;
+
+// depth must be a power of two, slots must hold depth entries
+bool feature_window_init(feature_window_t *fw, feature_slot_t *slots, uint32_t depth, uint8_t ewma_shift);
+void feature_window_update(feature_window_t *fw, const pzem_data_t *data, uint32_t ts_ms);
+
+static inline uint32_t feature_window_count(const feature_window_t *fw) {
+    return fw->count;
+}
+
+// All zero while the window is empty
+void feature_window_get(const feature_window_t *fw, feature_channel_t ch, feature_stats_t *out);
+
+// Average power implied by the energy register over the window, in dW.
+// 0 until the window spans at least one second.
+uint32_t feature_window_energy_rate_dw(const feature_window_t *fw);
@@ -0,0 +1,138 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "common_structs.h"
+
+// Grid event classifier: tells a load switching on or off apart from a
+// surge, a sag or a frequency excursion on the supply, from the deltas
+// of one reading against two references:
+//
+//  - voltage against a slow baseline (time constant base_tau_ms, so the
+//    sample rate does not matter), which an excursion of a few seconds
+//    barely moves
+//  - power, current and PF against the level at the last load event,
+//    like the change detector's reference
+//
+// Checked in this order on every reading:
+//   SURGE:     V - baseline >= surge_dv, or V >= high_dv. Power rising
+//              with it is the surge's doing (a resistive load follows V^2)
+//   SAG:       baseline - V >= sag_dv, or V <= low_dv, unless the current
+//              stepped up with it: then it is our own load's inrush
+//   FREQUENCY: |F - nominal| >= freq_dhz
+//   LOAD_ON / LOAD_OFF: P moved by max(step_dw, step_pct of the
+//              reference) and I moved the same way, for load_confirm_ms
+// Surge, sag and frequency events are reported once on entry and re-arm
+// after the reading is back inside the band by the hysteresis. Load
+// references follow the reading while any of them is active.
+//
+// Severity: load events are INFO, excursions WARNING, and CRITICAL past
+// high_dv / low_dv or freq_critical_dhz. A surge that meets the trip
+// policy opens the relay (grid_anomaly_open) until the voltage has been
+// back in the band for reclose_ms.
+//
+// Constant memory and time per reading, the state is plain data.
+
+typedef enum {
+    GRID_EVENT_NONE,
+    GRID_EVENT_LOAD_ON,
+    GRID_EVENT_LOAD_OFF,
+    GRID_EVENT_SURGE,
+    GRID_EVENT_SAG,
+    GRID_EVENT_FREQUENCY,
+    GRID_EVENT_TYPES
+} grid_event_type_t;
+
+typedef enum {
+    GRID_SEVERITY_INFO,
+    GRID_SEVERITY_WARNING,
+    GRID_SEVERITY_CRITICAL,
+} grid_severity_t;
+
+typedef enum {
+    GRID_TRIP_NEVER,
+    GRID_TRIP_CRITICAL,           // Surges past high_dv
+    GRID_TRIP_ANY,                // Every surge
+} grid_trip_t;
+
+typedef struct {
+    uint16_t surge_dv;            // Rise over the baseline, 0.1 V
+    uint16_t sag_dv;              // Drop under the baseline
+    uint16_t hysteresis_dv;
+    uint16_t high_dv;             // Absolute limits, CRITICAL beyond
+    uint16_t low_dv;
+    uint32_t base_tau_ms;
+
+    uint16_t nominal_dhz;
+    uint16_t freq_dhz;            // Excursion, 0.1 Hz
+    uint16_t freq_critical_dhz;
+
+    uint32_t step_dw;             // Load step, 0.1 W
+    uint8_t step_pct;
+    uint32_t load_tau_ms;         // Smoothing of P and I
+    uint32_t load_confirm_ms;
+
+    grid_trip_t trip;
+    uint32_t reclose_ms;
+} grid_config_t;
+
+// 230 V / 50 Hz supply: the README's 5 V surge, EN 50160's +-10 % and
+// +-1 % (0.5 Hz) limits, and the simulator's 5 W / 10 % load steps
+#define GRID_CONFIG_DEFAULTS { \
+    .surge_dv = 50, .sag_dv = 50, .hysteresis_dv = 10, \
+    .high_dv = 2530, .low_dv = 2070, .base_tau_ms = 60000, \
+    .nominal_dhz = 500, .freq_dhz = 5, .freq_critical_dhz = 10, \
+    .step_dw = 50, .step_pct = 10, .load_tau_ms = 2000, .load_confirm_ms = 1000, \
+    .trip = GRID_TRIP_CRITICAL, .reclose_ms = 10000, \
+}
+
+// Raw PZEM units, deltas against the references above
+typedef struct {
+    uint32_t ts_ms;
+    uint8_t type;                 // grid_event_type_t
+    uint8_t severity;             // grid_severity_t
+    uint16_t voltage_dv;
+    uint32_t power_dw;
+    int16_t dv;                   // V - baseline
+    int16_t df;                   // F - nominal
+    int32_t dp;                   // P - reference
+    int32_t di;
+    int16_t dpf;
+} grid_event_t;
+
+typedef struct {
+    grid_config_t cfg;
+    bool primed;
+    int32_t base_v_q8;            // Voltage baseline, 0.1 V * 256
+    uint32_t last_ms;
+    int32_t load_p_q8;            // Smoothed P and I, Q8
+    int32_t load_i_q8;
+    int32_t ref_p;                // At the last load event
+    int32_t ref_i;
+    int32_t ref_pf;
+    int8_t pending;               // Load step seen, +1 on / -1 off
+    uint32_t pending_ms;
+    uint8_t active;               // 1 << type of excursions in progress
+    bool open;                    // Relay held open by a surge
+    bool calm;                    // Back in the band since calm_ms
+    uint32_t calm_ms;
+} grid_anomaly_t;
+
+#define GRID_EVENT_JSON_MAX 160
+
+void grid_anomaly_init(grid_anomaly_t *g, const grid_config_t *cfg);
+
+// One reading. Returns true and fills event when one starts; at most one
+// per reading, a simultaneous second one follows on the next.
+bool grid_anomaly_update(grid_anomaly_t *g, const pzem_data_t *d, uint32_t now_ms, grid_event_t *event);
+
+// True while a surge wants the relay open
+bool grid_anomaly_open(const grid_anomaly_t *g);
+
+// {"ts":81234,"event":"surge","severity":"critical","voltage":2541,"power":612,
+//  "dv":241,"dp":58,"di":25,"dpf":0,"df":0}
+// Returns the length, or -1 if cap is too small
+int grid_event_json(const grid_event_t *event, char *buf, size_t cap);
+
+const char *grid_event_name(grid_event_type_t type);
+const char *grid_severity_name(grid_severity_t severity);
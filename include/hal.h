@@ -0,0 +1,69 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Hardware Abstraction Layer
+// The firmware only touches the chip through these calls.
+// src/hal_esp32.c implements them on ESP-IDF, host/hal_host.c implements
+// them on Linux against a virtual clock (see host/sim_main.c).
+
+#ifdef HAL_HOST
+#define RTC_DATA_ATTR
+void hal_log(char level, const char *tag, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+#define ESP_LOGE(tag, fmt, ...) hal_log('E', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) hal_log('W', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) hal_log('I', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) hal_log('D', tag, fmt, ##__VA_ARGS__)
+#else
+#include "esp_attr.h"
+#include "esp_log.h"
+#endif
+
+// An already formatted line stamped with an earlier hal_millis (dlog.h)
+void hal_log_record(char level, const char *tag, uint32_t ms, const char *text);
+
+#define HAL_CORE_ANY -1
+
+typedef void (*hal_task_fn_t)(void *arg);
+typedef uint32_t (*hal_periodic_fn_t)(uint32_t now_ms);   // Returns ms until the next call
+
+typedef struct {
+    const char *name;
+    uint32_t stack_free;                      // Bytes never touched so far
+} hal_task_stat_t;
+
+// --- Platform ---
+void hal_platform_init(void);                 // NVS etc.
+void hal_task_create(hal_task_fn_t fn, const char *name, uint32_t stack, int prio, int core);
+// Calls fn from its own task, preempting lower priorities on that core.
+// fn must not block; it sleeps for as long as it asks between calls.
+void hal_periodic_create(hal_periodic_fn_t fn, const char *name, uint32_t stack, int prio, int core);
+// Stack high-water marks of the tasks created above, returns how many
+int hal_task_stats(hal_task_stat_t *out, int max);
+uint32_t hal_heap_min_free(void);             // Lowest free heap since boot
+const char *hal_device_id(void);              // Stable per board, e.g. from the MAC
+
+// --- Time ---
+uint32_t hal_millis(void);
+uint32_t hal_micros(void);                    // For timing short stages, wraps after 71 min
+void hal_delay_ms(uint32_t ms);               // Light sleep if power management is enabled
+void hal_deep_sleep(uint64_t us);             // Does not return
+uint32_t hal_rtc_millis(void);                // Keeps counting through deep sleep
+
+// --- Relay (Active Low) ---
+void hal_relay_init(void);
+void hal_relay_set(int level);
+void hal_relay_hold(void);                    // Keep level through deep sleep
+
+// --- PZEM UART ---
+void hal_uart_init(uint32_t baud);
+void hal_uart_flush_input(void);
+int hal_uart_write(const uint8_t *data, size_t len);
+int hal_uart_read(uint8_t *data, size_t len, uint32_t timeout_ms);
+
+// --- Outbox storage (NOR flash semantics: erase to 0xFF, writes clear bits) ---
+uint32_t hal_outbox_size(void);               // 0 if there is no outbox partition
+bool hal_outbox_read(uint32_t offset, void *buf, size_t len);
+bool hal_outbox_write(uint32_t offset, const void *buf, size_t len);
+bool hal_outbox_erase(uint32_t offset, size_t len);
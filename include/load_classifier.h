@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+#include "common_structs.h"
+
+// On-device load classifier: the Random Forest from the README, trained
+// on dataset/*.csv by tools/train_forest.py and compiled into flat tables
+// (include/load_classifier_model.h). Inference is a fixed number of table
+// lookups per tree on raw PZEM integers, no floats and no heap.
+//
+// Regenerate the model after changing the dataset:
+//   python3 tools/train_forest.py
+
+// Class ids fit in 4 bits (telemetry flags), this one means "not classified"
+#define LOAD_CLASS_UNKNOWN 0x0F
+
+uint8_t load_classifier_predict(const pzem_data_t *data);
+const char *load_classifier_name(uint8_t load_class);   // NULL for unknown ids
+int load_classifier_class_count(void);
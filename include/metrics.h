@@ -0,0 +1,59 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Runtime metrics: a fixed registry of counters, timing histograms and
+// gauges, rendered in the Prometheus text exposition format
+// (metrics_render) for the metrics MQTT topic.
+//
+// Every metric is known at compile time, so recording one is a relaxed
+// atomic add on a static slot: no lookup, no lock, no allocation. The
+// registry lives in RTC memory, so counts keep going through deep sleep
+// and only a power cycle resets them (Prometheus treats that as a counter
+// reset).
+//
+// Histograms take microseconds into power-of-two buckets, the first up to
+// 2^METRICS_HIST_MIN_SHIFT us, the last open ended, and are exposed in
+// seconds.
+
+#define METRICS_HIST_BUCKETS   16      // 16 us .. 0.5 s, then +Inf
+#define METRICS_HIST_MIN_SHIFT 4       // First bucket: up to 2^4 us
+#define METRICS_MAX_TASKS      8
+#define METRICS_RENDER_MAX     6144    // Enough for everything below
+
+// name, help
+#define METRICS_COUNTERS(X) \
+    X(METRIC_PZEM_SAMPLES,      "pzem_samples_total",          "PZEM transactions that returned a reading") \
+    X(METRIC_PZEM_CRC_ERRORS,   "pzem_crc_errors_total",       "PZEM replies dropped for a bad CRC") \
+    X(METRIC_PZEM_READ_FAILURES, "pzem_read_failures_total",   "PZEM transactions that ended without a reading") \
+    X(METRIC_QUEUE_DROPS,       "mqtt_queue_drops_total",      "Samples lost between the sensor task and the publisher") \
+    X(METRIC_PUBLISHES,         "mqtt_publishes_total",        "MQTT messages handed to the client") \
+    X(METRIC_PUBLISH_FAILURES,  "mqtt_publish_failures_total", "MQTT publishes refused by the client") \
+    X(METRIC_RECONNECTS,        "mqtt_reconnects_total",       "MQTT connections after the first of a wake") \
+    X(METRIC_OTA_CHECKS,        "ota_checks_total",            "OTA manifest checks") \
+    X(METRIC_DEEP_SLEEPS,       "deep_sleeps_total",           "Deep sleep entries")
+
+#define METRICS_HISTOGRAMS(X) \
+    X(METRIC_UART_TRANSACTION,  "pzem_transaction_seconds",    "PZEM request to reading, retries included") \
+    X(METRIC_SERIALIZE,         "telemetry_serialize_seconds", "Payload serialization time") \
+    X(METRIC_PUBLISH,           "mqtt_publish_seconds",        "Time in esp_mqtt_client_publish")
+
+#define METRICS_ENUM(id, name, help) id,
+typedef enum { METRICS_COUNTERS(METRICS_ENUM) METRIC_COUNTER_COUNT } metric_counter_t;
+typedef enum { METRICS_HISTOGRAMS(METRICS_ENUM) METRIC_HISTOGRAM_COUNT } metric_histogram_t;
+#undef METRICS_ENUM
+
+void metrics_inc(metric_counter_t id);
+void metrics_add(metric_counter_t id, uint32_t n);
+void metrics_observe_us(metric_histogram_t id, uint32_t us);
+
+// Gauges, sampled by whoever publishes
+void metrics_set_heap_min_free(uint32_t bytes);
+void metrics_set_task_stack_free(const char *task, uint32_t bytes);   // task must stay valid
+
+uint32_t metrics_counter(metric_counter_t id);
+
+// Text exposition of the whole registry, device as a label on every
+// sample. Returns the length, or -1 if it does not fit.
+int metrics_render(char *buf, size_t len, const char *device);
@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Modbus RTU CRC16 (poly 0xA001 reflected, init 0xFFFF)
+// Table driven, one lookup per byte. Define MODBUS_CRC_SLICE_BY_4 to
+// process four bytes per step (needs modbus_crc_init() and 1.5 KB more RAM).
+
+void modbus_crc_init(void);
+uint16_t modbus_crc16(const uint8_t *data, size_t len);
+
+// Appends the CRC (low byte first) after len bytes of frame
+void modbus_crc_append(uint8_t *frame, size_t len);
+
+// True if the last two bytes of frame are its valid CRC
+static inline int modbus_crc_check(const uint8_t *frame, size_t len) {
+    return len >= 3 && modbus_crc16(frame, len - 2) == (uint16_t)(frame[len - 2] | (frame[len - 1] << 8));
+}
@@ -1,8 +1,16 @@
 #pragma once
 #include "common_structs.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
+#include "sample_ring.h"
+#include "grid_anomaly.h"
 
+// Ring and outbox only, nothing on the network yet
 void mqtt_manager_init(void);
-void mqtt_send_pzem_data(pzem_data_t data, bool relay_state);
-void mqtt_publisher_task(void *arg);
\ No newline at end of file
+// Connects to the broker, called by the WiFi manager once there is an IP
+void mqtt_manager_start(void);
+void mqtt_send_pzem_data(pzem_data_t data, bool relay_state, uint8_t load_class);
+// Queues a grid event for its own topic, never blocks (protection task)
+void mqtt_send_grid_event(const grid_event_t *event);
+// Closed rollup buckets are waiting (rollup.h), wakes the publisher
+void mqtt_send_rollups(void);
+void mqtt_publisher_task(void *arg);
+void mqtt_get_ring_stats(sample_ring_stats_t *stats);
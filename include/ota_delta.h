@@ -0,0 +1,89 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sha256.h"
+
+// Delta firmware updates: a patch rebuilds the new image from the running
+// one, streamed in pieces of any size, with fixed RAM (two
+// OTA_DELTA_BUF_LEN buffers and the hash state) and the output written
+// strictly in order, as esp_ota_write wants it.
+//
+// Patch format, integers are LEB128 varints unless noted:
+//   header  "PZD1", source size (u32 LE), target size (u32 LE),
+//           SHA-256 of the source, SHA-256 of the target
+//   ops     OTA_DELTA_OP_DIFF  source offset (zigzag, from the end of the
+//                              previous DIFF), length, fixup count, then
+//                              per fixup: (bytes to copy unchanged << 3 |
+//                              byte count - 1, 7 meaning a further varint
+//                              of count - 8), then that many bytes to add
+//                              (mod 256) to the source
+//           OTA_DELTA_OP_DATA  length, new bytes
+//           OTA_DELTA_OP_END
+// A DIFF with no fixups is a plain copy. Code moved by an insertion
+// differs from the old image mostly in the pointers into it, which become
+// a few added bytes each instead of a literal block.
+//
+// The source hash is checked before anything is written, the target size
+// and hash when the END op arrives. host/ota/ has the generator.
+
+#define OTA_DELTA_MAGIC       "PZD1"
+#define OTA_DELTA_HEADER_LEN  (4 + 4 + 4 + 2 * SHA256_DIGEST_LEN)
+#define OTA_DELTA_BUF_LEN     256
+
+#define OTA_DELTA_OP_END      0
+#define OTA_DELTA_OP_DIFF     1
+#define OTA_DELTA_OP_DATA     2
+
+typedef enum {
+    OTA_DELTA_MORE,              // Wants more patch bytes
+    OTA_DELTA_DONE,              // Image complete, size and hash match
+    OTA_DELTA_ERR_FORMAT,        // Bad magic, op or range
+    OTA_DELTA_ERR_SOURCE,        // Running image is not the one the patch is for
+    OTA_DELTA_ERR_IO,            // Read or write callback failed
+    OTA_DELTA_ERR_HASH,          // Rebuilt image differs from the intended one
+} ota_delta_status_t;
+
+// Reads the running image; writes the next piece of the new one
+typedef bool (*ota_delta_read_fn)(void *ctx, uint32_t offset, void *buf, size_t len);
+typedef bool (*ota_delta_write_fn)(void *ctx, const void *buf, size_t len);
+
+typedef struct {
+    ota_delta_read_fn read;
+    ota_delta_write_fn write;
+    void *ctx;
+    ota_delta_status_t status;
+
+    uint8_t header[OTA_DELTA_HEADER_LEN];
+    uint32_t source_size;
+    uint32_t target_size;
+
+    // Parser state
+    uint8_t state;
+    uint8_t varint_shift;
+    uint32_t varint;
+    uint32_t fill;               // Header bytes so far
+    uint32_t source_pos;         // Next source byte of the current DIFF
+    uint32_t left;               // Bytes of the current op not yet written
+    uint32_t fixups;             // Left in the current DIFF
+    uint32_t count;              // Bytes left in the current fixup or DATA
+
+    // Source read-ahead and output buffer
+    uint8_t src[OTA_DELTA_BUF_LEN];
+    uint32_t src_off;
+    uint32_t src_len;
+    uint8_t out[OTA_DELTA_BUF_LEN];
+    uint32_t out_len;
+    uint32_t written;            // Target bytes produced
+    sha256_ctx_t hash;
+
+    uint32_t patch_bytes;
+} ota_delta_t;
+
+void ota_delta_init(ota_delta_t *d, ota_delta_read_fn read, ota_delta_write_fn write, void *ctx);
+
+// Applies the next piece of the patch. Once it returns anything but
+// OTA_DELTA_MORE it keeps returning that.
+ota_delta_status_t ota_delta_feed(ota_delta_t *d, const void *data, size_t len);
+
+const char *ota_delta_status_name(ota_delta_status_t status);
@@ -0,0 +1,90 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// OTA manifest polling, transport independent (src/ota_manager.c drives
+// it with esp_http_client, host/http/ with plain sockets).
+//
+// Manifest: a streaming parser that takes the body in pieces of any size,
+// chunked or not, and keeps only the values it needs:
+//   {"version": "3.1", "update_file_url": "https://...",
+//    "patch_from": "3.0", "patch_url": "https://...", ...}
+// The patch keys are optional: a delta (include/ota_delta.h) from
+// patch_from to version. Other keys and nested values of any length are
+// skipped. Versions may also be bare numbers.
+//
+// Poll schedule: conditional GETs (If-None-Match with the last ETag, a
+// 304 costs headers only) on a jittered exponential backoff. It starts at
+// OTA_POLL_MIN_MS after each full wake and doubles while nothing changes
+// or the server fails, up to the OTA_CHECK_INTERVAL_MS heartbeat that
+// also forces a full wake from deep sleep. A new manifest resets it.
+// The state is plain data so the ETag can live in RTC memory.
+
+#define OTA_CHECK_INTERVAL_MS  300000  // Heartbeat: deep sleep before a forced wake for OTA
+#define OTA_POLL_MIN_MS        10000
+#define OTA_POLL_JITTER_PCT    25      // +- around the interval
+
+#define OTA_URL_MAX       256
+#define OTA_VERSION_MAX   16
+#define OTA_ETAG_MAX      64
+#define OTA_KEY_MAX       24
+
+typedef struct {
+    char version[OTA_VERSION_MAX];
+    char url[OTA_URL_MAX];
+    char patch_from[OTA_VERSION_MAX];
+    char patch_url[OTA_URL_MAX];
+
+    // Parser state
+    char key[OTA_KEY_MAX];
+    uint8_t key_len;
+    uint8_t target;              // Field the current key selects, 0 for none
+    uint8_t capture;             // Where the current string or literal goes
+    uint16_t value_len;
+    uint16_t depth;
+    uint8_t unicode_left;        // Hex digits left in a \u escape
+    uint16_t unicode;
+    bool in_string;
+    bool escape;
+    bool in_literal;
+    bool expect_key;
+    bool started;
+    bool complete;               // Top-level object closed
+    bool truncated;              // A wanted value did not fit
+    bool error;
+    uint32_t bytes;
+} ota_manifest_t;
+
+typedef enum {
+    OTA_POLL_CHANGED,            // New version in the manifest
+    OTA_POLL_UNCHANGED,          // 304, or the same version again
+    OTA_POLL_FAILED,             // Connection, HTTP or parse error
+} ota_poll_result_t;
+
+typedef struct {
+    char etag[OTA_ETAG_MAX];     // Empty until a manifest parsed
+    char version[OTA_VERSION_MAX];   // Of the last manifest
+    uint32_t interval_ms;
+    uint32_t checks;
+    uint32_t failures;           // In a row
+} ota_poll_t;
+
+void ota_manifest_init(ota_manifest_t *m);
+void ota_manifest_feed(ota_manifest_t *m, const char *data, size_t len);
+
+// Whole object seen, version and url present, nothing cut short
+bool ota_manifest_ok(const ota_manifest_t *m);
+
+// Back to the shortest interval, keeps the ETag
+void ota_poll_wake(ota_poll_t *p);
+
+// A 200 whose body parsed: stores its ETag (one that does not fit is
+// dropped, so the next request is unconditional rather than wrong) and
+// tells whether the version moved. A server without ETags still backs
+// off as long as the version stays the same.
+ota_poll_result_t ota_poll_manifest(ota_poll_t *p, const ota_manifest_t *m, const char *etag);
+
+// Records a check and returns the delay before the next one, jittered
+// with the caller's random number
+uint32_t ota_poll_next(ota_poll_t *p, ota_poll_result_t result, uint32_t random);
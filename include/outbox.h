@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "telemetry.h"
+
+// Store-and-forward outbox: an append-only log of samples that could not
+// be published, kept in the "outbox" flash partition (a file on the host,
+// see hal_outbox_* in hal.h).
+//
+// The partition is split into 4 KB segments used round-robin, so every
+// sector is erased equally often. Each segment starts with a header
+// (magic, segment sequence, erase count, first record sequence) followed
+// by fixed 32-byte records:
+//   [0] seq u32  [4] ts_ms u32  [8] binary telemetry (20 bytes)
+//   [28] sent flags u16 (0xFFFF pending, 0x0000 sent)  [30] CRC16 of [0..27]
+// Records are marked sent by clearing the flag bits in place, no erase.
+// When the log is full the oldest segment is dropped.
+//
+// RAM use is a few cursors; recovery after reboot reads the segment
+// headers and binary searches the newest and oldest segments.
+
+#define OUTBOX_SEGMENT_SIZE    4096
+#define OUTBOX_RECORD_SIZE     32
+
+typedef struct {
+    uint32_t segments;
+    uint32_t pending;
+    uint32_t appended;
+    uint32_t replayed;
+    uint32_t dropped;          // Lost to rotation or torn writes
+    uint32_t erases;
+} outbox_stats_t;
+
+// Recovers the log from storage. False if no outbox storage is available.
+bool outbox_init(void);
+bool outbox_append(const telemetry_sample_t *sample);
+
+// Copies up to max oldest pending samples without consuming them,
+// outbox_consume() then marks exactly those as sent. Samples are stamped
+// with hal_rtc_millis(), which keeps counting through deep sleep but not
+// a power cycle, so a peek stops where ts_ms steps back: one batch never
+// mixes two power-ons and its dt stays meaningful.
+int outbox_peek(telemetry_sample_t *out, int max);
+void outbox_consume(void);
+
+uint32_t outbox_pending(void);
+void outbox_get_stats(outbox_stats_t *stats);
@@ -0,0 +1,102 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// Overload trip logic: instantaneous trip, a time-overcurrent curve with
+// hysteresis, and a reclose policy. Pure logic on power samples; the
+// caller owns the relay (see protection.h).
+//
+// At or above instant_dw the guard trips on the sample. Above rated_dw it
+// integrates the overload and trips once the integral reaches the curve's
+// trip level, so a brief inrush rides through and a heavy overload trips
+// sooner than a light one. With r = P / rated_dw the trip time is
+//
+//   I2T:       t = ref_ms * (ref^2 - 1) / (r^2 - 1)   (thermal, like a fuse)
+//   INVERSE:   t = ref_ms * (ref - 1) / (r - 1)
+//   DEFINITE:  t = ref_ms at any overload
+//
+// ref is ref_ratio_pct / 100; ref_ms is the trip time at that load.
+// Between the dropout level (rated_dw less hysteresis_pct) and rated_dw
+// the integral holds. Below dropout it drains back to zero within
+// reset_ms, so a load that keeps cycling above the limit still trips.
+//
+// After a trip the guard recloses once the load has dropped below
+// dropout and the reclose delay has passed:
+//   NEVER:    stays open until overload_guard_reset
+//   ALWAYS:   recloses every time (the old fixed 10 s behaviour)
+//   LIMITED:  the delay doubles with each trip that follows a reclose
+//             within window_ms; after max_shots such trips it locks out
+//             until overload_guard_reset
+
+typedef enum {
+    OVERLOAD_CURVE_I2T,
+    OVERLOAD_CURVE_INVERSE,
+    OVERLOAD_CURVE_DEFINITE,
+} overload_curve_t;
+
+typedef enum {
+    OVERLOAD_RECLOSE_NEVER,
+    OVERLOAD_RECLOSE_ALWAYS,
+    OVERLOAD_RECLOSE_LIMITED,
+} overload_reclose_t;
+
+typedef struct {
+    uint32_t rated_dw;            // Pickup, 0.1 W
+    uint32_t instant_dw;          // Instantaneous trip, 0.1 W
+    overload_curve_t curve;
+    uint16_t ref_ratio_pct;       // Reference point of the curve, > 100
+    uint32_t ref_ms;              // Trip time at the reference point
+    uint8_t hysteresis_pct;
+    uint32_t reset_ms;            // Integral drains from trip level to 0
+
+    overload_reclose_t reclose;
+    uint32_t reclose_ms;
+    uint8_t max_shots;            // LIMITED
+    uint32_t window_ms;           // LIMITED
+} overload_config_t;
+
+typedef enum {
+    OVERLOAD_CLOSED,
+    OVERLOAD_PICKUP,              // Above rated, integrating
+    OVERLOAD_TRIPPED,             // Open, waiting to reclose
+    OVERLOAD_LOCKOUT,             // Open until reset
+} overload_state_t;
+
+typedef enum {
+    OVERLOAD_NONE,
+    OVERLOAD_TRIP_INSTANT,
+    OVERLOAD_TRIP_CURVE,
+    OVERLOAD_RECLOSE,
+} overload_action_t;
+
+typedef struct {
+    overload_config_t cfg;
+    uint32_t dropout_dw;
+    uint64_t trip_level;          // Integral at which the curve trips
+    uint64_t integral;
+    overload_state_t state;
+    bool primed;
+    uint8_t shots;                // Trips since the last quiet window
+    uint32_t last_ms;
+    uint32_t trip_ms;
+    uint32_t reclose_at_ms;       // Earliest reclose
+    uint32_t closed_ms;           // Last reclose
+} overload_guard_t;
+
+void overload_guard_init(overload_guard_t *g, const overload_config_t *cfg);
+
+// One power sample. The caller opens the relay on a trip and closes it on
+// OVERLOAD_RECLOSE.
+overload_action_t overload_guard_update(overload_guard_t *g, uint32_t power_dw, uint32_t now_ms);
+
+// True while the relay should be open
+bool overload_guard_open(const overload_guard_t *g);
+
+// Clears a lockout or a NEVER trip; the relay may close again
+void overload_guard_reset(overload_guard_t *g, uint32_t now_ms);
+
+// Time to trip from a cold start at a constant load: 0 for instantaneous,
+// UINT32_MAX if it never trips
+uint32_t overload_guard_trip_ms(const overload_guard_t *g, uint32_t power_dw);
+
+const char *overload_state_name(overload_state_t state);
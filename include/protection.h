@@ -0,0 +1,90 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "common_structs.h"
+#include "overload_guard.h"
+#include "grid_anomaly.h"
+
+// Overload protection fast path. It owns the PZEM UART and the relay
+// while the device is fully awake and runs as the highest-priority task
+// on the sensor core (hal_periodic_create). It reads the meter every
+// PROTECTION_PERIOD_MS through the non-blocking driver, so it sleeps
+// through the wire time, feeds overload_guard, and switches the relay
+// before anything is logged. Nothing in it waits on logging, MQTT or the
+// sensor task.
+//
+// Every reading also goes through the grid event classifier
+// (grid_anomaly.h). A surge that meets its trip policy opens the relay
+// the same way an overload does; the relay closes once neither wants it
+// open. Events go to the handler given to protection_start, called from
+// this task, so it must not block.
+//
+// The sensor task takes readings from here (protection_latest) instead of
+// reading the UART itself.
+//
+// Overload and surge detection only need voltage, current and power, so
+// most reads are PZEM_READ_VIP (23 bytes on the wire instead of 33), the
+// other registers carried over from the last full read. When those three
+// change the meter has taken a new measurement and a full read follows at
+// once, otherwise one comes every PROTECTION_FULL_MS. The sensor task is
+// only handed full readings.
+//
+// Every actuation records the time from sending the request for the
+// sample that caused it to the relay switching.
+//
+// protection_start first sets the meter's own power alarm
+// (PZEM_HREG_ALARM_W) to the overload rating, checked once per power-on
+// and written only if it differs, so the alarm register that
+// comes with every full read (pzem_data_t.alarm) means "above rated".
+// The deep-sleep wake check in main.c wakes fully on it, and the fast path
+// takes over, instead of sleeping again with the relay held closed. The
+// fast path itself does not poll the alarm register: surge detection
+// needs the voltage in every read, and the VIP read already has the power.
+
+#define PROTECTION_PERIOD_MS        250
+#define PROTECTION_FULL_MS          1000    // About the meter's own update period
+#define PROTECTION_PRIORITY         10      // Above the sensor and network tasks
+#define PROTECTION_HIST_STEP_MS     5
+#define PROTECTION_HIST_BUCKETS     16      // Last bucket collects everything slower
+
+typedef struct {
+    uint32_t samples;
+    uint32_t full_reads;          // Of samples, the rest read V, I and P only
+    uint32_t failed_reads;
+    uint32_t trips_instant;
+    uint32_t trips_curve;
+    uint32_t recloses;
+    uint32_t lockouts;
+    uint32_t grid_events[GRID_EVENT_TYPES];
+    uint32_t grid_trips;          // Relay opened by a surge
+    uint32_t actuations;
+    uint32_t latency_max_ms;
+    uint64_t latency_sum_ms;
+    uint32_t latency_hist[PROTECTION_HIST_BUCKETS];   // Request to relay
+    uint32_t alarm_writes;        // Meter alarm threshold reprogrammed
+} protection_stats_t;
+
+typedef void (*protection_event_fn_t)(const grid_event_t *event);
+
+// Closes the relay and starts the fast path. seed is the reading the
+// sensor task sees until the first one of its own. on_event may be NULL.
+void protection_start(const overload_config_t *cfg, const grid_config_t *grid_cfg, const pzem_data_t *seed,
+                      protection_event_fn_t on_event);
+
+// One step of the fast path, returns the ms until it wants to run again.
+// Called by the task protection_start creates.
+uint32_t protection_step(uint32_t now_ms);
+
+// Most recent reading, safe from any task
+void protection_latest(pzem_data_t *out);
+
+// True while the relay is open
+bool protection_tripped(void);
+
+// Re-arms after a lockout
+void protection_reset(void);
+
+void protection_get_stats(protection_stats_t *out);
+
+// Upper edge of the histogram bucket holding the given percentile, in ms
+uint32_t protection_latency_percentile(const protection_stats_t *stats, uint32_t percent);
@@ -0,0 +1,123 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "common_structs.h"
+#include "pzem_driver.h"
+
+// Non-blocking PZEM transaction: issue a request, then call
+// pzem_async_poll whenever convenient. Poll drains whatever the UART has
+// received without waiting, and completes the transaction on a good
+// reply, or on timeout once the retries are used up.
+//
+// Replies are assembled byte by byte and never flushed. A byte that
+// cannot start a reply from the expected slave is skipped as noise. A
+// candidate frame with a bad header or CRC drops its first byte and the
+// assembler rescans from the next one, so a reply behind noise or a torn
+// frame is still found. Reads may return any part of a frame.
+//
+// A complete reply that arrives sooner than request and reply could have
+// crossed the wire since the last send answers an earlier attempt (late).
+// It is counted and dropped. A slow meter may still answer every retry,
+// so while earlier attempts are unanswered a new transaction holds its
+// request back until they have all timed out or their replies arrived.
+// Either way replies never slip one transaction behind.
+//
+// Any request of pzem_driver.h can be issued: the assembler expects the
+// reply length and function code of the one in flight. An exception reply
+// completes the transaction at once, the meter will not change its mind
+// on a retry.
+//
+// Completion is reported through the callback if one is set, otherwise it
+// is kept for pzem_async_result.
+
+#define PZEM_ASYNC_TIMEOUT_MS     100     // Per attempt, as the blocking driver
+#define PZEM_ASYNC_RETRIES        2       // Extra attempts after a timeout or bad reply
+#define PZEM_ASYNC_POLL_MS        10      // pzem_read_registers polling period, one tick at 100 Hz
+#define PZEM_ASYNC_HIST_STEP_MS   5       // Latency histogram bucket width
+#define PZEM_ASYNC_HIST_BUCKETS   32      // Last bucket collects everything slower
+
+typedef void (*pzem_async_cb_t)(void *user, pzem_status_t status, const pzem_data_t *data);
+
+typedef struct {
+    uint32_t issued;
+    uint32_t ok;
+    uint32_t failed;              // Completed without a reply
+    uint32_t retries;
+    uint32_t timeouts;            // Attempts, not transactions
+    uint32_t crc_errors;
+    uint32_t noise_bytes;         // Skipped while hunting for a frame
+    uint32_t resyncs;             // Candidate frames given up after a bad header or CRC
+    uint32_t late;                // Replies to an earlier attempt
+    uint32_t holdoffs;            // Transactions that waited for earlier replies
+    uint32_t exceptions;          // Requests the meter refused
+    uint32_t latency_min_ms;
+    uint32_t latency_max_ms;
+    uint64_t latency_sum_ms;
+    uint32_t latency_hist[PZEM_ASYNC_HIST_BUCKETS];   // Successful transactions, from issue
+} pzem_async_stats_t;
+
+typedef enum {
+    PZEM_ASYNC_IDLE,
+    PZEM_ASYNC_HOLDOFF,           // Issued, request held back for earlier replies
+    PZEM_ASYNC_WAITING,
+    PZEM_ASYNC_DONE,              // Result not collected yet
+} pzem_async_state_t;
+
+typedef struct {
+    pzem_async_state_t state;
+    pzem_async_cb_t cb;
+    void *user;
+    uint8_t addr;
+    uint8_t attempts_left;
+    uint8_t unanswered;           // Attempts sent without a reply seen yet
+    pzem_request_t req;
+    uint8_t request[PZEM_REQUEST_LEN];
+    uint8_t request_len;
+    uint8_t reply_len;
+    uint32_t timeout_ms;
+    uint32_t min_reply_ms;        // Request plus reply wire time
+    uint32_t issued_ms;
+    uint32_t sent_ms;             // Current attempt, or the last one while in HOLDOFF
+    pzem_status_t last_error;
+
+    uint8_t rx[PZEM_RESPONSE_LEN * 2];
+    uint8_t rx_len;
+
+    pzem_status_t status;
+    pzem_data_t data;             // Fields of the input registers read
+    pzem_reply_t reply;
+    pzem_async_stats_t stats;
+} pzem_async_t;
+
+// cb may be NULL, then collect completions with pzem_async_result
+void pzem_async_init(pzem_async_t *a, pzem_async_cb_t cb, void *user);
+
+// Sends the first attempt, or holds it back (see above). False if a
+// transaction is still in progress.
+bool pzem_async_issue_request(pzem_async_t *a, uint8_t addr, const pzem_request_t *req, uint32_t now_ms);
+
+// All input registers (PZEM_READ_ALL)
+bool pzem_async_issue(pzem_async_t *a, uint8_t addr, uint32_t now_ms);
+
+// Drains the UART without blocking and advances the transaction
+void pzem_async_poll(pzem_async_t *a, uint32_t now_ms);
+
+// Assembler input, for callers that receive bytes some other way
+void pzem_async_feed(pzem_async_t *a, const uint8_t *bytes, int len, uint32_t now_ms);
+
+bool pzem_async_busy(const pzem_async_t *a);
+
+// How long the caller can sleep before poll can have anything to do: the
+// rest of the reply's wire time, 1 once a reply may be arriving, 0 when
+// idle or when the attempt is overdue
+uint32_t pzem_async_wait_ms(const pzem_async_t *a, uint32_t now_ms);
+
+// Once per completed transaction when there is no callback. The raw
+// registers stay in a->reply until the next issue.
+bool pzem_async_result(pzem_async_t *a, pzem_status_t *status, pzem_data_t *out);
+
+// Upper edge of the histogram bucket holding the given percentile, in ms
+uint32_t pzem_async_latency_percentile(const pzem_async_stats_t *stats, uint32_t percent);
+
+// Counters for the single-meter link behind pzem_read_registers
+const pzem_async_stats_t *pzem_link_stats(void);
@@ -0,0 +1,84 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "common_structs.h"
+#include "pzem_driver.h"
+
+// Polling engine for several PZEM meters on one Modbus RTU bus (the HAL
+// UART). Every meter needs its own address (set once with
+// pzem_set_address on a bus with only that meter attached).
+//
+// Transactions run back to back: request, reply or timeout, the 3.5
+// character gap Modbus requires, next request. The timeout is sized from
+// the wire time of a reply, so an absent meter costs about one reply slot
+// instead of the single-meter driver's 100 ms.
+//
+// ROUND_ROBIN polls every slave in turn. WEIGHTED polls slave i weight[i]
+// times per cycle, spread evenly (smooth weighted round robin). After
+// PZEM_BUS_OFFLINE_AFTER failures in a row a slave goes OFFLINE and is
+// only probed once every PZEM_BUS_PROBE_INTERVAL turns until it answers.
+
+#define PZEM_BUS_SLAVE_LATENCY_MS  20      // Meter turnaround allowed on top of the wire time
+#define PZEM_BUS_OFFLINE_AFTER     3
+#define PZEM_BUS_PROBE_INTERVAL    32
+
+typedef enum {
+    PZEM_BUS_ROUND_ROBIN,
+    PZEM_BUS_WEIGHTED,
+} pzem_bus_schedule_t;
+
+typedef enum {
+    PZEM_SLAVE_UNKNOWN,     // Not polled yet
+    PZEM_SLAVE_ONLINE,
+    PZEM_SLAVE_SUSPECT,     // Failed at least once since the last good reply
+    PZEM_SLAVE_OFFLINE,
+} pzem_slave_state_t;
+
+typedef struct {
+    // Set by the caller before pzem_bus_init
+    uint8_t addr;
+    uint8_t weight;               // WEIGHTED only, 0 counts as 1
+
+    // Engine state
+    pzem_slave_state_t state;
+    uint8_t failures;             // In a row
+    int16_t credit;               // Smooth WRR
+    uint16_t skipped;             // Turns skipped while OFFLINE
+    uint8_t request[PZEM_REQUEST_LEN];
+    uint32_t last_ok_ms;
+    pzem_data_t last;             // Last good reading
+
+    // Counters
+    uint32_t polls;
+    uint32_t ok;
+    uint32_t timeouts;
+    uint32_t short_replies;
+    uint32_t bad_frames;
+    uint32_t crc_errors;
+} pzem_slave_t;
+
+typedef struct {
+    pzem_slave_t *slaves;
+    int count;
+    int next;                     // ROUND_ROBIN cursor
+    int total_weight;
+    pzem_bus_schedule_t schedule;
+    uint32_t baud;
+    uint32_t timeout_ms;
+    uint32_t gap_ms;
+
+    uint32_t transactions;
+    uint32_t ok;
+    uint64_t wire_bits;           // Bits actually on the wire, both directions
+} pzem_bus_t;
+
+// Initialises the slaves' engine state and the UART
+void pzem_bus_init(pzem_bus_t *bus, pzem_slave_t *slaves, int count, pzem_bus_schedule_t schedule);
+
+// One transaction with the next scheduled slave. Returns that slave (NULL
+// if there are none); out is its reading, tagged with the slave address,
+// and out->valid tells whether it answered.
+pzem_slave_t *pzem_bus_poll(pzem_bus_t *bus, pzem_data_t *out);
+
+// Share of elapsed_ms the bus carried data, in percent
+uint32_t pzem_bus_utilisation(const pzem_bus_t *bus, uint32_t elapsed_ms);
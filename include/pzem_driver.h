@@ -1,12 +1,100 @@
 #pragma once
+#include <stdint.h>
 #include "common_structs.h"
-#include "driver/gpio.h"
-#include "driver/uart.h"
 
 // Config
-#define PZEM_TXD_PIN    (GPIO_NUM_17)
-#define PZEM_RXD_PIN    (GPIO_NUM_16)
-#define UART_PORT_NUM   UART_NUM_2
+#define PZEM_BAUD_RATE     9600
+#define PZEM_DEFAULT_ADDR  0xF8    // General address, any single PZEM answers
+
+#define PZEM_REQUEST_LEN   8       // Longest request, an energy reset is 4
+#define PZEM_RESPONSE_LEN  25      // Longest reply, all input registers
+#define PZEM_EXCEPTION_LEN 5       // addr, function | 0x80, code, CRC
+
+// Function codes
+#define PZEM_CMD_READ_HOLDING  0x03
+#define PZEM_CMD_READ_INPUT    0x04
+#define PZEM_CMD_WRITE_SINGLE  0x06
+#define PZEM_CMD_RESET_ENERGY  0x42
+#define PZEM_CMD_EXCEPTION     0x80    // Set in the function code of an error reply
+
+// Input registers, 32-bit values take two (low word first)
+#define PZEM_REG_VOLTAGE   0x0000
+#define PZEM_REG_CURRENT   0x0001
+#define PZEM_REG_POWER     0x0003
+#define PZEM_REG_ENERGY    0x0005
+#define PZEM_REG_FREQ      0x0007
+#define PZEM_REG_PF        0x0008
+#define PZEM_REG_ALARM     0x0009      // PZEM_ALARM_ON while power is over the threshold
+#define PZEM_INPUT_REGS    10
+
+// Holding registers, kept by the meter across power cycles
+#define PZEM_HREG_ALARM_W  0x0001      // Power alarm threshold, 1 W
+#define PZEM_HREG_ADDRESS  0x0002      // Modbus address, 0x01-0xF7
+#define PZEM_HOLDING_REGS  2
+
+#define PZEM_ALARM_ON      0xFFFF
+
+typedef enum {
+    PZEM_OK,
+    PZEM_ERR_TIMEOUT,      // Nothing came back
+    PZEM_ERR_SHORT,        // Part of a reply
+    PZEM_ERR_FRAME,        // Wrong address, function or byte count
+    PZEM_ERR_CRC,
+    PZEM_ERR_EXCEPTION,    // The meter refused, see pzem_reply_t.exception
+} pzem_status_t;
+
+// One transaction: a read of count registers from reg, a write of value
+// to reg, or an energy reset (reg and value unused)
+typedef struct {
+    uint8_t function;
+    uint16_t reg;
+    uint16_t value;
+} pzem_request_t;
+
+#define PZEM_READ_ALL    ((pzem_request_t){ PZEM_CMD_READ_INPUT, PZEM_REG_VOLTAGE, PZEM_INPUT_REGS })
+// Voltage, current and power: what overload and surge detection look at
+#define PZEM_READ_VIP    ((pzem_request_t){ PZEM_CMD_READ_INPUT, PZEM_REG_VOLTAGE, 5 })
+#define PZEM_READ_POWER  ((pzem_request_t){ PZEM_CMD_READ_INPUT, PZEM_REG_POWER, 2 })
+#define PZEM_READ_ALARM  ((pzem_request_t){ PZEM_CMD_READ_INPUT, PZEM_REG_ALARM, 1 })
+
+typedef struct {
+    uint8_t slave;                  // Address the reply came from
+    uint8_t exception;              // Modbus exception code with PZEM_ERR_EXCEPTION
+    uint16_t regs[PZEM_INPUT_REGS]; // Registers read, or the value written
+} pzem_reply_t;
 
 void pzem_init(void);
-pzem_data_t pzem_read_registers(void);
\ No newline at end of file
+void pzem_set_address(uint8_t addr);
+uint8_t pzem_get_address(void);
+pzem_data_t pzem_read_registers(void);   // Retries and resyncs, see pzem_async.h
+
+// Blocking register access on the same link as pzem_read_registers. Not
+// while the protection fast path owns the UART (protection.h).
+pzem_status_t pzem_read_input(uint16_t reg, uint16_t count, uint16_t *out);
+pzem_status_t pzem_read_holding(uint16_t reg, uint16_t count, uint16_t *out);
+pzem_status_t pzem_write_holding(uint16_t reg, uint16_t value);
+pzem_status_t pzem_reset_energy(void);
+// Short reads: 9 and 7 byte replies instead of 25
+pzem_status_t pzem_read_power(uint32_t *power_dw);
+pzem_status_t pzem_read_alarm(bool *alarm);
+// Writes the meter's address, then talks to it there
+pzem_status_t pzem_change_address(uint8_t addr);
+
+// Single pass: checks address, function, length and CRC, then fills out
+bool pzem_decode_frame(const uint8_t *frame, int len, pzem_data_t *out);
+
+// Frame layout of a request, for any meter
+int pzem_request_len(const pzem_request_t *req);
+int pzem_reply_len(const pzem_request_t *req);      // Without an exception
+int pzem_build_request(uint8_t addr, const pzem_request_t *req, uint8_t request[PZEM_REQUEST_LEN]);
+pzem_status_t pzem_parse_response(uint8_t addr, const pzem_request_t *req, const uint8_t *frame, int len,
+                                  pzem_reply_t *out);
+
+// Fills the fields of out whose registers are all among the count read
+// from first, leaves the others
+void pzem_regs_to_data(uint16_t first, uint16_t count, const uint16_t *regs, pzem_data_t *out);
+
+// Building blocks for several meters on one bus (see pzem_bus.h).
+// Replies to the general address are accepted from any slave.
+void pzem_build_read_request(uint8_t addr, uint8_t request[PZEM_REQUEST_LEN]);
+pzem_status_t pzem_parse_reply(uint8_t addr, const uint8_t *frame, int len, pzem_data_t *out);
@@ -0,0 +1,78 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "common_structs.h"
+
+// Minute and hour rollups of the readings: min / mean / max voltage and
+// power and the energy counted, kept in RTC memory so they span deep
+// sleep. Fed by the sensor task and the wake check.
+//
+// A reading only touches the open minute bucket. When a reading falls in
+// a later minute the open one is closed into the minute ring and merged
+// into the open hour bucket, which closes into the hour ring the same
+// way. Fixed memory, O(1) per reading.
+//
+// Closed buckets are numbered from 0 since power-on (rollup_closed) and
+// can be read from another task while the sensor task writes: a bucket
+// is only returned if its slot cannot have been reused during the copy.
+// Energy is the PZEM counter's increase since the previous reading, so
+// a bucket after a gap (deep sleep) holds the energy of the gap.
+
+#define ROLLUP_MINUTES 60       // Closed minute buckets readable, the last hour
+#define ROLLUP_HOURS   24
+
+typedef enum {
+    ROLLUP_MINUTE,
+    ROLLUP_HOUR,
+    ROLLUP_LEVELS
+} rollup_level_t;
+
+// Raw PZEM units (see common_structs.h)
+typedef struct {
+    uint32_t start_min;         // hal_rtc_millis() / 60000 at the bucket start
+    uint16_t count;             // Readings
+    uint16_t energy_wh;
+    uint16_t v_min;
+    uint16_t v_max;
+    uint32_t v_sum;
+    uint32_t p_min;
+    uint32_t p_max;
+    uint32_t p_sum;
+} rollup_bucket_t;
+
+// Inclusive range of bucket start times, hal_rtc_millis() seconds
+typedef struct {
+    rollup_level_t level;
+    uint32_t from_s;
+    uint32_t to_s;
+} rollup_query_t;
+
+#define ROLLUP_QUERY_MAX 96     // Longest request payload
+#define ROLLUP_JSON_MAX  1024   // One published message
+
+// Sensor task. Returns 1 << level for each level that closed a bucket.
+uint8_t rollup_add(const pzem_data_t *d, uint32_t now_ms);
+
+// Buckets closed so far, the next one gets this number
+uint32_t rollup_closed(rollup_level_t level);
+// Closed bucket number seq, false if it is no longer (or not yet) kept
+bool rollup_get(rollup_level_t level, uint32_t seq, rollup_bucket_t *out);
+// Number of the oldest closed bucket still kept
+uint32_t rollup_oldest(rollup_level_t level);
+
+void rollup_clear(void);
+size_t rollup_state_size(void);  // RTC bytes
+
+// {"level":"minute","from":120,"to":3600} or {"level":"hour"}, from and
+// to in device seconds (hal_rtc_millis / 1000) and optional
+bool rollup_parse_query(const char *buf, size_t len, rollup_query_t *q);
+
+// {"level":"minute","now":3725,"buckets":[{"t":3600,"n":58,"v":[2281,2290,2302],
+//  "p":[611,640,702],"e":1},...]}, t in device seconds, v and p min / mean
+// / max. Renders as many of the n buckets as fit and sets *rendered.
+// Returns the length, or -1 if not even one fits.
+int rollup_render(rollup_level_t level, const rollup_bucket_t *b, int n, uint32_t now_ms, char *buf, size_t cap,
+                  int *rendered);
+
+const char *rollup_level_name(rollup_level_t level);
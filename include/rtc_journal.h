@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "common_structs.h"
+
+// Journal of the readings taken by the deep-sleep wake check, kept in
+// RTC slow memory and uploaded as one message on the next full wake.
+//
+// Storage is a ring of fixed blocks. Each block opens with a keyframe
+// (ts u32 + 18-byte raw record, same field order as the BINARY telemetry
+// record) followed by samples as zigzag varint deltas against the previous
+// one: dt, dV, dI, dP, dE, dF, dPF. A stable load costs ~8 bytes per sample.
+// When the ring is full the oldest block is dropped.
+//
+// Export format: [0] version 3  [1] block count, then per block
+// [0] sample count u8  [1] length u16  [3] block bytes
+
+#define RTC_JOURNAL_VERSION     3
+#define RTC_JOURNAL_BLOCKS      12
+#define RTC_JOURNAL_BLOCK_SIZE  256
+#define RTC_JOURNAL_EXPORT_MAX  (2 + RTC_JOURNAL_BLOCKS * (3 + RTC_JOURNAL_BLOCK_SIZE))
+
+void rtc_journal_append(const pzem_data_t *data, uint32_t ts_ms);
+uint32_t rtc_journal_count(void);
+uint32_t rtc_journal_dropped(void);
+
+// Returns bytes written, or -1 if cap is too small
+int rtc_journal_export(uint8_t *buf, size_t cap);
+void rtc_journal_clear(void);
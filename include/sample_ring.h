@@ -0,0 +1,68 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "telemetry.h"
+
+// Lock-free single-producer / single-consumer ring of raw samples.
+// The sensor task fills slots in place (claim/commit), the publisher
+// reads them in place (peek/release), so nothing is copied in between
+// and no kernel critical section is taken.
+//
+// BACKPRESSURE: claim fails when full, the new sample is dropped.
+// OVERWRITE:    the producer never waits, the oldest unread sample is
+//               lost instead. Every slot carries a sequence number so the
+//               consumer can tell when a slot was rewritten under it.
+
+#define SAMPLE_RING_CACHE_LINE 64
+
+typedef enum {
+    SAMPLE_RING_BACKPRESSURE,
+    SAMPLE_RING_OVERWRITE,
+} sample_ring_policy_t;
+
+typedef struct {
+    _Atomic uint32_t seq;          // 2 * index + 1 while writing, + 2 when done
+    telemetry_sample_t sample;
+} sample_slot_t;
+
+typedef struct {
+    // Producer side
+    _Alignas(SAMPLE_RING_CACHE_LINE) _Atomic uint32_t head;
+    uint32_t dropped;              // Rejected by BACKPRESSURE
+    uint32_t high_water;
+
+    // Consumer side
+    _Alignas(SAMPLE_RING_CACHE_LINE) _Atomic uint32_t tail;
+    uint32_t overwritten;          // Lost to OVERWRITE
+    uint32_t peek_seq;
+
+    // Read-only after init
+    _Alignas(SAMPLE_RING_CACHE_LINE) sample_slot_t *slots;
+    uint32_t mask;
+    sample_ring_policy_t policy;
+} sample_ring_t;
+
+typedef struct {
+    uint32_t depth;
+    uint32_t count;
+    uint32_t high_water;
+    uint32_t dropped;
+    uint32_t overwritten;
+} sample_ring_stats_t;
+
+// depth must be a power of two, slots must hold depth entries
+bool sample_ring_init(sample_ring_t *ring, sample_slot_t *slots, uint32_t depth, sample_ring_policy_t policy);
+
+// Producer: claim a slot (NULL if full under BACKPRESSURE), fill it, commit
+telemetry_sample_t *sample_ring_claim(sample_ring_t *ring);
+void sample_ring_commit(sample_ring_t *ring);
+
+// Consumer: peek the oldest sample (NULL if empty), use it, release.
+// release returns false if the slot was overwritten while in use,
+// in which case whatever was read from it must be discarded.
+const telemetry_sample_t *sample_ring_peek(sample_ring_t *ring);
+bool sample_ring_release(sample_ring_t *ring);
+
+// Approximate when called while the other side is running
+void sample_ring_get_stats(sample_ring_t *ring, sample_ring_stats_t *stats);
@@ -0,0 +1,76 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// Adaptive sampling period for the sensor task and the deep-sleep cycle.
+//
+// Active loop: FAST while the load is changing (and for a few samples
+// after), near or above the overload limit; otherwise BASE, doubling every
+// SCHED_BACKOFF_SAMPLES stable samples up to SCHED_MAX_PERIOD_MS. With
+// power management enabled the chip light-sleeps through these delays.
+//
+// Deep sleep: starts at SCHED_SLEEP_MIN_MS after a full wake and doubles
+// each wake check that finds nothing, up to SCHED_SLEEP_MAX_MS. A reading
+// near the overload limit keeps it at the minimum.
+//
+// The state is plain data so it can live in RTC memory.
+
+// Define SCHED_FIXED_RATE for the old fixed 1 s loop and 5 s sleep
+#ifdef SCHED_FIXED_RATE
+#define SCHED_FAST_PERIOD_MS      1000
+#define SCHED_BASE_PERIOD_MS      1000
+#define SCHED_MAX_PERIOD_MS       1000
+#define SCHED_SLEEP_MIN_MS        5000
+#define SCHED_SLEEP_MAX_MS        5000
+#else
+#define SCHED_FAST_PERIOD_MS      500     // About as fast as the PZEM refreshes
+#define SCHED_BASE_PERIOD_MS      1000
+#define SCHED_MAX_PERIOD_MS       8000
+#define SCHED_SLEEP_MIN_MS        5000
+#define SCHED_SLEEP_MAX_MS        40000
+#endif
+#define SCHED_FAST_HOLD_SAMPLES   10      // Stay fast this long after a change
+#define SCHED_BACKOFF_SAMPLES     15      // Stable samples per doubling
+
+// Reasons for the current period, several can be set at once
+#define SCHED_REASON_TRANSITION     (1 << 0)   // Change seen in the last FAST_HOLD samples
+#define SCHED_REASON_NEAR_OVERLOAD  (1 << 1)   // Above 7/8 of the overload limit
+#define SCHED_REASON_OVERLOAD       (1 << 2)   // Overload cutoff active
+#define SCHED_REASON_BACKOFF        (1 << 3)   // Stable, backing off
+#define SCHED_REASON_CEILING        (1 << 4)   // Stable, at the longest period
+
+typedef struct {
+    uint32_t period_ms;       // Active loop delay
+    uint32_t sleep_ms;        // Next deep sleep
+    uint32_t near_overload_dw;
+    uint16_t stable;          // Samples since the last change
+    uint8_t reasons;
+    uint8_t sleep_reasons;
+} sample_scheduler_t;
+
+void sample_scheduler_init(sample_scheduler_t *s, uint32_t overload_dw);
+
+// A full wake: fast sampling, and the next deep sleep starts from the minimum
+void sample_scheduler_wake(sample_scheduler_t *s);
+
+// Feeds one active reading, returns the delay before the next one
+uint32_t sample_scheduler_next(sample_scheduler_t *s, bool changed, uint32_t power_dw, bool overload);
+
+// Feeds one wake-check reading that did not wake the device, returns the
+// deep sleep length
+uint32_t sample_scheduler_next_sleep(sample_scheduler_t *s, uint32_t power_dw);
+
+static inline uint32_t sample_scheduler_period(const sample_scheduler_t *s) {
+    return s->period_ms;
+}
+
+static inline uint32_t sample_scheduler_sleep(const sample_scheduler_t *s) {
+    return s->sleep_ms;
+}
+
+static inline uint8_t sample_scheduler_reasons(const sample_scheduler_t *s) {
+    return s->reasons;
+}
+
+// Name of the most urgent reason in a mask, "" for none
+const char *sample_scheduler_reason_name(uint8_t reasons);
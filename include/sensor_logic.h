@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "common_structs.h"
+#include "change_detector.h"
+
+// The decisions of app_main and the sensor task, without the I/O around
+// them: whether a wake check wakes the device fully, and for each reading
+// whether it is new, whether it is published and whether the device has
+// been idle long enough to sleep. host/fleet/fleet_sim.c drives the same
+// calls, so its devices publish and sleep as the firmware does.
+//
+// The state is plain data so it can live in RTC memory.
+
+typedef struct {
+    pzem_data_t last;          // Previous reading of this wake
+    uint32_t last_change_ms;   // Last publish, or the start of the wake
+    uint8_t last_class;        // Load class of the last publish
+    bool has_run;              // Published at least once since power on
+    bool wake_change;          // The wake check saw a change, publish the first reading
+} sensor_logic_t;
+
+typedef struct {
+    bool fresh;                // Not the same registers as the last poll
+    uint8_t changed;           // change_detector_update flags, 0 if not fresh
+    bool publish;
+    bool sleep;                // Nothing published for IDLE_TIMEOUT_MS
+} sensor_decision_t;
+
+// Wake check: changed is what the detector made of the reading, slept_ms
+// the time in deep sleep since the last full wake. True for a full wake.
+bool sensor_logic_wake(sensor_logic_t *s, uint8_t changed, uint32_t slept_ms);
+
+// The sensor task starts on a full wake
+void sensor_logic_start(sensor_logic_t *s, uint32_t now_ms);
+
+// One valid reading. Feeds the detector with fresh readings only.
+sensor_decision_t sensor_logic_step(sensor_logic_t *s, change_detector_t *detector, const pzem_data_t *data,
+                                    uint8_t load_class, uint32_t now_ms);
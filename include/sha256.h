@@ -0,0 +1,19 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// SHA-256 (FIPS 180-4), incremental, so an image can be hashed as it
+// streams through. Portable C, also used by the host tools.
+
+#define SHA256_DIGEST_LEN 32
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;             // Bytes hashed so far
+    uint8_t block[64];
+    uint8_t fill;
+} sha256_ctx_t;
+
+void sha256_init(sha256_ctx_t *ctx);
+void sha256_update(sha256_ctx_t *ctx, const void *data, size_t len);
+void sha256_final(sha256_ctx_t *ctx, uint8_t digest[SHA256_DIGEST_LEN]);
@@ -0,0 +1,73 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "common_structs.h"
+#include "load_classifier.h"
+
+// Heap-free telemetry serializer, writes straight into the caller's buffer.
+//
+// JSON:   what cJSON_PrintUnformatted gives for raw / scale as doubles:
+//         the shortest decimal of each register, same keys and order
+//         {"voltage":224.5,"current":0.292,"power":58.5,"energy":0.216,
+//          "frequency":50,"pf":0.9,"relay":false,"class":"Laptop"}
+//         "class" is left out when the sample was not classified.
+//         Not the payload the firmware sent before: that passed float
+//         fields, which cJSON printed with "%1.17g" (224.5 stayed, 0.292
+//         went out as 0.29199999570846558). Parsed as doubles the values
+//         are the same up to float precision. Checked by
+//         host/json/telemetry_json_test.c.
+// BINARY: fixed 20-byte little-endian record, raw PZEM units
+//         [0] version  [1] flags (bit0 = relay, bits1-4 = class id)
+//         [2] voltage_dv u16  [4] current_ma u32  [8] power_dw u32
+//         [12] energy_wh u32  [16] freq_dhz u16   [18] pf_cent u16
+
+//
+// Batches carry several samples as deltas against the first one:
+// JSON:   {"t0":81234,"base":[V,I,P,E,F,PF,relay,class],"d":[[dt,dV,dI,dP,dE,dF,dPF,relay,class],...]}
+//         base and deltas are raw PZEM units, dt in ms, class is the id
+//         (LOAD_CLASS_UNKNOWN if not classified)
+// BINARY: [0] version 2  [1] count  [2] t0 u32  [6] base record (bytes 1..19 above)
+//         then per extra sample: dt, dV, dI, dP, dE, dF, dPF as zigzag varints + flags byte
+//         (same flags as the single record)
+
+#define TELEMETRY_BIN_VERSION        1
+#define TELEMETRY_BIN_BATCH_VERSION  2
+#define TELEMETRY_BIN_LEN            20
+#define TELEMETRY_JSON_MAX           160
+
+#define TELEMETRY_BATCH_MAX          16
+#define TELEMETRY_BATCH_ROW_MAX      100   // Worst case JSON delta row
+#define TELEMETRY_BATCH_BUF_SIZE     (TELEMETRY_JSON_MAX + TELEMETRY_BATCH_MAX * TELEMETRY_BATCH_ROW_MAX)
+
+typedef enum {
+    TELEMETRY_FMT_JSON,
+    TELEMETRY_FMT_BINARY,
+} telemetry_format_t;
+
+typedef struct {
+    uint32_t ts_ms;            // hal_rtc_millis(), so it survives deep sleep in the outbox
+    pzem_data_t data;
+    bool relay;
+    uint8_t load_class;   // load_classifier id or LOAD_CLASS_UNKNOWN
+} telemetry_sample_t;
+
+typedef struct {
+    telemetry_sample_t samples[TELEMETRY_BATCH_MAX];
+    uint8_t count;
+} telemetry_batch_t;
+
+// Returns bytes written (JSON is also null terminated), or -1 if cap is too small
+int telemetry_serialize(telemetry_format_t fmt, const telemetry_sample_t *sample, uint8_t *buf, size_t cap);
+int telemetry_serialize_batch(telemetry_format_t fmt, const telemetry_batch_t *batch, uint8_t *buf, size_t cap);
+
+// Zigzag LEB128 as used by the binary batch, at most 5 bytes
+#define TELEMETRY_VARINT_MAX 5
+uint8_t *telemetry_put_varint(uint8_t *p, int32_t value);
+
+// Inverse of the single-sample BINARY record, leaves ts_ms alone
+bool telemetry_parse_binary(const uint8_t *buf, size_t len, telemetry_sample_t *sample);
+
+// Batch helpers: add returns true once max_samples is reached,
+// expired is true when the oldest sample is older than max_latency_ms
+bool telemetry_batch_add(telemetry_batch_t *batch, const telemetry_sample_t *sample, int max_samples);
+bool telemetry_batch_expired(const telemetry_batch_t *batch, uint32_t now_ms, uint32_t max_latency_ms);
@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Wake phase timestamps: hal_millis() when each step of a full wake first
+// happened, for the time from boot to the first publish. Phases are
+// marked from several tasks and each keeps its first mark of the wake.
+//
+//   sensor         wake-check reading done in app_main
+//   wifi_start     WiFi driver starting, concurrently with sampling
+//   associated     joined the AP (after a scan, or straight to the cached one)
+//   got_ip         DHCP lease, or the cached lease applied
+//   mqtt           broker session up
+//   first_publish  first message handed to the client
+
+// id, name
+#define WAKE_PHASES(X) \
+    X(WAKE_SENSOR,          "sensor") \
+    X(WAKE_WIFI_START,      "wifi_start") \
+    X(WAKE_ASSOCIATED,      "associated") \
+    X(WAKE_GOT_IP,          "got_ip") \
+    X(WAKE_MQTT_CONNECTED,  "mqtt") \
+    X(WAKE_FIRST_PUBLISH,   "first_publish")
+
+#define WAKE_PHASE_ENUM(id, name) id,
+typedef enum { WAKE_PHASES(WAKE_PHASE_ENUM) WAKE_PHASE_COUNT } wake_phase_t;
+#undef WAKE_PHASE_ENUM
+
+#define WAKE_TRACE_TEXT_MAX 160
+
+void wake_trace_begin(void);                  // Start of app_main, clears the marks
+
+// Returns true if this was the phase's first mark of the wake
+bool wake_trace_mark(wake_phase_t phase);
+bool wake_trace_mark_at(wake_phase_t phase, uint32_t ms);
+bool wake_trace_get(wake_phase_t phase, uint32_t *ms);
+
+// Whether the WiFi manager reconnected from its RTC cache this wake
+void wake_trace_set_cached(bool cached);
+bool wake_trace_cached(void);
+
+// "sensor 21, wifi_start 22, ... first_publish 431 ms (cached AP)",
+// unmarked phases left out. Returns the length, or -1 if cap is too small
+int wake_trace_format(char *buf, size_t cap);
+
+const char *wake_phase_name(wake_phase_t phase);
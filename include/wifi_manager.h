@@ -1,2 +1,14 @@
 #pragma once
-void wifi_init_sta(void);
\ No newline at end of file
+
+// How long the AP (BSSID, channel) and the IP lease of the last DHCP
+// stay in RTC memory for the next wakes, well inside the usual 1 h or
+// longer lease of a home router
+#define WIFI_CACHE_MAX_AGE_MS (30 * 60 * 1000)
+
+// Called from the event loop each time the station has an IP
+typedef void (*wifi_connected_fn_t)(void);
+
+// Starts the station and returns, the connection comes up in the
+// background. Joins the cached AP with the cached lease when it is
+// recent, else (or when that fails) scans and asks DHCP.
+void wifi_init_sta(wifi_connected_fn_t on_connected);
@@ -1,163 +1,205 @@
 #include <stdio.h>
-#include <math.h>
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
-#include "esp_log.h"
-#include "nvs_flash.h"
-#include "driver/gpio.h"
-#include "esp_sleep.h"
+#include <stdlib.h>
+#include "hal.h"
 
 // --- IMPORT MODULES ---
 #include "wifi_manager.h"
 #include "mqtt_manager.h"
 #include "pzem_driver.h"
 #include "ota_manager.h"
+#include "ota_poll.h"
+#include "rtc_journal.h"
+#include "load_classifier.h"
+#include "feature_window.h"
+#include "change_detector.h"
+#include "sample_scheduler.h"
+#include "protection.h"
+#include "metrics.h"
+#include "dlog.h"
+#include "wake_trace.h"
+#include "rollup.h"
+#include "app_config.h"
+#include "sensor_logic.h"
 
-#define RELAY_PIN GPIO_NUM_23
 static const char *TAG = "MAIN_APP";
 
-#define DATA_THRESHOLD 1.0
-#define CURRENT_THRESHOLD 0.1
-
-// 90s to give OTA time to finish
-#define IDLE_TIMEOUT_MS 90000 
-#define SLEEP_DURATION 5
-//sleep cycles before forcing a check (60 * 5s = 300s = 5 mins)
-#define OTA_CHECK_CYCLES 60   
+// Trip curve and reclose policy, see overload_guard.h. Up to 2x rated
+// rides through inrush on an I2t curve (1.5x trips in 2 s), 2x trips at
+// once. Recloses after 10 s, doubling, and locks out after 3 quick trips.
+static const overload_config_t overload_config = {
+    .rated_dw = OVERLOAD_POWER_DW,
+    .instant_dw = OVERLOAD_POWER_DW * 2,
+    .curve = OVERLOAD_CURVE_I2T,
+    .ref_ratio_pct = 150,
+    .ref_ms = 2000,
+    .hysteresis_pct = 5,
+    .reset_ms = 10000,
+    .reclose = OVERLOAD_RECLOSE_LIMITED,
+    .reclose_ms = 10000,
+    .max_shots = 3,
+    .window_ms = 60000,
+};
+
+// Surge / sag / frequency limits and load steps, see grid_anomaly.h.
+// Surges past 253 V open the relay until 10 s after they end.
+static const grid_config_t grid_config = GRID_CONFIG_DEFAULTS;
+
+// Overload limit, change policy, publish policy and idle timeout are in
+// app_config.h, shared with the fleet simulator
+
+// Rolling statistics over the last 32 samples (~32 s), EWMA alpha 1/8
+#define FEATURE_WINDOW_DEPTH  32
+#define FEATURE_EWMA_SHIFT    3
+
+// Sampling and sleep periods adapt to the load, see sample_scheduler.h
+// Time asleep before forcing a full wake for OTA: OTA_CHECK_INTERVAL_MS
+// (5 mins, ota_poll.h), also the longest gap between manifest checks
 
 uint32_t loop_counter = 0;
+static feature_window_t features;
+static feature_slot_t feature_slots[FEATURE_WINDOW_DEPTH];
 
 // RTC MEMORY (Survives Deep Sleep) ---
-RTC_DATA_ATTR static pzem_data_t last_saved_data;
-RTC_DATA_ATTR static bool has_run_before = false;
-// NEW: Counter to track sleep cycles
-RTC_DATA_ATTR static int wake_count_for_ota = 0; 
+RTC_DATA_ATTR static change_detector_t detector;
+RTC_DATA_ATTR static sample_scheduler_t scheduler;
+// Publish and sleep decisions, see sensor_logic.h
+RTC_DATA_ATTR static sensor_logic_t logic = { .last_class = LOAD_CLASS_UNKNOWN };
+// Time spent in deep sleep since the last full wake
+RTC_DATA_ATTR static uint32_t slept_ms_for_ota = 0; 
 
 // --- MAIN LOGIC TASK ---
 void sensor_logic_task(void *arg) {
-    gpio_reset_pin(RELAY_PIN);
-    gpio_set_direction(RELAY_PIN, GPIO_MODE_OUTPUT);
-    gpio_set_level(RELAY_PIN, 1); 
-
-    bool overload_active = false;
-    uint32_t overload_timer = 0;
-    
-    uint32_t last_change_time = pdTICKS_TO_MS(xTaskGetTickCount());
+    loop_counter = 0;
+    sensor_logic_start(&logic, hal_millis());
+    feature_window_init(&features, feature_slots, FEATURE_WINDOW_DEPTH, FEATURE_EWMA_SHIFT);
 
     while(1) {
-        pzem_data_t data = pzem_read_registers();
+        // Overload protection runs on its own, this only reports
+        pzem_data_t data;
+        protection_latest(&data);
         loop_counter++;
-        bool relay_state_logical = false; 
+        bool relay_state_logical = protection_tripped();
 
         if (data.valid) {
-            // 1. Overload Safety Logic
-            if (data.power > 80.0) {
-                if (!overload_active) {
-                    gpio_set_level(RELAY_PIN, 0); 
-                    overload_active = true;
-                    overload_timer = pdTICKS_TO_MS(xTaskGetTickCount());
-                    ESP_LOGE(TAG, "Overload Detected! Cutoff Triggered.");
-                }
-                relay_state_logical = true;
-            } else {
-                if (overload_active) {
-                    if (pdTICKS_TO_MS(xTaskGetTickCount()) - overload_timer > 10000) {
-                        gpio_set_level(RELAY_PIN, 1); 
-                        overload_active = false;
-                        relay_state_logical = false;
-                        ESP_LOGI(TAG, "Overload Cleared.");
-                    } else {
-                        relay_state_logical = true;
-                    }
-                } else {
-                    gpio_set_level(RELAY_PIN, 1);
-                    relay_state_logical = false;
+            // 1. Change Detection
+            uint32_t now = hal_millis();
+            uint8_t load_class = load_classifier_predict(&data);
+            sensor_decision_t decision = sensor_logic_step(&logic, &detector, &data, load_class, now);
+            uint8_t changed = decision.changed;
+
+            if (decision.fresh) {
+                feature_window_update(&features, &data, hal_millis());
+                // Minute and hour aggregates, the publisher sends closed buckets
+                if (rollup_add(&data, hal_rtc_millis())) {
+                    mqtt_send_rollups();
                 }
             }
 
-            // 2. Change Detection
-            float power_diff = fabsf(data.power - last_saved_data.power);
-            float current_diff = data.current - last_saved_data.current;
-            float voltage_diff = fabsf(data.voltage - last_saved_data.voltage);
-            
-            
-            bool is_change = (power_diff > DATA_THRESHOLD || current_diff > CURRENT_THRESHOLD || voltage_diff > DATA_THRESHOLD || (!has_run_before));
             bool read_5time = (loop_counter % 5 == 0);
 
-            if(is_change) {
-                ESP_LOGI(TAG, "Change detected. Sending MQTT (P: %.1f W)", power_diff);
-                mqtt_send_pzem_data(data, relay_state_logical);
-                
-
-                last_saved_data = data;
-                has_run_before = true;
-                last_change_time = pdTICKS_TO_MS(xTaskGetTickCount());
+            if (decision.publish) {
+                DLOG(DLOG_CHANGE, changed, change_detector_sigma(&detector, CHANGE_POWER),
+                     DLOG_STR(load_classifier_name(load_class)));
+                mqtt_send_pzem_data(data, relay_state_logical, load_class);
             }
-            
-        
             else {
-                ESP_LOGD(TAG, "No change. (Idle for %lu ms)", pdTICKS_TO_MS(xTaskGetTickCount()) - last_change_time);
+                DLOG(DLOG_NO_CHANGE, now - logic.last_change_ms);
             }
 
-            // 3. Idle Timeout (Sleep)
-            if (pdTICKS_TO_MS(xTaskGetTickCount()) - last_change_time > IDLE_TIMEOUT_MS) {
+            // 2. Idle Timeout (Sleep)
+            if (decision.sleep) {
                 ESP_LOGW(TAG, "Idle Timeout (%dms). Entering Deep Sleep...", IDLE_TIMEOUT_MS); 
-                esp_deep_sleep(SLEEP_DURATION * 1000000LL);
+                slept_ms_for_ota += sample_scheduler_sleep(&scheduler);
+                metrics_inc(METRIC_DEEP_SLEEPS);
+                dlog_flush(); // The ring is in RAM
+                hal_deep_sleep(sample_scheduler_sleep(&scheduler) * 1000ULL);
             }
 
-            ESP_LOGI(TAG, "V: %.4f V | I: %.4f A | P: %.4f W | F: %0.4f | E: %0.4f kJ | PF : %0.4f", data.voltage, data.current, data.power, data.frequency, data.energy, data.pf);
+            // Deferred: formatted later by the log task, see dlog.h
+            DLOG(DLOG_READING, data.voltage_dv / 10, data.voltage_dv % 10,
+                 data.current_ma / 1000, data.current_ma % 1000,
+                 data.power_dw / 10, data.power_dw % 10,
+                 data.freq_dhz / 10, data.freq_dhz % 10,
+                 data.energy_wh,
+                 data.pf_cent / 100, data.pf_cent % 100);
 
+            feature_stats_t power;
+            feature_window_get(&features, FEATURE_POWER, &power);
+            DLOG(DLOG_POWER_WINDOW, feature_window_count(&features), power.mean, power.min, power.max,
+                 power.ewma, power.slope_q8, feature_window_energy_rate_dw(&features));
+
+            sample_scheduler_next(&scheduler, changed != 0, data.power_dw, relay_state_logical);
         } else {
-            ESP_LOGW(TAG, "Sensor Read Failed");
+            DLOG(DLOG_READ_FAILED);
         }
 
-        vTaskDelay(pdMS_TO_TICKS(1000));
+        DLOG(DLOG_NEXT_SAMPLE, sample_scheduler_period(&scheduler),
+             DLOG_STR(sample_scheduler_reason_name(sample_scheduler_reasons(&scheduler))));
+        hal_delay_ms(sample_scheduler_period(&scheduler));
     }
 }
 
 void app_main(void)
 {
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-      ESP_ERROR_CHECK(nvs_flash_erase());
-      ret = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(ret);
+    hal_platform_init();
+    wake_trace_begin();
 
     pzem_init();
 
-    // 1. Read Sensor 
+    // 1. Read Sensor. All registers: a reading that goes back to sleep is
+    // journalled and rolled up with every field.
     pzem_data_t boot_check = pzem_read_registers();
+    wake_trace_mark(WAKE_SENSOR);
     
-    // 2. Check Data Changes
-    float p_diff = fabsf(boot_check.power - last_saved_data.power);
-
-    // 3. Increment OTA Counter
-    wake_count_for_ota++;
-    
-    // Check if it's time to force a wake-up for OTA (e.g. every 5 mins)
-    bool force_ota_check = (wake_count_for_ota >= OTA_CHECK_CYCLES);
-    // 4. Wake Up Decision
-    bool wake_up_fully = (p_diff > DATA_THRESHOLD) || (!has_run_before) || force_ota_check;
+    // 2. Check Data Changes (same detector as the sensor task, kept in RTC)
+    if (!detector.primed) {
+        change_detector_init(&detector, CHANGE_POLICY);
+    }
+    uint8_t changed = boot_check.valid ? change_detector_update(&detector, &boot_check) : 0;
+    if (!logic.has_run) {
+        sample_scheduler_init(&scheduler, OVERLOAD_POWER_DW);
+    }
 
-    if (wake_up_fully) {
+    // 3. Wake Up Decision: a change, the first boot or an OTA check due,
+    // or the meter's overload alarm (threshold set by protection_start)
+    bool wake = sensor_logic_wake(&logic, changed, slept_ms_for_ota);
+    if (wake || boot_check.alarm) {
         ESP_LOGI(TAG, "Waking Up Fully");
+        sample_scheduler_wake(&scheduler);
         
-        if (force_ota_check) {
-            ESP_LOGI(TAG, "(Reason: Periodic OTA Check - Cycle %d)", wake_count_for_ota);
-            wake_count_for_ota = 0; // Reset counter
+        if (slept_ms_for_ota >= OTA_CHECK_INTERVAL_MS) {
+            ESP_LOGI(TAG, "(Reason: Periodic OTA Check - %lu s asleep)", (unsigned long)slept_ms_for_ota / 1000);
         }
+        if (!wake) {
+            ESP_LOGW(TAG, "(Reason: Meter overload alarm - %lu dW)", (unsigned long)boot_check.power_dw);
+        }
+        slept_ms_for_ota = 0;
 
-        wifi_init_sta();
+        protection_start(&overload_config, &grid_config, &boot_check, mqtt_send_grid_event);
         mqtt_manager_init();
 
-        xTaskCreatePinnedToCore(sensor_logic_task, "sensor_task", 4096, NULL, 5, NULL, 1);
-        xTaskCreatePinnedToCore(mqtt_publisher_task, "pub_task", 4096, NULL, 5, NULL, 0);
-        xTaskCreate(ota_task, "ota_task", 8192, NULL, 3, NULL);
+        hal_task_create(sensor_logic_task, "sensor_task", 4096, 5, 1);
+        hal_task_create(mqtt_publisher_task, "pub_task", 4096, 5, 0);
+
+        // Sampling already runs on core 1 while WiFi comes up here, the
+        // publisher holds the samples until MQTT is connected
+        wifi_init_sta(mqtt_manager_start);
+
+        hal_task_create(ota_task, "ota_task", 8192, 3, HAL_CORE_ANY);
+        hal_task_create(dlog_task, "log_task", 3072, 1, 0);
     } 
     else {
 
-        ESP_LOGI(TAG, "No change (Cycle %d/%d). Sleeping...", wake_count_for_ota, OTA_CHECK_CYCLES);
+        uint32_t sleep_ms = sample_scheduler_next_sleep(&scheduler, boot_check.power_dw);
+        ESP_LOGI(TAG, "No change (%lu/%d s to OTA check). Sleeping %lu ms (%s)...",
+                 (unsigned long)slept_ms_for_ota / 1000, OTA_CHECK_INTERVAL_MS / 1000,
+                 (unsigned long)sleep_ms, sample_scheduler_reason_name(scheduler.sleep_reasons));
+
+        // Keep the reading for upload on the next full wake
+        if (boot_check.valid) {
+            rtc_journal_append(&boot_check, hal_rtc_millis());
+            rollup_add(&boot_check, hal_rtc_millis());
+        }
         /*gpio_config_t io_conf = {
             .pin_bit_mask = (1ULL << RELAY_PIN),
             .mode = GPIO_MODE_OUTPUT,
@@ -166,16 +208,16 @@ void app_main(void)
             .intr_type = GPIO_INTR_DISABLE
         };
         gpio_config(&io_conf);*/
-        gpio_reset_pin(RELAY_PIN);
-        gpio_set_direction(RELAY_PIN, GPIO_MODE_OUTPUT);
+        hal_relay_init();
 
         // 2. Set the Level (from RTC memory)
-        gpio_set_level(RELAY_PIN, 1);
+        hal_relay_set(1);
         
         // 3. Enable Hold (Lock the pin)
-        gpio_hold_en(RELAY_PIN);
-        gpio_deep_sleep_hold_en();
-        esp_deep_sleep(SLEEP_DURATION * 1000000LL);
+        hal_relay_hold();
+        slept_ms_for_ota += sleep_ms;
+        metrics_inc(METRIC_DEEP_SLEEPS);
+        hal_deep_sleep(sleep_ms * 1000ULL);
         
     }
 
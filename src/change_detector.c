@@ -0,0 +1,101 @@
+#include "change_detector.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const int32_t floors[CHANGE_CHANNELS] = {
+    CHANGE_FLOOR_POWER_DW, CHANGE_FLOOR_CURRENT_MA, CHANGE_FLOOR_VOLTAGE_DV,
+};
+
+static const int32_t thresholds[CHANGE_CHANNELS] = {
+    CHANGE_THRESHOLD_POWER_DW, CHANGE_THRESHOLD_CURRENT_MA, CHANGE_THRESHOLD_VOLTAGE_DV,
+};
+
+void change_detector_init(change_detector_t *det, change_policy_t policy) {
+    memset(det, 0, sizeof(*det));
+    det->policy = policy;
+}
+
+// mean |dx| = 2 sigma / sqrt(pi) for Gaussian noise, sigma ~ 7/8 of it
+static int32_t sigma_q4(const change_channel_state_t *s, int ch) {
+    int32_t sigma = s->noise_q4 * 7 / 8;
+    return sigma > (floors[ch] << 4) ? sigma : (floors[ch] << 4);
+}
+
+uint32_t change_detector_sigma(const change_detector_t *det, change_channel_t ch) {
+    return (uint32_t)(sigma_q4(&det->ch[ch], ch) >> 4);
+}
+
+static void reset(change_channel_state_t *s, int32_t x) {
+    s->ref = x;
+    s->up_q4 = 0;
+    s->down_q4 = 0;
+    s->mean_sum = x;
+    s->mean_n = 1;
+}
+
+static bool update_channel(change_detector_t *det, int ch, int32_t x) {
+    change_channel_state_t *s = &det->ch[ch];
+    const int32_t sigma = sigma_q4(s, ch);
+    const int32_t h = CHANGE_H * sigma;
+
+    if (det->policy == CHANGE_POLICY_THRESHOLD) {
+        if (labs(x - s->ref) > thresholds[ch]) {
+            reset(s, x);
+            return true;
+        }
+        return false;
+    }
+
+    // Noise from the first difference, one sample of a step is clipped
+    // so it cannot inflate the estimate much
+    int32_t dx = labs(x - s->last) << 4;
+    if (dx > CHANGE_NOISE_CLIP * sigma) dx = CHANGE_NOISE_CLIP * sigma;
+    s->noise_q4 += (dx - s->noise_q4) >> CHANGE_NOISE_SHIFT;
+    s->last = x;
+
+    int32_t ref = s->ref;
+    if (det->policy == CHANGE_POLICY_PAGE_HINKLEY) {
+        s->mean_sum += x;
+        s->mean_n++;
+        ref = (int32_t)(s->mean_sum / s->mean_n);
+    }
+
+    const int32_t r = (x - ref) << 4;
+    const int32_t k = CHANGE_K * sigma / 2;
+    s->up_q4 = s->up_q4 + r - k > 0 ? s->up_q4 + r - k : 0;
+    s->down_q4 = s->down_q4 - r - k > 0 ? s->down_q4 - r - k : 0;
+
+    if (s->up_q4 > h || s->down_q4 > h) {
+        reset(s, x);
+        return true;
+    }
+    return false;
+}
+
+uint8_t change_detector_update(change_detector_t *det, const pzem_data_t *data) {
+    const int32_t x[CHANGE_CHANNELS] = {
+        (int32_t)data->power_dw, (int32_t)data->current_ma, (int32_t)data->voltage_dv,
+    };
+    uint8_t changed = 0;
+
+    if (!det->primed) {
+        for (int ch = 0; ch < CHANGE_CHANNELS; ch++) {
+            det->ch[ch].last = x[ch];
+            reset(&det->ch[ch], x[ch]);
+        }
+        det->primed = true;
+        return 0;
+    }
+
+    for (int ch = 0; ch < CHANGE_CHANNELS; ch++) {
+        if (update_channel(det, ch, x[ch])) changed |= 1 << ch;
+    }
+    // A reported sample is the new reference on every channel, the same
+    // way the old code saved the whole reading
+    if (changed) {
+        for (int ch = 0; ch < CHANGE_CHANNELS; ch++) {
+            reset(&det->ch[ch], x[ch]);
+        }
+    }
+    return changed;
+}
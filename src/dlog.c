@@ -0,0 +1,192 @@
+#include "dlog.h"
+#include "hal.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DLOG_MASK (DLOG_DEPTH - 1)
+
+// Bounded multi-producer queue (Vyukov). A slot's seq says which position
+// it is ready for: free for position p when it reads p, holding p when it
+// reads p + 1, free again for p + DLOG_DEPTH once consumed. Stored minus
+// the slot index, so the zeroed ring starts out valid and logging works
+// before anything is initialised.
+typedef struct {
+    _Atomic uint32_t seq;
+    dlog_record_t rec;
+} dlog_slot_t;
+
+#define DLOG_LEVEL_OF(id, level, tag, fmt) level,
+#define DLOG_TAG_OF(id, level, tag, fmt) tag,
+#define DLOG_FORMAT_OF(id, level, tag, fmt) fmt,
+static const char levels[] = { DLOG_MESSAGES(DLOG_LEVEL_OF) };
+static const char *const tags[] = { DLOG_MESSAGES(DLOG_TAG_OF) };
+static const char *const formats[] = { DLOG_MESSAGES(DLOG_FORMAT_OF) };
+#undef DLOG_LEVEL_OF
+#undef DLOG_TAG_OF
+#undef DLOG_FORMAT_OF
+
+static dlog_slot_t slots[DLOG_DEPTH];
+static _Atomic uint32_t head;
+static uint32_t tail;                 // Consumer only
+static _Atomic uint32_t dropped;
+static _Atomic bool draining;
+
+void dlog_write(dlog_id_t id, int nargs, const dlog_arg_t *args) {
+    uint32_t pos = atomic_load_explicit(&head, memory_order_relaxed);
+    dlog_slot_t *slot;
+
+    for (;;) {
+        slot = &slots[pos & DLOG_MASK];
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire) + (pos & DLOG_MASK);
+        int32_t ahead = (int32_t)(seq - pos);
+        if (ahead == 0) {
+            if (atomic_compare_exchange_weak_explicit(&head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (ahead < 0) {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);   // Full
+            return;
+        } else {
+            pos = atomic_load_explicit(&head, memory_order_relaxed);   // Taken by another task
+        }
+    }
+
+    if (nargs > DLOG_MAX_ARGS) nargs = DLOG_MAX_ARGS;
+    slot->rec.id = (uint16_t)id;
+    slot->rec.nargs = (uint8_t)nargs;
+    slot->rec.ts_ms = hal_millis();
+    memcpy(slot->rec.args, args, (size_t)nargs * sizeof(dlog_arg_t));
+    atomic_store_explicit(&slot->seq, pos + 1 - (pos & DLOG_MASK), memory_order_release);
+}
+
+bool dlog_read(dlog_record_t *rec) {
+    dlog_slot_t *slot = &slots[tail & DLOG_MASK];
+    uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire) + (tail & DLOG_MASK);
+    if (seq != tail + 1) return false;
+
+    *rec = slot->rec;
+    atomic_store_explicit(&slot->seq, tail + DLOG_DEPTH - (tail & DLOG_MASK), memory_order_release);
+    tail++;
+    return true;
+}
+
+// printf with the arguments taken from the record one conversion at a
+// time. Every argument is a word, so a length modifier is implied.
+int dlog_format(const dlog_record_t *rec, char *buf, size_t len) {
+    const char *fmt = rec->id < DLOG_MESSAGE_COUNT ? formats[rec->id] : "<bad message id>";
+    size_t pos = 0;
+    int next = 0;
+
+    if (len == 0) return 0;
+    while (*fmt && pos + 1 < len) {
+        if (*fmt != '%' || fmt[1] == '%') {
+            buf[pos++] = *fmt;
+            fmt += (*fmt == '%') ? 2 : 1;
+            continue;
+        }
+
+        char spec[16];
+        int n = 0;
+        spec[n++] = *fmt++;
+        while (*fmt && strchr("-+ #0123456789.", *fmt) && n < (int)sizeof(spec) - 3) {
+            spec[n++] = *fmt++;
+        }
+        while (*fmt == 'l') fmt++;
+        char conv = *fmt ? *fmt++ : '\0';
+
+        int written;
+        if (next >= rec->nargs) {
+            written = snprintf(buf + pos, len - pos, "<?>");
+        } else {
+            dlog_arg_t arg = rec->args[next++];
+            switch (conv) {
+            case 'd':
+            case 'i':
+                spec[n++] = 'l';
+                spec[n++] = 'd';
+                spec[n] = '\0';
+                written = snprintf(buf + pos, len - pos, spec, (long)(intptr_t)arg);
+                break;
+            case 'u':
+            case 'x':
+            case 'X':
+                spec[n++] = 'l';
+                spec[n++] = conv;
+                spec[n] = '\0';
+                written = snprintf(buf + pos, len - pos, spec, (unsigned long)arg);
+                break;
+            case 'c':
+                spec[n++] = 'c';
+                spec[n] = '\0';
+                written = snprintf(buf + pos, len - pos, spec, (int)arg);
+                break;
+            case 's':
+                spec[n++] = 's';
+                spec[n] = '\0';
+                written = snprintf(buf + pos, len - pos, spec, arg ? (const char *)arg : "(null)");
+                break;
+            default:
+                written = snprintf(buf + pos, len - pos, "<%%%c?>", conv);
+                break;
+            }
+        }
+        if (written < 0) break;
+        pos += (size_t)written;
+        if (pos >= len) {
+            pos = len - 1;   // Cut
+            break;
+        }
+    }
+    buf[pos] = '\0';
+    return (int)pos;
+}
+
+void dlog_flush(void) {
+    static char text[DLOG_TEXT_MAX];
+    static uint32_t reported = 0;
+    dlog_record_t rec;
+
+    // dlog_task may be halfway through a batch on the other core
+    while (atomic_exchange_explicit(&draining, true, memory_order_acquire)) {
+        hal_delay_ms(1);
+    }
+
+    while (dlog_read(&rec)) {
+        dlog_format(&rec, text, sizeof(text));
+        hal_log_record(dlog_level(rec.id), dlog_tag(rec.id), rec.ts_ms, text);
+    }
+
+    uint32_t lost = dlog_dropped();
+    if (lost != reported) {
+        snprintf(text, sizeof(text), "%lu deferred messages lost", (unsigned long)(lost - reported));
+        hal_log_record('W', "DLOG", hal_millis(), text);
+        reported = lost;
+    }
+
+    atomic_store_explicit(&draining, false, memory_order_release);
+}
+
+void dlog_task(void *arg) {
+    while (1) {
+        dlog_flush();
+        hal_delay_ms(DLOG_DRAIN_MS);
+    }
+}
+
+char dlog_level(dlog_id_t id) {
+    return id < DLOG_MESSAGE_COUNT ? levels[id] : 'E';
+}
+
+const char *dlog_tag(dlog_id_t id) {
+    return id < DLOG_MESSAGE_COUNT ? tags[id] : "DLOG";
+}
+
+const char *dlog_format_string(dlog_id_t id) {
+    return id < DLOG_MESSAGE_COUNT ? formats[id] : NULL;
+}
+
+uint32_t dlog_dropped(void) {
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
@@ -0,0 +1,111 @@
+#include "feature_window.h"
+#include <string.h>
+
+// Min and max use the classic monotonic queue: sample numbers whose values
+// are increasing (min) or decreasing (max) from head to tail. A new value
+// pops every entry it dominates from the tail, entries that left the window
+// are popped from the head, so the head is always the extreme. Each queue
+// holds at most depth entries and is stored in the slots ring itself.
+
+bool feature_window_init(feature_window_t *fw, feature_slot_t *slots, uint32_t depth, uint8_t ewma_shift) {
+    if (depth == 0 || (depth & (depth - 1)) != 0 || ewma_shift > 16) return false;
+    memset(fw, 0, sizeof(*fw));
+    fw->slots = slots;
+    fw->mask = depth - 1;
+    fw->ewma_shift = ewma_shift;
+    return true;
+}
+
+static uint32_t value_at(const feature_window_t *fw, uint32_t n, int ch) {
+    return fw->slots[n & fw->mask].value[ch];
+}
+
+static void push_min(feature_window_t *fw, feature_channel_state_t *s, int ch, uint32_t n, uint32_t x) {
+    while (s->min_tail != s->min_head &&
+           value_at(fw, fw->slots[(s->min_tail - 1) & fw->mask].min_queue[ch], ch) >= x) {
+        s->min_tail--;
+    }
+    fw->slots[s->min_tail++ & fw->mask].min_queue[ch] = n;
+}
+
+static void push_max(feature_window_t *fw, feature_channel_state_t *s, int ch, uint32_t n, uint32_t x) {
+    while (s->max_tail != s->max_head &&
+           value_at(fw, fw->slots[(s->max_tail - 1) & fw->mask].max_queue[ch], ch) <= x) {
+        s->max_tail--;
+    }
+    fw->slots[s->max_tail++ & fw->mask].max_queue[ch] = n;
+}
+
+void feature_window_update(feature_window_t *fw, const pzem_data_t *data, uint32_t ts_ms) {
+    const uint32_t depth = fw->mask + 1;
+    const uint32_t n = fw->next++;
+    const uint32_t x[FEATURE_CHANNELS] = { data->power_dw, data->current_ma, data->voltage_dv, data->pf_cent };
+    feature_slot_t *slot = &fw->slots[n & fw->mask];
+    const bool full = (fw->count == depth);
+
+    for (int ch = 0; ch < FEATURE_CHANNELS; ch++) {
+        feature_channel_state_t *s = &fw->ch[ch];
+
+        if (full) {
+            // slot still holds the sample leaving the window
+            uint32_t old = slot->value[ch];
+            s->sum_kx -= s->sum - old;   // Every remaining sample moves one position down
+            s->sum -= old;
+            s->sum_sq -= (uint64_t)old * old;
+            if (fw->slots[s->min_head & fw->mask].min_queue[ch] == n - depth) s->min_head++;
+            if (fw->slots[s->max_head & fw->mask].max_queue[ch] == n - depth) s->max_head++;
+        }
+
+        s->sum_kx += (int64_t)(full ? depth - 1 : fw->count) * x[ch];
+        s->sum += x[ch];
+        s->sum_sq += (uint64_t)x[ch] * x[ch];
+
+        if (fw->count == 0) {
+            s->ewma_q8 = (int32_t)(x[ch] << 8);
+        } else {
+            s->ewma_q8 += ((int32_t)(x[ch] << 8) - s->ewma_q8) >> fw->ewma_shift;
+        }
+    }
+
+    // The queues read values through the slot, so store it first
+    slot->ts_ms = ts_ms;
+    slot->energy_wh = data->energy_wh;
+    memcpy(slot->value, x, sizeof(x));
+    for (int ch = 0; ch < FEATURE_CHANNELS; ch++) {
+        push_min(fw, &fw->ch[ch], ch, n, x[ch]);
+        push_max(fw, &fw->ch[ch], ch, n, x[ch]);
+    }
+    if (!full) fw->count++;
+}
+
+void feature_window_get(const feature_window_t *fw, feature_channel_t ch, feature_stats_t *out) {
+    const feature_channel_state_t *s = &fw->ch[ch];
+    const int64_t n = fw->count;
+
+    memset(out, 0, sizeof(*out));
+    if (n == 0) return;
+
+    out->mean = (int32_t)(s->sum / n);
+    out->variance = (uint64_t)(n * (int64_t)s->sum_sq - s->sum * s->sum) / (uint64_t)(n * n);
+    out->min = value_at(fw, fw->slots[s->min_head & fw->mask].min_queue[ch], ch);
+    out->max = value_at(fw, fw->slots[s->max_head & fw->mask].max_queue[ch], ch);
+    out->ewma = s->ewma_q8 >> 8;
+
+    // Positions 0..n-1: sum k = n(n-1)/2, n * sum k^2 - (sum k)^2 = n^2(n^2-1)/12
+    if (n > 1) {
+        int64_t num = n * s->sum_kx - (n * (n - 1) / 2) * s->sum;
+        int64_t den = n * n * (n * n - 1) / 12;
+        out->slope_q8 = (int32_t)(num * 256 / den);
+    }
+}
+
+uint32_t feature_window_energy_rate_dw(const feature_window_t *fw) {
+    if (fw->count < 2) return 0;
+    const feature_slot_t *first = &fw->slots[(fw->next - fw->count) & fw->mask];
+    const feature_slot_t *last = &fw->slots[(fw->next - 1) & fw->mask];
+    uint32_t dt = last->ts_ms - first->ts_ms;
+    if (dt < 1000) return 0;
+
+    // 1 Wh over dt ms = 36,000,000 / dt dW
+    return (uint32_t)((uint64_t)(last->energy_wh - first->energy_wh) * 36000000u / dt);
+}
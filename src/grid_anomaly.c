@@ -0,0 +1,197 @@
+#include "grid_anomaly.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BIT(type) (1u << (type))
+
+void grid_anomaly_init(grid_anomaly_t *g, const grid_config_t *cfg) {
+    memset(g, 0, sizeof(*g));
+    g->cfg = *cfg;
+    if (g->cfg.base_tau_ms == 0) g->cfg.base_tau_ms = 1;
+    if (g->cfg.load_tau_ms == 0) g->cfg.load_tau_ms = 1;
+}
+
+bool grid_anomaly_open(const grid_anomaly_t *g) {
+    return g->open;
+}
+
+static void set_reference(grid_anomaly_t *g, int32_t p, int32_t i, int32_t pf) {
+    g->ref_p = p;
+    g->ref_i = i;
+    g->ref_pf = pf;
+    g->pending = 0;
+}
+
+// Time-based EWMA, Q8, so the sample rate does not change the response
+static void follow(int32_t *level_q8, int32_t x, uint32_t dt, uint32_t tau_ms) {
+    if (dt > tau_ms) dt = tau_ms;
+    *level_q8 += (int32_t)((int64_t)((x << 8) - *level_q8) * dt / tau_ms);
+}
+
+// Smallest power change that counts as a load step: step_pct of the
+// reference, but never below step_dw
+static int32_t load_step(const grid_anomaly_t *g) {
+    const grid_config_t *c = &g->cfg;
+    int32_t step = g->ref_p * c->step_pct / 100;
+    if (step < (int32_t)c->step_dw) step = c->step_dw;
+    return step;
+}
+
+// Entry and exit tests of the excursions, exit with hysteresis
+static bool excursion(const grid_anomaly_t *g, grid_event_type_t type, int32_t v, int32_t dv, int32_t df,
+                      int32_t dp, int32_t di, bool in) {
+    const grid_config_t *c = &g->cfg;
+    const int32_t h = in ? 0 : c->hysteresis_dv;
+    switch (type) {
+    case GRID_EVENT_SURGE:
+        return dv >= c->surge_dv - h || v >= c->high_dv - h;
+    case GRID_EVENT_SAG:
+        if (in && dp >= load_step(g) && di > 0) return false;   // Our own load pulling the line down
+        return -dv >= c->sag_dv - h || v <= c->low_dv + h;
+    case GRID_EVENT_FREQUENCY:
+        return abs(df) >= c->freq_dhz - (in ? 0 : 1);
+    default:
+        return false;
+    }
+}
+
+static grid_severity_t severity(const grid_config_t *c, grid_event_type_t type, int32_t v, int32_t df) {
+    switch (type) {
+    case GRID_EVENT_SURGE:
+        return v >= c->high_dv ? GRID_SEVERITY_CRITICAL : GRID_SEVERITY_WARNING;
+    case GRID_EVENT_SAG:
+        return v <= c->low_dv ? GRID_SEVERITY_CRITICAL : GRID_SEVERITY_WARNING;
+    case GRID_EVENT_FREQUENCY:
+        return abs(df) >= c->freq_critical_dhz ? GRID_SEVERITY_CRITICAL : GRID_SEVERITY_WARNING;
+    default:
+        return GRID_SEVERITY_INFO;
+    }
+}
+
+static void update_trip(grid_anomaly_t *g, int32_t v, int32_t dv, uint32_t now_ms) {
+    const grid_config_t *c = &g->cfg;
+    bool trip = (c->trip == GRID_TRIP_ANY && (g->active & BIT(GRID_EVENT_SURGE))) ||
+                (c->trip != GRID_TRIP_NEVER && v >= c->high_dv);
+
+    if (trip) {
+        g->open = true;
+        g->calm = false;
+    } else if (g->open) {
+        if (!(dv < c->surge_dv - c->hysteresis_dv && v < c->high_dv - c->hysteresis_dv)) {
+            g->calm = false;
+        } else if (!g->calm) {
+            g->calm = true;
+            g->calm_ms = now_ms;
+        } else if (now_ms - g->calm_ms >= c->reclose_ms) {
+            g->open = false;
+            g->calm = false;
+        }
+    }
+}
+
+bool grid_anomaly_update(grid_anomaly_t *g, const pzem_data_t *d, uint32_t now_ms, grid_event_t *event) {
+    static const grid_event_type_t excursions[] = { GRID_EVENT_SURGE, GRID_EVENT_SAG, GRID_EVENT_FREQUENCY };
+    const grid_config_t *c = &g->cfg;
+    const int32_t v = d->voltage_dv, p = (int32_t)d->power_dw, i = (int32_t)d->current_ma, pf = d->pf_cent;
+
+    if (v == 0) return false;   // Meter without mains on its voltage input
+    if (!g->primed) {
+        g->base_v_q8 = v << 8;
+        g->load_p_q8 = p << 8;
+        g->load_i_q8 = i << 8;
+        g->last_ms = now_ms;
+        set_reference(g, p, i, pf);
+        g->primed = true;
+        return false;
+    }
+
+    // Voltage against the baseline before this reading, then let it
+    // learn. The load is smoothed first, a single odd reading is no step.
+    const uint32_t dt = now_ms - g->last_ms;
+    const int32_t dv = v - ((g->base_v_q8 + 128) >> 8);
+    const int32_t df = (int32_t)d->freq_dhz - c->nominal_dhz;
+    follow(&g->base_v_q8, v, dt, c->base_tau_ms);
+    follow(&g->load_p_q8, p, dt, c->load_tau_ms);
+    follow(&g->load_i_q8, i, dt, c->load_tau_ms);
+    const int32_t dp = ((g->load_p_q8 + 128) >> 8) - g->ref_p;
+    const int32_t di = ((g->load_i_q8 + 128) >> 8) - g->ref_i;
+    g->last_ms = now_ms;
+
+    grid_event_type_t type = GRID_EVENT_NONE;
+    for (size_t k = 0; k < sizeof(excursions) / sizeof(excursions[0]); k++) {
+        grid_event_type_t t = excursions[k];
+        if (g->active & BIT(t)) {
+            if (!excursion(g, t, v, dv, df, dp, di, false)) g->active &= ~BIT(t);
+        } else if (type == GRID_EVENT_NONE && excursion(g, t, v, dv, df, dp, di, true)) {
+            g->active |= BIT(t);
+            type = t;
+        }
+    }
+    update_trip(g, v, dv, now_ms);
+
+    if (g->active) {
+        // Whatever the load does now is the supply's doing
+        g->load_p_q8 = p << 8;
+        g->load_i_q8 = i << 8;
+        set_reference(g, p, i, pf);
+    } else if (type == GRID_EVENT_NONE) {
+        const int32_t step = load_step(g);
+        int8_t dir = (dp >= step && di > 0) ? 1 : (dp <= -step && di < 0) ? -1 : 0;
+
+        if (dir == 0) {
+            g->pending = 0;
+        } else if (dir != g->pending) {
+            g->pending = dir;
+            g->pending_ms = now_ms;
+        }
+        if (g->pending && now_ms - g->pending_ms >= c->load_confirm_ms) {
+            type = g->pending > 0 ? GRID_EVENT_LOAD_ON : GRID_EVENT_LOAD_OFF;
+        }
+    }
+    if (type == GRID_EVENT_NONE) return false;
+
+    event->ts_ms = now_ms;
+    event->type = type;
+    event->severity = severity(c, type, v, df);
+    event->voltage_dv = (uint16_t)v;
+    event->power_dw = (uint32_t)p;
+    event->dv = (int16_t)dv;
+    event->df = (int16_t)df;
+    event->dp = dp;
+    event->di = di;
+    event->dpf = (int16_t)(pf - g->ref_pf);
+    if (type == GRID_EVENT_LOAD_ON || type == GRID_EVENT_LOAD_OFF) {
+        set_reference(g, (g->load_p_q8 + 128) >> 8, (g->load_i_q8 + 128) >> 8, pf);
+    }
+    return true;
+}
+
+int grid_event_json(const grid_event_t *e, char *buf, size_t cap) {
+    int n = snprintf(buf, cap,
+                     "{\"ts\":%lu,\"event\":\"%s\",\"severity\":\"%s\",\"voltage\":%u,\"power\":%lu,"
+                     "\"dv\":%d,\"dp\":%ld,\"di\":%ld,\"dpf\":%d,\"df\":%d}",
+                     (unsigned long)e->ts_ms, grid_event_name(e->type), grid_severity_name(e->severity),
+                     e->voltage_dv, (unsigned long)e->power_dw, e->dv, (long)e->dp, (long)e->di, e->dpf, e->df);
+    return (n < 0 || (size_t)n >= cap) ? -1 : n;
+}
+
+const char *grid_event_name(grid_event_type_t type) {
+    switch (type) {
+    case GRID_EVENT_LOAD_ON:   return "load_on";
+    case GRID_EVENT_LOAD_OFF:  return "load_off";
+    case GRID_EVENT_SURGE:     return "surge";
+    case GRID_EVENT_SAG:       return "sag";
+    case GRID_EVENT_FREQUENCY: return "frequency";
+    default:                   return "";
+    }
+}
+
+const char *grid_severity_name(grid_severity_t severity) {
+    switch (severity) {
+    case GRID_SEVERITY_INFO:     return "info";
+    case GRID_SEVERITY_WARNING:  return "warning";
+    case GRID_SEVERITY_CRITICAL: return "critical";
+    }
+    return "";
+}
@@ -0,0 +1,203 @@
+#include "hal.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs_flash.h"
+#include "driver/gpio.h"
+#include "driver/uart.h"
+#include "esp_sleep.h"
+#include "esp_partition.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_mac.h"
+#include <stdio.h>
+#include <sys/time.h>
+
+// Config
+#define RELAY_PIN       GPIO_NUM_23
+#define PZEM_TXD_PIN    (GPIO_NUM_17)
+#define PZEM_RXD_PIN    (GPIO_NUM_16)
+#define UART_PORT_NUM   UART_NUM_2
+#define BUF_SIZE 128
+// Data partition in partitions.csv, e.g. "outbox, data, 0x40, , 512K"
+#define OUTBOX_PARTITION "outbox"
+#define HAL_MAX_TASKS    8
+
+static const esp_partition_t *outbox_partition = NULL;
+static TaskHandle_t task_handles[HAL_MAX_TASKS];
+static const char *task_names[HAL_MAX_TASKS];
+static int task_count = 0;
+
+void hal_platform_init(void) {
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+      ESP_ERROR_CHECK(nvs_flash_erase());
+      ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+
+#if CONFIG_PM_ENABLE && CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    // Light sleep whenever every task is blocked, e.g. between samples
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = 40,
+        .light_sleep_enable = true,
+    };
+    ESP_ERROR_CHECK(esp_pm_configure(&pm_config));
+#endif
+}
+
+// Same shape as ESP_LOGx output, with the time the record was taken
+void hal_log_record(char level, const char *tag, uint32_t ms, const char *text) {
+    esp_log_level_t l = level == 'E' ? ESP_LOG_ERROR : level == 'W' ? ESP_LOG_WARN :
+                        level == 'I' ? ESP_LOG_INFO : ESP_LOG_DEBUG;
+    esp_log_write(l, tag, "%c (%lu) %s: %s\n", level, (unsigned long)ms, tag, text);
+}
+
+// Kept for hal_task_stats
+static TaskHandle_t *track_task(const char *name) {
+    static TaskHandle_t untracked;
+    if (task_count == HAL_MAX_TASKS) return &untracked;
+    task_names[task_count] = name;
+    return &task_handles[task_count++];
+}
+
+void hal_task_create(hal_task_fn_t fn, const char *name, uint32_t stack, int prio, int core) {
+    if (core == HAL_CORE_ANY) {
+        xTaskCreate(fn, name, stack, NULL, prio, track_task(name));
+    } else {
+        xTaskCreatePinnedToCore(fn, name, stack, NULL, prio, track_task(name), core);
+    }
+}
+
+static void periodic_task(void *arg) {
+    hal_periodic_fn_t fn = (hal_periodic_fn_t)arg;
+    for (;;) {
+        TickType_t ticks = pdMS_TO_TICKS(fn(hal_millis()));
+        vTaskDelay(ticks ? ticks : 1);
+    }
+}
+
+void hal_periodic_create(hal_periodic_fn_t fn, const char *name, uint32_t stack, int prio, int core) {
+    if (core == HAL_CORE_ANY) {
+        xTaskCreate(periodic_task, name, stack, (void *)fn, prio, track_task(name));
+    } else {
+        xTaskCreatePinnedToCore(periodic_task, name, stack, (void *)fn, prio, track_task(name), core);
+    }
+}
+
+// ESP-IDF counts stack in bytes, not words
+int hal_task_stats(hal_task_stat_t *out, int max) {
+    int n = 0;
+    for (int i = 0; i < task_count && n < max; i++) {
+        if (!task_handles[i]) continue;
+        out[n].name = task_names[i];
+        out[n].stack_free = uxTaskGetStackHighWaterMark(task_handles[i]);
+        n++;
+    }
+    return n;
+}
+
+uint32_t hal_heap_min_free(void) {
+    return esp_get_minimum_free_heap_size();
+}
+
+const char *hal_device_id(void) {
+    static char id[20];
+    if (!id[0]) {
+        uint8_t mac[6];
+        esp_efuse_mac_get_default(mac);
+        snprintf(id, sizeof(id), "esp32-%02x%02x%02x%02x%02x%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    }
+    return id;
+}
+
+uint32_t hal_millis(void) {
+    return pdTICKS_TO_MS(xTaskGetTickCount());
+}
+
+uint32_t hal_micros(void) {
+    return (uint32_t)esp_timer_get_time();
+}
+
+void hal_delay_ms(uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void hal_deep_sleep(uint64_t us) {
+    esp_deep_sleep(us);
+}
+
+uint32_t hal_rtc_millis(void) {
+    // System time is kept by the RTC across deep sleep
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint32_t)((uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000);
+}
+
+void hal_relay_init(void) {
+    gpio_reset_pin(RELAY_PIN);
+    gpio_set_direction(RELAY_PIN, GPIO_MODE_OUTPUT);
+}
+
+void hal_relay_set(int level) {
+    gpio_set_level(RELAY_PIN, level);
+}
+
+void hal_relay_hold(void) {
+    gpio_hold_en(RELAY_PIN);
+    gpio_deep_sleep_hold_en();
+}
+
+void hal_uart_init(uint32_t baud) {
+    uart_config_t uart_config = {
+        .baud_rate = baud,
+        .data_bits = UART_DATA_8_BITS,
+        .parity    = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+    ESP_ERROR_CHECK(uart_driver_install(UART_PORT_NUM, BUF_SIZE * 2, 0, 0, NULL, 0));
+    ESP_ERROR_CHECK(uart_param_config(UART_PORT_NUM, &uart_config));
+    ESP_ERROR_CHECK(uart_set_pin(UART_PORT_NUM, PZEM_TXD_PIN, PZEM_RXD_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+}
+
+void hal_uart_flush_input(void) {
+    uart_flush_input(UART_PORT_NUM);
+}
+
+int hal_uart_write(const uint8_t *data, size_t len) {
+    return uart_write_bytes(UART_PORT_NUM, (const char *)data, len);
+}
+
+int hal_uart_read(uint8_t *data, size_t len, uint32_t timeout_ms) {
+    return uart_read_bytes(UART_PORT_NUM, data, len, pdMS_TO_TICKS(timeout_ms));
+}
+
+static const esp_partition_t *get_outbox_partition(void) {
+    if (!outbox_partition) {
+        outbox_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, OUTBOX_PARTITION);
+    }
+    return outbox_partition;
+}
+
+uint32_t hal_outbox_size(void) {
+    const esp_partition_t *part = get_outbox_partition();
+    return part ? part->size : 0;
+}
+
+bool hal_outbox_read(uint32_t offset, void *buf, size_t len) {
+    const esp_partition_t *part = get_outbox_partition();
+    return part && esp_partition_read(part, offset, buf, len) == ESP_OK;
+}
+
+bool hal_outbox_write(uint32_t offset, const void *buf, size_t len) {
+    const esp_partition_t *part = get_outbox_partition();
+    return part && esp_partition_write(part, offset, buf, len) == ESP_OK;
+}
+
+bool hal_outbox_erase(uint32_t offset, size_t len) {
+    const esp_partition_t *part = get_outbox_partition();
+    return part && esp_partition_erase_range(part, offset, len) == ESP_OK;
+}
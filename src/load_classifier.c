@@ -0,0 +1,44 @@
+#include "load_classifier.h"
+#include "load_classifier_model.h"
+#include <string.h>
+
+_Static_assert(LOAD_MODEL_CLASSES < LOAD_CLASS_UNKNOWN, "Class ids must fit the 4-bit telemetry field");
+
+// Complete trees in heap order: children of node i are 2i+1 (x <= t) and
+// 2i+2 (x > t), so the walk is the same DEPTH steps for every input
+static uint8_t predict_tree(int tree, const uint32_t *x) {
+    const uint8_t *feature = load_model_feature[tree];
+    const uint32_t *threshold = load_model_threshold[tree];
+    uint32_t i = 0;
+
+    for (int d = 0; d < LOAD_MODEL_DEPTH; d++) {
+        i = 2 * i + 1 + (x[feature[i]] > threshold[i]);
+    }
+    return load_model_leaf[tree][i - LOAD_MODEL_NODES];
+}
+
+uint8_t load_classifier_predict(const pzem_data_t *data) {
+    // Same order as FEATURES in tools/train_forest.py
+    const uint32_t x[LOAD_MODEL_FEATURES] = { data->power_dw, data->current_ma, data->pf_cent };
+    uint8_t votes[LOAD_MODEL_CLASSES];
+    memset(votes, 0, sizeof(votes));
+
+    for (int t = 0; t < LOAD_MODEL_TREES; t++) {
+        votes[predict_tree(t, x)]++;
+    }
+
+    // Majority vote, ties go to the lower class id
+    uint8_t best = 0;
+    for (uint8_t c = 1; c < LOAD_MODEL_CLASSES; c++) {
+        if (votes[c] > votes[best]) best = c;
+    }
+    return best;
+}
+
+const char *load_classifier_name(uint8_t load_class) {
+    return load_class < LOAD_MODEL_CLASSES ? load_model_class_names[load_class] : NULL;
+}
+
+int load_classifier_class_count(void) {
+    return LOAD_MODEL_CLASSES;
+}
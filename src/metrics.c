@@ -0,0 +1,139 @@
+#include "metrics.h"
+#include "hal.h"
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+typedef struct {
+    _Atomic uint32_t buckets[METRICS_HIST_BUCKETS + 1];   // Not cumulative, last is +Inf
+    _Atomic uint32_t count;
+    _Atomic uint64_t sum_us;
+} histogram_t;
+
+typedef struct {
+    const char *name;
+    uint32_t stack_free;
+} task_gauge_t;
+
+#define METRICS_NAME(id, name, help) name,
+#define METRICS_HELP(id, name, help) help,
+static const char *const counter_names[] = { METRICS_COUNTERS(METRICS_NAME) };
+static const char *const counter_help[] = { METRICS_COUNTERS(METRICS_HELP) };
+static const char *const histogram_names[] = { METRICS_HISTOGRAMS(METRICS_NAME) };
+static const char *const histogram_help[] = { METRICS_HISTOGRAMS(METRICS_HELP) };
+#undef METRICS_NAME
+#undef METRICS_HELP
+
+RTC_DATA_ATTR static _Atomic uint32_t counters[METRIC_COUNTER_COUNT];
+RTC_DATA_ATTR static histogram_t histograms[METRIC_HISTOGRAM_COUNT];
+static uint32_t heap_min_free;
+static task_gauge_t tasks[METRICS_MAX_TASKS];
+
+void metrics_inc(metric_counter_t id) {
+    atomic_fetch_add_explicit(&counters[id], 1, memory_order_relaxed);
+}
+
+void metrics_add(metric_counter_t id, uint32_t n) {
+    atomic_fetch_add_explicit(&counters[id], n, memory_order_relaxed);
+}
+
+uint32_t metrics_counter(metric_counter_t id) {
+    return atomic_load_explicit(&counters[id], memory_order_relaxed);
+}
+
+void metrics_observe_us(metric_histogram_t id, uint32_t us) {
+    histogram_t *h = &histograms[id];
+    int bucket = 0;
+    if (us > (1u << METRICS_HIST_MIN_SHIFT)) {
+        bucket = 32 - __builtin_clz(us - 1) - METRICS_HIST_MIN_SHIFT;
+        if (bucket > METRICS_HIST_BUCKETS) bucket = METRICS_HIST_BUCKETS;
+    }
+    atomic_fetch_add_explicit(&h->buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum_us, us, memory_order_relaxed);
+}
+
+void metrics_set_heap_min_free(uint32_t bytes) {
+    heap_min_free = bytes;
+}
+
+void metrics_set_task_stack_free(const char *task, uint32_t bytes) {
+    for (int i = 0; i < METRICS_MAX_TASKS; i++) {
+        if (!tasks[i].name || tasks[i].name == task) {
+            tasks[i].name = task;
+            tasks[i].stack_free = bytes;
+            return;
+        }
+    }
+}
+
+typedef struct {
+    char *p;
+    size_t left;
+    bool overflow;
+} writer_t;
+
+static void put(writer_t *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void put(writer_t *w, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(w->p, w->left, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= w->left) {
+        w->overflow = true;
+        w->left = 0;
+        return;
+    }
+    w->p += n;
+    w->left -= (size_t)n;
+}
+
+static void put_header(writer_t *w, const char *name, const char *help, const char *type) {
+    put(w, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// Microseconds as seconds, exact
+static void put_seconds(writer_t *w, uint64_t us) {
+    put(w, "%llu.%06llu", (unsigned long long)(us / 1000000), (unsigned long long)(us % 1000000));
+}
+
+int metrics_render(char *buf, size_t len, const char *device) {
+    writer_t w = { buf, len, len == 0 };
+
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        put_header(&w, counter_names[i], counter_help[i], "counter");
+        put(&w, "%s{device=\"%s\"} %lu\n", counter_names[i], device, (unsigned long)metrics_counter(i));
+    }
+
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        histogram_t *h = &histograms[i];
+        const char *name = histogram_names[i];
+        uint32_t cumulative = 0;
+
+        // Read count after the buckets so le="+Inf" never exceeds it
+        put_header(&w, name, histogram_help[i], "histogram");
+        for (int b = 0; b < METRICS_HIST_BUCKETS; b++) {
+            cumulative += atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+            put(&w, "%s_bucket{device=\"%s\",le=\"", name, device);
+            put_seconds(&w, 1ull << (b + METRICS_HIST_MIN_SHIFT));
+            put(&w, "\"} %lu\n", (unsigned long)cumulative);
+        }
+        cumulative += atomic_load_explicit(&h->buckets[METRICS_HIST_BUCKETS], memory_order_relaxed);
+        uint32_t count = atomic_load_explicit(&h->count, memory_order_relaxed);
+        if (count < cumulative) count = cumulative;
+        put(&w, "%s_bucket{device=\"%s\",le=\"+Inf\"} %lu\n", name, device, (unsigned long)count);
+        put(&w, "%s_sum{device=\"%s\"} ", name, device);
+        put_seconds(&w, atomic_load_explicit(&h->sum_us, memory_order_relaxed));
+        put(&w, "\n%s_count{device=\"%s\"} %lu\n", name, device, (unsigned long)count);
+    }
+
+    put_header(&w, "heap_min_free_bytes", "Lowest free heap since boot", "gauge");
+    put(&w, "heap_min_free_bytes{device=\"%s\"} %lu\n", device, (unsigned long)heap_min_free);
+    put_header(&w, "task_stack_free_bytes", "Stack never used by the task so far (high-water mark)", "gauge");
+    for (int i = 0; i < METRICS_MAX_TASKS && tasks[i].name; i++) {
+        put(&w, "task_stack_free_bytes{device=\"%s\",task=\"%s\"} %lu\n", device, tasks[i].name,
+            (unsigned long)tasks[i].stack_free);
+    }
+
+    return w.overflow ? -1 : (int)(w.p - buf);
+}
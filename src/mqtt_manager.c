@@ -1,73 +1,443 @@
 #include "mqtt_manager.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "mqtt_client.h"
-#include "esp_log.h"
-#include "cJSON.h"
+#include "hal.h"
+#include "telemetry.h"
+#include "sample_ring.h"
+#include "outbox.h"
+#include "rtc_journal.h"
+#include "metrics.h"
+#include "dlog.h"
+#include "wake_trace.h"
+#include "rollup.h"
+#include "app_config.h"
+#include <stdatomic.h>
 #include <string.h>
 
 #define MQTT_BROKER_URI "mqtt://broker.hivemq.com:1883"
-#define MQTT_TOPIC      "esp32/pzem/data"
+// Topics are in app_config.h
+
+// TELEMETRY_FMT_JSON or TELEMETRY_FMT_BINARY, the topic follows the format
+#define MQTT_PAYLOAD_FORMAT TELEMETRY_FMT_JSON
+
+// Batching: coalesce up to N samples or T ms into one publish.
+// 1 sample = one publish per sample on MQTT_TOPIC (batching off)
+#define MQTT_BATCH_MAX_SAMPLES     1
+#define MQTT_BATCH_MAX_LATENCY_MS  5000
+
+// Sensor -> publisher handoff. Depth must be a power of two.
+// SAMPLE_RING_OVERWRITE keeps the newest samples if the publisher falls
+// behind, SAMPLE_RING_BACKPRESSURE keeps the oldest and rejects new ones.
+#define MQTT_RING_DEPTH   32
+#define MQTT_RING_POLICY  SAMPLE_RING_OVERWRITE
+
+// Store-and-forward: samples that cannot be published go to the flash
+// outbox and are replayed after reconnect, one batch per interval,
+// between live publishes
+#define MQTT_REPLAY_MAX_SAMPLES  TELEMETRY_BATCH_MAX
+#define MQTT_REPLAY_INTERVAL_MS  1000
+
+// Samples taken before the first connection of a wake (the one that woke
+// us included) wait in the ring and go out live as soon as the session is
+// up. Only if that takes longer do they go to the outbox.
+#define MQTT_CONNECT_GRACE_MS 10000
+
+// Grid events from the protection task, kept until connected. Depth must
+// be a power of two, events that find it full are dropped.
+#define MQTT_EVENT_DEPTH 8
+
+// Rollups (rollup.h): closed buckets are published once, as many per
+// message as fit; a query on MQTT_TOPIC_ROLLUP_QUERY is answered on
+// MQTT_TOPIC_ROLLUP_REPLY the same way
+#define MQTT_ROLLUP_BATCH 16
+
+// Metrics snapshot (Prometheus text format, see metrics.h), retained so a
+// bridge that subscribes late still gets the latest one
+#define MQTT_METRICS_INTERVAL_MS 60000
 
 static const char *TAG = "MQTT_MGR";
 static esp_mqtt_client_handle_t mqtt_client = NULL;
 static bool mqtt_connected = false;
-static QueueHandle_t mqtt_queue = NULL;
-
-typedef struct {
-    char payload[256];
-} mqtt_msg_t;
+static bool connected_before = false;
+static bool client_started = false;
+static sample_ring_t sample_ring;
+static sample_slot_t sample_slots[MQTT_RING_DEPTH];
+static TaskHandle_t publisher_handle = NULL;
+static uint8_t payload[TELEMETRY_BATCH_BUF_SIZE];
+static grid_event_t events[MQTT_EVENT_DEPTH];
+static _Atomic uint32_t events_head = 0;   // Protection task
+static _Atomic uint32_t events_tail = 0;   // Publisher
+static char rollup_query[ROLLUP_QUERY_MAX];
+static _Atomic int rollup_query_len = 0;   // Set by the MQTT task, 0 once answered
+RTC_DATA_ATTR static uint32_t rollups_sent[ROLLUP_LEVELS];   // Next bucket to publish
 
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
     if (event_id == MQTT_EVENT_CONNECTED) {
         ESP_LOGI(TAG, "Connected to Broker");
+        wake_trace_mark(WAKE_MQTT_CONNECTED);
+        if (connected_before) {
+            metrics_inc(METRIC_RECONNECTS);
+        }
+        connected_before = true;
         mqtt_connected = true;
+        esp_mqtt_client_subscribe(mqtt_client, MQTT_TOPIC_ROLLUP_QUERY, 1);
+        if (publisher_handle) {
+            xTaskNotifyGive(publisher_handle); // Start replaying the outbox
+        }
     } else if (event_id == MQTT_EVENT_DISCONNECTED) {
         ESP_LOGW(TAG, "Disconnected from Broker");
         mqtt_connected = false;
+    } else if (event_id == MQTT_EVENT_DATA) {
+        esp_mqtt_event_handle_t event = event_data;
+        size_t topic_len = strlen(MQTT_TOPIC_ROLLUP_QUERY);
+        if (event->topic_len != (int)topic_len || memcmp(event->topic, MQTT_TOPIC_ROLLUP_QUERY, topic_len) != 0) {
+            return;
+        }
+        // One query at a time, the next one waits for the answer
+        if (event->data_len <= 0 || event->data_len > ROLLUP_QUERY_MAX ||
+            atomic_load_explicit(&rollup_query_len, memory_order_acquire) != 0) {
+            ESP_LOGW(TAG, "Rollup query ignored");
+            return;
+        }
+        memcpy(rollup_query, event->data, event->data_len);
+        atomic_store_explicit(&rollup_query_len, event->data_len, memory_order_release);
+        if (publisher_handle) {
+            xTaskNotifyGive(publisher_handle);
+        }
     }
 }
 
 void mqtt_manager_init(void) {
-    mqtt_queue = xQueueCreate(10, sizeof(mqtt_msg_t));
+    sample_ring_init(&sample_ring, sample_slots, MQTT_RING_DEPTH, MQTT_RING_POLICY);
+    outbox_init();
     
     esp_mqtt_client_config_t mqtt_cfg = {
         .broker.address.uri = MQTT_BROKER_URI,
     };
     mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
     esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
-    esp_mqtt_client_start(mqtt_client);
-}
-
-void mqtt_send_pzem_data(pzem_data_t data, bool relay_state) {
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "voltage", data.voltage);
-    cJSON_AddNumberToObject(root, "current", data.current);
-    cJSON_AddNumberToObject(root, "power", data.power);
-    cJSON_AddNumberToObject(root, "energy", data.energy);
-    cJSON_AddNumberToObject(root, "frequency", data.frequency);
-    cJSON_AddNumberToObject(root, "pf", data.pf);
-    cJSON_AddBoolToObject(root, "relay", relay_state);
-    
-    char *json_str = cJSON_PrintUnformatted(root);
-    
-    mqtt_msg_t msg;
-    strncpy(msg.payload, json_str, sizeof(msg.payload)-1);
-    msg.payload[sizeof(msg.payload)-1] = '\0'; // Ensure null term
-    
-    if (xQueueSend(mqtt_queue, &msg, 0) != pdPASS) {
-        ESP_LOGW(TAG, "Queue full, dropping packet");   
+}
+
+// Once there is an IP, so the first attempt does not fail and wait out
+// the reconnect timeout. The client reconnects by itself after that.
+void mqtt_manager_start(void) {
+    if (!client_started) {
+        client_started = true;
+        esp_mqtt_client_start(mqtt_client);
+    }
+}
+
+void mqtt_send_pzem_data(pzem_data_t data, bool relay_state, uint8_t load_class) {
+    telemetry_sample_t *slot = sample_ring_claim(&sample_ring);
+    if (!slot) {
+        DLOG(DLOG_RING_FULL);
+        return;
+    }
+    slot->ts_ms = hal_rtc_millis();
+    slot->data = data;
+    slot->relay = relay_state;
+    slot->load_class = load_class;
+    sample_ring_commit(&sample_ring);
+
+    if (publisher_handle) {
+        xTaskNotifyGive(publisher_handle);
+    }
+}
+
+void mqtt_send_grid_event(const grid_event_t *event) {
+    uint32_t head = atomic_load_explicit(&events_head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&events_tail, memory_order_acquire) >= MQTT_EVENT_DEPTH) {
+        metrics_inc(METRIC_QUEUE_DROPS);
+        return;
+    }
+    events[head & (MQTT_EVENT_DEPTH - 1)] = *event;
+    atomic_store_explicit(&events_head, head + 1, memory_order_release);
+
+    if (publisher_handle) {
+        xTaskNotifyGive(publisher_handle);
+    }
+}
+
+void mqtt_send_rollups(void) {
+    if (publisher_handle) {
+        xTaskNotifyGive(publisher_handle);
+    }
+}
+
+void mqtt_get_ring_stats(sample_ring_stats_t *stats) {
+    sample_ring_get_stats(&sample_ring, stats);
+}
+
+static void log_wake_trace(void) {
+    char text[WAKE_TRACE_TEXT_MAX];
+    if (wake_trace_format(text, sizeof(text)) >= 0) {
+        ESP_LOGI(TAG, "Wake: %s", text);
+    }
+}
+
+// Every publish goes through here to be counted and timed
+static int publish(const char *topic, const void *data, int len, int qos, int retain) {
+    uint32_t start = hal_micros();
+    int id = esp_mqtt_client_publish(mqtt_client, topic, (const char *)data, len, qos, retain);
+    metrics_observe_us(METRIC_PUBLISH, hal_micros() - start);
+    metrics_inc(id < 0 ? METRIC_PUBLISH_FAILURES : METRIC_PUBLISHES);
+    if (id >= 0 && wake_trace_mark(WAKE_FIRST_PUBLISH)) {
+        log_wake_trace();
+    }
+    return id;
+}
+
+static void store_batch(const telemetry_batch_t *batch) {
+    for (int i = 0; i < batch->count; i++) {
+        if (!outbox_append(&batch->samples[i])) {
+            ESP_LOGW(TAG, "Outbox unavailable, dropping %d samples", batch->count - i);
+            return;
+        }
+    }
+}
+
+// Serialization happens here, on the network core
+static void publish_batch(const telemetry_batch_t *batch) {
+    const bool binary = (MQTT_PAYLOAD_FORMAT == TELEMETRY_FMT_BINARY);
+    const char *topic;
+    int len;
+
+    if (!mqtt_connected) {
+        store_batch(batch);
+        return;
+    }
+
+    uint32_t start = hal_micros();
+    if (batch->count == 1) {
+        const telemetry_sample_t *s = &batch->samples[0];
+        len = telemetry_serialize(MQTT_PAYLOAD_FORMAT, s, payload, sizeof(payload));
+        topic = binary ? MQTT_TOPIC_BIN : MQTT_TOPIC;
+    } else {
+        len = telemetry_serialize_batch(MQTT_PAYLOAD_FORMAT, batch, payload, sizeof(payload));
+        topic = binary ? MQTT_TOPIC_BATCH_BIN : MQTT_TOPIC_BATCH;
+    }
+    metrics_observe_us(METRIC_SERIALIZE, hal_micros() - start);
+
+    if (len < 0) {
+        ESP_LOGE(TAG, "Payload does not fit, dropping %d samples", batch->count);
+        return;
+    }
+    if (publish(topic, payload, len, 1, 0) < 0) {
+        store_batch(batch);
+    }
+}
+
+// Oldest stored samples first, always in batch form
+static void replay_outbox(void) {
+    static telemetry_batch_t replay;
+    const bool binary = (MQTT_PAYLOAD_FORMAT == TELEMETRY_FMT_BINARY);
+
+    replay.count = outbox_peek(replay.samples, MQTT_REPLAY_MAX_SAMPLES);
+    if (replay.count == 0) {
+        outbox_consume(); // Only torn records were left
+        return;
+    }
+
+    uint32_t start = hal_micros();
+    int len = telemetry_serialize_batch(MQTT_PAYLOAD_FORMAT, &replay, payload, sizeof(payload));
+    metrics_observe_us(METRIC_SERIALIZE, hal_micros() - start);
+    if (len < 0) return;
+    if (publish(binary ? MQTT_TOPIC_REPLAY_BIN : MQTT_TOPIC_REPLAY, payload, len, 1, 0) >= 0) {
+        outbox_consume();
+        DLOG(DLOG_REPLAYED, replay.count, outbox_pending());
+    }
+}
+
+// Wake-check readings from deep sleep, one message for the whole journal
+static void upload_journal(void) {
+    static uint8_t journal[RTC_JOURNAL_EXPORT_MAX];
+    int len = rtc_journal_export(journal, sizeof(journal));
+    if (len < 0) return;
+
+    if (publish(MQTT_TOPIC_JOURNAL, journal, len, 1, 0) >= 0) {
+        ESP_LOGI(TAG, "Uploaded sleep journal: %lu samples in %d bytes (%lu dropped)",
+                 (unsigned long)rtc_journal_count(), len, (unsigned long)rtc_journal_dropped());
+        rtc_journal_clear();
+    }
+}
+
+// Oldest first, stops at the first refused publish to retry it later
+static void publish_events(void) {
+    char json[GRID_EVENT_JSON_MAX];
+    uint32_t tail = atomic_load_explicit(&events_tail, memory_order_relaxed);
+
+    while (tail != atomic_load_explicit(&events_head, memory_order_acquire)) {
+        int len = grid_event_json(&events[tail & (MQTT_EVENT_DEPTH - 1)], json, sizeof(json));
+        if (len >= 0 && publish(MQTT_TOPIC_EVENTS, json, len, 1, 0) < 0) return;
+        tail++;
+        atomic_store_explicit(&events_tail, tail, memory_order_release);
+    }
+}
+
+static bool in_range(const rollup_bucket_t *b, const rollup_query_t *q) {
+    uint32_t t = b->start_min * 60;
+    return !q || (t >= q->from_s && t <= q->to_s);
+}
+
+// Closed buckets of one level from seq on, in range of q if given, as
+// many per message as fit. Returns the first one not published.
+static uint32_t publish_rollup_range(const char *topic, rollup_level_t level, uint32_t seq, const rollup_query_t *q,
+                                     int *messages) {
+    static char json[ROLLUP_JSON_MAX];
+    rollup_bucket_t buckets[MQTT_ROLLUP_BATCH];
+    uint32_t seqs[MQTT_ROLLUP_BATCH];
+
+    for (;;) {
+        uint32_t end = rollup_closed(level);
+        uint32_t oldest = rollup_oldest(level);
+        if ((int32_t)(oldest - seq) > 0) seq = oldest;   // Overwritten before we got to them
+
+        int n = 0, done;
+        for (; seq != end && n < MQTT_ROLLUP_BATCH; seq++) {
+            if (rollup_get(level, seq, &buckets[n]) && in_range(&buckets[n], q)) {
+                seqs[n++] = seq;
+            }
+        }
+        if (n == 0 && (!q || *messages > 0)) return seq;
+
+        int len = rollup_render(level, buckets, n, hal_rtc_millis(), json, sizeof(json), &done);
+        if (len < 0) return seq;
+        if (publish(topic, json, len, q ? 0 : 1, 0) < 0) return n ? seqs[0] : seq;
+        (*messages)++;
+        if (n == 0) return seq;               // Empty answer
+        if (done < n) seq = seqs[done];       // The rest go in the next message
     }
+}
 
-    free(json_str);
-    cJSON_Delete(root);
+static void publish_rollups(void) {
+    for (int level = 0; level < ROLLUP_LEVELS; level++) {
+        int messages = 0;
+        if (rollups_sent[level] != rollup_closed(level)) {
+            rollups_sent[level] = publish_rollup_range(MQTT_TOPIC_ROLLUP, level, rollups_sent[level], NULL, &messages);
+        }
+    }
+}
+
+static void answer_rollup_query(void) {
+    rollup_query_t q;
+    int messages = 0;
+    int len = atomic_load_explicit(&rollup_query_len, memory_order_acquire);
+
+    if (len == 0) return;
+    if (rollup_parse_query(rollup_query, len, &q)) {
+        publish_rollup_range(MQTT_TOPIC_ROLLUP_REPLY, q.level, rollup_oldest(q.level), &q, &messages);
+    } else {
+        static const char error[] = "{\"error\":\"bad query\"}";
+        publish(MQTT_TOPIC_ROLLUP_REPLY, error, sizeof(error) - 1, 0, 0);
+    }
+    atomic_store_explicit(&rollup_query_len, 0, memory_order_release);
+}
+
+// Gauges are sampled here, counters and histograms are kept as they happen
+static void publish_metrics(void) {
+    static char text[METRICS_RENDER_MAX];
+    hal_task_stat_t tasks[METRICS_MAX_TASKS];
+
+    int n = hal_task_stats(tasks, METRICS_MAX_TASKS);
+    for (int i = 0; i < n; i++) {
+        metrics_set_task_stack_free(tasks[i].name, tasks[i].stack_free);
+    }
+    metrics_set_heap_min_free(hal_heap_min_free());
+
+    int len = metrics_render(text, sizeof(text), hal_device_id());
+    if (len < 0) {
+        ESP_LOGE(TAG, "Metrics do not fit in %d bytes", METRICS_RENDER_MAX);
+        return;
+    }
+    publish(MQTT_TOPIC_METRICS, text, len, 0, 1);
+}
+
+// Ring drops and overwrites since the last call
+static void count_queue_drops(void) {
+    static uint32_t seen = 0;
+    sample_ring_stats_t st;
+    sample_ring_get_stats(&sample_ring, &st);
+    uint32_t lost = st.dropped + st.overwritten;
+    if (lost != seen) {
+        metrics_add(METRIC_QUEUE_DROPS, lost - seen);
+        seen = lost;
+    }
 }
 
 void mqtt_publisher_task(void *arg) {
-    mqtt_msg_t incoming;
+    static telemetry_batch_t batch;
+    bool backlog = false;
+    uint32_t last_replay = 0;
+    uint32_t last_metrics = hal_millis();
+    const uint32_t start_ms = hal_millis();
+    publisher_handle = xTaskGetCurrentTaskHandle();
+
     while(1) {
-        if (xQueueReceive(mqtt_queue, &incoming, portMAX_DELAY)) {
+        // Block until notified, then only until the batch or replay deadline
+        TickType_t wait = portMAX_DELAY;
+        uint32_t awake = hal_millis() - start_ms;
+        if (!connected_before && awake < MQTT_CONNECT_GRACE_MS) {
+            wait = pdMS_TO_TICKS(MQTT_CONNECT_GRACE_MS - awake);
+        } else if (backlog) {
+            wait = 0;
+        } else if (batch.count > 0) {
+            uint32_t age = hal_rtc_millis() - batch.samples[0].ts_ms;
+            wait = (age >= MQTT_BATCH_MAX_LATENCY_MS) ? 0 : pdMS_TO_TICKS(MQTT_BATCH_MAX_LATENCY_MS - age);
+        }
+        if (mqtt_connected && outbox_pending() > 0 && wait > pdMS_TO_TICKS(MQTT_REPLAY_INTERVAL_MS)) {
+            wait = pdMS_TO_TICKS(MQTT_REPLAY_INTERVAL_MS);
+        }
+        uint32_t since_metrics = hal_millis() - last_metrics;
+        TickType_t metrics_wait = since_metrics >= MQTT_METRICS_INTERVAL_MS ? 0 : pdMS_TO_TICKS(MQTT_METRICS_INTERVAL_MS - since_metrics);
+        if (wait > metrics_wait) {
+            wait = metrics_wait;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        bool full = false;
+        bool holding = !connected_before && hal_millis() - start_ms < MQTT_CONNECT_GRACE_MS;
+        backlog = false;
+        while (!holding) {
+            const telemetry_sample_t *s = sample_ring_peek(&sample_ring);
+            if (!s) break;
+            full = telemetry_batch_add(&batch, s, MQTT_BATCH_MAX_SAMPLES);
+            if (!sample_ring_release(&sample_ring)) {
+                batch.count--; // Overwritten while we copied it
+                full = false;
+            }
+            if (full) {
+                backlog = true;
+                break;
+            }
+        }
+
+        if (full || telemetry_batch_expired(&batch, hal_rtc_millis(), MQTT_BATCH_MAX_LATENCY_MS)) {
+            publish_batch(&batch);
+            batch.count = 0;
+        }
+
+        if (mqtt_connected && rtc_journal_count() > 0) {
+            upload_journal();
+        }
+
+        if (mqtt_connected) {
+            publish_events();
+            publish_rollups();
+            answer_rollup_query();
+        }
+
+        if (mqtt_connected && outbox_pending() > 0 && hal_millis() - last_replay >= MQTT_REPLAY_INTERVAL_MS) {
+            replay_outbox();
+            last_replay = hal_millis();
+        }
+
+        count_queue_drops();
+        if (hal_millis() - last_metrics >= MQTT_METRICS_INTERVAL_MS) {
             if (mqtt_connected) {
-                esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC, incoming.payload, 0, 1, 0);
+                publish_metrics();
             }
+            last_metrics = hal_millis();
         }
     }
 }
\ No newline at end of file
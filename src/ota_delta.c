@@ -0,0 +1,268 @@
+#include "ota_delta.h"
+#include <string.h>
+
+enum {
+    ST_HEADER,
+    ST_OP,
+    ST_DIFF_SOURCE,
+    ST_DIFF_LEN,
+    ST_DIFF_FIXUPS,
+    ST_FIX_SKIP,
+    ST_FIX_COUNT,
+    ST_FIX_BYTES,
+    ST_DATA_LEN,
+    ST_DATA_BYTES,
+    ST_END,
+};
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+void ota_delta_init(ota_delta_t *d, ota_delta_read_fn read, ota_delta_write_fn write, void *ctx) {
+    memset(d, 0, sizeof(*d));
+    d->read = read;
+    d->write = write;
+    d->ctx = ctx;
+    d->status = OTA_DELTA_MORE;
+    d->state = ST_HEADER;
+    sha256_init(&d->hash);
+}
+
+static ota_delta_status_t fail(ota_delta_t *d, ota_delta_status_t status) {
+    d->status = status;
+    return status;
+}
+
+// Accumulates a LEB128 varint, true once its last byte is in
+static bool varint_byte(ota_delta_t *d, uint8_t c, bool *overflow) {
+    if (d->varint_shift > 28 || (d->varint_shift == 28 && (c & 0x70))) {
+        *overflow = true;
+        return false;
+    }
+    d->varint |= (uint32_t)(c & 0x7F) << d->varint_shift;
+    d->varint_shift += 7;
+    return !(c & 0x80);
+}
+
+static bool flush(ota_delta_t *d) {
+    if (d->out_len == 0) return true;
+    sha256_update(&d->hash, d->out, d->out_len);
+    bool ok = d->write(d->ctx, d->out, d->out_len);
+    d->out_len = 0;
+    return ok;
+}
+
+static bool emit(ota_delta_t *d, uint8_t c) {
+    d->out[d->out_len++] = c;
+    d->written++;
+    d->left--;
+    return d->out_len < OTA_DELTA_BUF_LEN || flush(d);
+}
+
+// Makes source_pos readable from the read-ahead buffer
+static bool source_window(ota_delta_t *d) {
+    if (d->source_pos >= d->src_off && d->source_pos < d->src_off + d->src_len) return true;
+    uint32_t len = d->source_size - d->source_pos;
+    if (len > OTA_DELTA_BUF_LEN) len = OTA_DELTA_BUF_LEN;
+    d->src_off = d->source_pos;
+    d->src_len = len;
+    if (!d->read(d->ctx, d->src_off, d->src, len)) {
+        d->src_len = 0;
+        return false;
+    }
+    return true;
+}
+
+// n unchanged bytes from the source
+static bool copy_source(ota_delta_t *d, uint32_t n) {
+    while (n) {
+        if (!source_window(d)) return false;
+        uint32_t run = d->src_off + d->src_len - d->source_pos;
+        if (run > n) run = n;
+        if (run > OTA_DELTA_BUF_LEN - d->out_len) run = OTA_DELTA_BUF_LEN - d->out_len;
+        memcpy(d->out + d->out_len, d->src + (d->source_pos - d->src_off), run);
+        d->out_len += run;
+        d->source_pos += run;
+        d->written += run;
+        d->left -= run;
+        n -= run;
+        if (d->out_len == OTA_DELTA_BUF_LEN && !flush(d)) return false;
+    }
+    return true;
+}
+
+// The patch is only valid for the exact image it was made from
+static ota_delta_status_t check_source(ota_delta_t *d) {
+    sha256_ctx_t ctx;
+    uint8_t digest[SHA256_DIGEST_LEN];
+
+    if (memcmp(d->header, OTA_DELTA_MAGIC, 4) != 0) return OTA_DELTA_ERR_FORMAT;
+    d->source_size = get_u32(d->header + 4);
+    d->target_size = get_u32(d->header + 8);
+
+    sha256_init(&ctx);
+    for (uint32_t off = 0; off < d->source_size; off += OTA_DELTA_BUF_LEN) {
+        uint32_t len = d->source_size - off;
+        if (len > OTA_DELTA_BUF_LEN) len = OTA_DELTA_BUF_LEN;
+        if (!d->read(d->ctx, off, d->src, len)) return OTA_DELTA_ERR_IO;
+        sha256_update(&ctx, d->src, len);
+    }
+    sha256_final(&ctx, digest);
+    if (memcmp(digest, d->header + 12, SHA256_DIGEST_LEN) != 0) return OTA_DELTA_ERR_SOURCE;
+    return OTA_DELTA_MORE;
+}
+
+static ota_delta_status_t check_target(ota_delta_t *d) {
+    uint8_t digest[SHA256_DIGEST_LEN];
+
+    if (!flush(d)) return OTA_DELTA_ERR_IO;
+    if (d->written != d->target_size) return OTA_DELTA_ERR_HASH;
+    sha256_final(&d->hash, digest);
+    if (memcmp(digest, d->header + 12 + SHA256_DIGEST_LEN, SHA256_DIGEST_LEN) != 0) return OTA_DELTA_ERR_HASH;
+    return OTA_DELTA_DONE;
+}
+
+// Sets up the next varint field
+static void expect(ota_delta_t *d, uint8_t state) {
+    d->state = state;
+    d->varint = 0;
+    d->varint_shift = 0;
+}
+
+// Rest of the DIFF after its last fixup
+static bool finish_diff(ota_delta_t *d) {
+    if (!copy_source(d, d->left)) return false;
+    d->state = ST_OP;
+    return true;
+}
+
+ota_delta_status_t ota_delta_feed(ota_delta_t *d, const void *data, size_t len) {
+    const uint8_t *p = data;
+
+    for (size_t i = 0; i < len && d->status == OTA_DELTA_MORE; i++) {
+        uint8_t c = p[i];
+        bool overflow = false;
+        d->patch_bytes++;
+
+        switch (d->state) {
+        case ST_HEADER:
+            d->header[d->fill++] = c;
+            if (d->fill == OTA_DELTA_HEADER_LEN) {
+                ota_delta_status_t status = check_source(d);
+                if (status != OTA_DELTA_MORE) return fail(d, status);
+                d->source_pos = 0;
+                d->state = ST_OP;
+            }
+            break;
+
+        case ST_OP:
+            if (c == OTA_DELTA_OP_END) {
+                d->state = ST_END;
+                return fail(d, check_target(d));
+            } else if (c == OTA_DELTA_OP_DIFF) {
+                expect(d, ST_DIFF_SOURCE);
+            } else if (c == OTA_DELTA_OP_DATA) {
+                expect(d, ST_DATA_LEN);
+            } else {
+                return fail(d, OTA_DELTA_ERR_FORMAT);
+            }
+            break;
+
+        case ST_DIFF_SOURCE:
+            if (!varint_byte(d, c, &overflow)) break;
+            {
+                // Zigzag: small moves either way stay one or two bytes
+                int64_t pos = (int64_t)d->source_pos + (int32_t)((d->varint >> 1) ^ (0u - (d->varint & 1)));
+                if (pos < 0 || pos > d->source_size) return fail(d, OTA_DELTA_ERR_FORMAT);
+                d->source_pos = (uint32_t)pos;
+            }
+            expect(d, ST_DIFF_LEN);
+            break;
+
+        case ST_DIFF_LEN:
+            if (!varint_byte(d, c, &overflow)) break;
+            if ((uint64_t)d->source_pos + d->varint > d->source_size ||
+                (uint64_t)d->written + d->varint > d->target_size) {
+                return fail(d, OTA_DELTA_ERR_FORMAT);
+            }
+            d->left = d->varint;
+            expect(d, ST_DIFF_FIXUPS);
+            break;
+
+        case ST_DIFF_FIXUPS:
+            if (!varint_byte(d, c, &overflow)) break;
+            d->fixups = d->varint;
+            if (d->fixups == 0) {
+                if (!finish_diff(d)) return fail(d, OTA_DELTA_ERR_IO);
+            } else {
+                expect(d, ST_FIX_SKIP);
+            }
+            break;
+
+        case ST_FIX_SKIP:
+            if (!varint_byte(d, c, &overflow)) break;
+            {
+                uint32_t skip = d->varint >> 3, code = d->varint & 7;
+                if (skip > d->left) return fail(d, OTA_DELTA_ERR_FORMAT);
+                if (!copy_source(d, skip)) return fail(d, OTA_DELTA_ERR_IO);
+                if (code < 7) {
+                    d->count = code + 1;
+                    if (d->count > d->left) return fail(d, OTA_DELTA_ERR_FORMAT);
+                    d->state = ST_FIX_BYTES;
+                } else {
+                    expect(d, ST_FIX_COUNT);
+                }
+            }
+            break;
+
+        case ST_FIX_COUNT:
+            if (!varint_byte(d, c, &overflow)) break;
+            if (d->left < 8 || d->varint > d->left - 8) return fail(d, OTA_DELTA_ERR_FORMAT);
+            d->count = d->varint + 8;
+            d->state = ST_FIX_BYTES;
+            break;
+
+        case ST_FIX_BYTES:
+            if (!source_window(d)) return fail(d, OTA_DELTA_ERR_IO);
+            if (!emit(d, (uint8_t)(d->src[d->source_pos++ - d->src_off] + c))) return fail(d, OTA_DELTA_ERR_IO);
+            if (--d->count) break;
+            if (--d->fixups) {
+                expect(d, ST_FIX_SKIP);
+            } else if (!finish_diff(d)) {
+                return fail(d, OTA_DELTA_ERR_IO);
+            }
+            break;
+
+        case ST_DATA_LEN:
+            if (!varint_byte(d, c, &overflow)) break;
+            if ((uint64_t)d->written + d->varint > d->target_size) return fail(d, OTA_DELTA_ERR_FORMAT);
+            d->left = d->count = d->varint;
+            d->state = d->count ? ST_DATA_BYTES : ST_OP;
+            break;
+
+        case ST_DATA_BYTES:
+            if (!emit(d, c)) return fail(d, OTA_DELTA_ERR_IO);
+            if (--d->count == 0) d->state = ST_OP;
+            break;
+
+        default:
+            // Nothing may follow END
+            return fail(d, OTA_DELTA_ERR_FORMAT);
+        }
+        if (overflow) return fail(d, OTA_DELTA_ERR_FORMAT);
+    }
+    return d->status;
+}
+
+const char *ota_delta_status_name(ota_delta_status_t status) {
+    switch (status) {
+    case OTA_DELTA_MORE:       return "incomplete";
+    case OTA_DELTA_DONE:       return "done";
+    case OTA_DELTA_ERR_FORMAT: return "bad patch";
+    case OTA_DELTA_ERR_SOURCE: return "wrong source image";
+    case OTA_DELTA_ERR_IO:     return "flash error";
+    case OTA_DELTA_ERR_HASH:   return "hash mismatch";
+    }
+    return "";
+}
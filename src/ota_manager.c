@@ -1,12 +1,20 @@
 #include "ota_manager.h"
+#include "ota_poll.h"
+#include "ota_delta.h"
+#include "metrics.h"
 #include "esp_http_client.h"
 #include "esp_https_ota.h"
 #include "esp_crt_bundle.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
 #include "esp_log.h"
-#include "cJSON.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <string.h>
+#include <strings.h>
 
 // Malas pakai file sendiri
 #define GITHUB_JSON_URL "xxxxxxx"
@@ -20,6 +28,15 @@
 
 static const char *TAG = "OTA_MGR";
 
+// Survives deep sleep, so the first check after a wake can already be a 304
+RTC_DATA_ATTR static ota_poll_t poll_state;
+
+// One manifest request, filled by the event handler
+typedef struct {
+    ota_manifest_t manifest;
+    char etag[OTA_ETAG_MAX];
+} ota_check_t;
+
 static void cleanup_url(char *url) {
     if (!url) return;
     char *src = url, *dst = url;
@@ -32,31 +49,20 @@ static void cleanup_url(char *url) {
     *dst = '\0';
 }
 
-
-// FIXED: Robust Event Handler to prevent Garbage/Overflow
+// All state lives in the request's ota_check_t, the body streams into
+// the parser whether it is chunked or not
 static esp_err_t _http_event_handler(esp_http_client_event_t *evt) {
-    static int output_len;
-    
-    // Reset length when a new request starts
-    if (evt->event_id == HTTP_EVENT_ERROR || evt->event_id == HTTP_EVENT_ON_CONNECTED) {
-        output_len = 0;
-    }
-    
-    if(evt->event_id == HTTP_EVENT_ON_DATA) {
-        if (!esp_http_client_is_chunked_response(evt->client)) {
-            if (evt->user_data) {
-                // Safety 1: Prevent buffer overflow (leave 1 byte for null terminator)
-                if (output_len + evt->data_len < 2047) {
-                    memcpy(evt->user_data + output_len, evt->data, evt->data_len);
-                    output_len += evt->data_len;
-                    // Safety 2: FORCE Null Termination immediately
-                    ((char*)evt->user_data)[output_len] = '\0'; 
-                }
+    ota_check_t *check = evt->user_data;
+
+    if (evt->event_id == HTTP_EVENT_ON_HEADER) {
+        if (strcasecmp(evt->header_key, "ETag") == 0) {
+            size_t len = strlen(evt->header_value);
+            if (len < sizeof(check->etag)) {
+                memcpy(check->etag, evt->header_value, len + 1);
             }
         }
-    } 
-    else if (evt->event_id == HTTP_EVENT_ON_FINISH) {
-        output_len = 0;
+    } else if (evt->event_id == HTTP_EVENT_ON_DATA) {
+        ota_manifest_feed(&check->manifest, evt->data, evt->data_len);
     }
     return ESP_OK;
 }
@@ -83,69 +89,162 @@ static void run_ota_update(const char* url) {
     }
 }
 
+typedef struct {
+    const esp_partition_t *running;
+    esp_ota_handle_t handle;
+} delta_target_t;
+
+static bool read_running(void *ctx, uint32_t offset, void *buf, size_t len) {
+    delta_target_t *t = ctx;
+    return esp_partition_read(t->running, offset, buf, len) == ESP_OK;
+}
+
+static bool write_update(void *ctx, const void *buf, size_t len) {
+    delta_target_t *t = ctx;
+    return esp_ota_write(t->handle, buf, len) == ESP_OK;
+}
+
+// Streams the patch from the running image into the update partition.
+// Restarts on success; returns if anything fails so the caller can fall
+// back to the full image.
+static void run_delta_update(const char *url) {
+    static ota_delta_t delta;
+    static char buf[1024];
+    delta_target_t target = { .running = esp_ota_get_running_partition() };
+    const esp_partition_t *update = esp_ota_get_next_update_partition(NULL);
+    ota_delta_status_t status = OTA_DELTA_MORE;
+
+    ESP_LOGI(TAG, "Starting delta OTA from: %s", url);
+    if (!target.running || !update || esp_ota_begin(update, OTA_SIZE_UNKNOWN, &target.handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Delta OTA: no update partition");
+        return;
+    }
+
+    esp_http_client_config_t config = {
+        .url = url,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .username = "token",
+        .password = GITHUB_TOKEN_RAW,
+        .auth_type = HTTP_AUTH_TYPE_BASIC,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    int64_t start = esp_timer_get_time();
+
+    if (esp_http_client_open(client, 0) == ESP_OK && esp_http_client_fetch_headers(client) >= 0 &&
+        esp_http_client_get_status_code(client) == 200) {
+        ota_delta_init(&delta, read_running, write_update, &target);
+        int n;
+        while (status == OTA_DELTA_MORE && (n = esp_http_client_read(client, buf, sizeof(buf))) > 0) {
+            status = ota_delta_feed(&delta, buf, (size_t)n);
+        }
+    } else {
+        ESP_LOGE(TAG, "Delta OTA: download failed (HTTP %d)", esp_http_client_get_status_code(client));
+    }
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+
+    if (status == OTA_DELTA_DONE && esp_ota_end(target.handle) == ESP_OK &&
+        esp_ota_set_boot_partition(update) == ESP_OK) {
+        ESP_LOGI(TAG, "Delta OTA Success: %lu byte patch for a %lu byte image in %lld ms. Restarting...",
+                 (unsigned long)delta.patch_bytes, (unsigned long)delta.target_size,
+                 (long long)(esp_timer_get_time() - start) / 1000);
+        esp_restart();
+    }
+    if (status == OTA_DELTA_DONE) {
+        ESP_LOGE(TAG, "Delta OTA: image rejected");
+    } else {
+        ESP_LOGE(TAG, "Delta OTA Failed: %s after %lu patch bytes", ota_delta_status_name(status),
+                 (unsigned long)delta.patch_bytes);
+        esp_ota_abort(target.handle);
+    }
+}
+
+// One conditional GET on the kept-alive session
+static ota_poll_result_t check_manifest(esp_http_client_handle_t client, ota_check_t *check) {
+    metrics_inc(METRIC_OTA_CHECKS);
+    ota_manifest_init(&check->manifest);
+    check->etag[0] = '\0';
+    // A newer version was seen but this image is still running: the update
+    // failed or was cut short, so fetch the manifest in full and retry it
+    // rather than taking a 304 for it
+    bool pending = poll_state.version[0] && atof(poll_state.version) > CURRENT_VERSION;
+    if (poll_state.etag[0] && !pending) {
+        esp_http_client_set_header(client, "If-None-Match", poll_state.etag);
+    } else {
+        esp_http_client_delete_header(client, "If-None-Match");
+    }
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_http_client_perform(client);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Connection Failed: %s", esp_err_to_name(err));
+        esp_http_client_close(client); // Reconnect on the next check
+        return OTA_POLL_FAILED;
+    }
+
+    int status_code = esp_http_client_get_status_code(client);
+    ESP_LOGI(TAG, "Manifest check: HTTP %d in %lld ms, %lu body bytes", status_code,
+             (long long)(esp_timer_get_time() - start) / 1000, (unsigned long)check->manifest.bytes);
+
+    if (status_code == 304) {
+        return OTA_POLL_UNCHANGED;
+    }
+    if (status_code == 404) {
+        ESP_LOGE(TAG, "404 Error: File not found."); 
+        ESP_LOGE(TAG, "Likely Cause: Token invalid, expired, or wrong Repo URL.");
+        return OTA_POLL_FAILED;
+    }
+    if (status_code != 200) {
+        ESP_LOGE(TAG, "HTTP Error %d", status_code);
+        return OTA_POLL_FAILED;
+    }
+    if (!ota_manifest_ok(&check->manifest)) {
+        ESP_LOGE(TAG, "Failed to parse manifest (%s)", check->manifest.truncated ? "value too long" : "bad JSON");
+        return OTA_POLL_FAILED;
+    }
+
+    ota_poll_result_t result = ota_poll_manifest(&poll_state, &check->manifest, check->etag);
+    if (atof(check->manifest.version) > CURRENT_VERSION) {
+        ESP_LOGW(TAG, "New version: %s (Current: %.2f)", check->manifest.version, CURRENT_VERSION);
+        // A patch only applies to the exact image it was made from, which
+        // it checks by hash; anything short of a verified image falls back
+        if (check->manifest.patch_url[0] && atof(check->manifest.patch_from) == CURRENT_VERSION) {
+            run_delta_update(check->manifest.patch_url);
+            ESP_LOGW(TAG, "Falling back to the full image");
+        }
+        run_ota_update(check->manifest.url);
+    } else {
+        ESP_LOGI(TAG, "Up to date. Cloud version: %s", check->manifest.version);
+    }
+    return result;
+}
+
 void ota_task(void *pvParam) {
-  
-    char *local_response_buffer = calloc(1, 2048);
-    
+    static ota_check_t check;
+
+    // One client for the whole wake: TLS session and socket stay open
+    // between checks
+    esp_http_client_config_t config = {
+        .url = GITHUB_JSON_URL,
+        .method = HTTP_METHOD_GET,
+        .event_handler = _http_event_handler,
+        .user_data = &check,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .disable_auto_redirect = true,
+        .keep_alive_enable = true,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    esp_http_client_set_header(client, "Authorization", GITHUB_PAT);
+    esp_http_client_set_header(client, "Cache-Control", "no-cache");
+
+    ota_poll_wake(&poll_state);
+    uint32_t delay_ms = OTA_POLL_MIN_MS; // WiFi and MQTT come up first
+
     while(1) {
-        vTaskDelay(pdMS_TO_TICKS(1 * 10 * 1000)); // Check every 60s for testing
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
         ESP_LOGI(TAG, "Checking for updates...");
-        
-        esp_http_client_config_t config = {
-            .url = GITHUB_JSON_URL,
-            .method = HTTP_METHOD_GET,
-            .event_handler = _http_event_handler,
-            .user_data = local_response_buffer,
-            .crt_bundle_attach = esp_crt_bundle_attach,
-            .disable_auto_redirect = true,
-        };
-        
-        esp_http_client_handle_t client = esp_http_client_init(&config);
-        
-        // This sends the token correctly
-        esp_http_client_set_header(client, "Authorization", GITHUB_PAT);
-        esp_http_client_set_header(client, "Cache-Control", "no-cache");
-        esp_http_client_set_header(client, "Pragma", "no-cache");
-        esp_err_t err = esp_http_client_perform(client);
-        
-        if (err == ESP_OK) {
-            // Get the actual HTTP Code (e.g., 200, 404, 401)
-            int status_code = esp_http_client_get_status_code(client);
-            
-            if (status_code == 200) {
-                ESP_LOGI(TAG, "JSON Received: %s", local_response_buffer);
-                cJSON *json = cJSON_Parse(local_response_buffer);
-                if (json) {
-                    cJSON *ver = cJSON_GetObjectItem(json, "version");
-                    cJSON *url = cJSON_GetObjectItem(json, "update_file_url");
-                    if (cJSON_IsString(ver) && cJSON_IsString(url)) {
-                        if (atof(ver->valuestring) > CURRENT_VERSION) {
-                            ESP_LOGW(TAG, "New version: %s (Current: %.2f)", ver->valuestring, CURRENT_VERSION);
-                            run_ota_update(url->valuestring);
-                        } else {
-                            ESP_LOGI(TAG, "Up to date. Cloud version: %s", ver->valuestring);
-                        }
-                    }
-                    cJSON_Delete(json);
-                } else {
-                    ESP_LOGE(TAG, "Failed to parse JSON. Content: %s", local_response_buffer);
-                }
-            } 
-            else if (status_code == 404) {
-                ESP_LOGE(TAG, "404 Error: File not found."); 
-                ESP_LOGE(TAG, "Likely Cause: Token invalid, expired, or wrong Repo URL.");
-                ESP_LOGE(TAG, "Server Message: %s", local_response_buffer);
-            }
-            else {
-                ESP_LOGE(TAG, "HTTP Error %d. Response: %s", status_code, local_response_buffer);
-            }
-        } else {
-            ESP_LOGE(TAG, "Connection Failed: %s", esp_err_to_name(err));
-        }
-        
-        esp_http_client_cleanup(client);
-        // Clear buffer for next loop
-        memset(local_response_buffer, 0, 2048);
+        ota_poll_result_t result = check_manifest(client, &check);
+        delay_ms = ota_poll_next(&poll_state, result, esp_random());
+        ESP_LOGI(TAG, "Next check in %lu s", (unsigned long)delay_ms / 1000);
     }
-    free(local_response_buffer);
-}
\ No newline at end of file
+}
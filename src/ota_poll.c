@@ -0,0 +1,222 @@
+#include "ota_poll.h"
+#include <string.h>
+
+enum { CAPTURE_NONE, CAPTURE_KEY, CAPTURE_VERSION, CAPTURE_URL, CAPTURE_PATCH_FROM, CAPTURE_PATCH_URL };
+
+void ota_manifest_init(ota_manifest_t *m) {
+    memset(m, 0, sizeof(*m));
+}
+
+// Value buffer a capture target fills
+static char *field_of(ota_manifest_t *m, uint8_t capture, size_t *cap) {
+    switch (capture) {
+    case CAPTURE_VERSION:    *cap = sizeof(m->version); return m->version;
+    case CAPTURE_URL:        *cap = sizeof(m->url); return m->url;
+    case CAPTURE_PATCH_FROM: *cap = sizeof(m->patch_from); return m->patch_from;
+    case CAPTURE_PATCH_URL:  *cap = sizeof(m->patch_url); return m->patch_url;
+    default:                 *cap = 0; return NULL;
+    }
+}
+
+static void put(ota_manifest_t *m, char c) {
+    size_t cap;
+
+    if (m->capture == CAPTURE_KEY) {
+        // A key too long to store cannot be one we want
+        if (m->key_len < OTA_KEY_MAX - 1) {
+            m->key[m->key_len++] = c;
+            m->key[m->key_len] = '\0';
+        } else {
+            m->key_len = OTA_KEY_MAX;
+        }
+        return;
+    }
+
+    char *field = field_of(m, m->capture, &cap);
+    if (!field) return;
+    if (m->value_len + 1u < cap) {
+        field[m->value_len++] = c;
+        field[m->value_len] = '\0';
+    } else {
+        m->truncated = true;
+    }
+}
+
+static void begin_value(ota_manifest_t *m) {
+    m->capture = CAPTURE_NONE;
+    if (m->depth != 1) return;
+    if (m->expect_key) {
+        m->capture = CAPTURE_KEY;
+        m->key_len = 0;
+        m->key[0] = '\0';
+    } else if (m->target) {
+        size_t cap;
+        m->capture = m->target;
+        m->value_len = 0;
+        field_of(m, m->target, &cap)[0] = '\0';
+    }
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static void string_char(ota_manifest_t *m, char c) {
+    if (m->unicode_left) {
+        int v = hex_value(c);
+        if (v < 0) {
+            m->error = true;
+            return;
+        }
+        m->unicode = (uint16_t)(m->unicode * 16 + v);
+        if (--m->unicode_left == 0) {
+            put(m, m->unicode < 0x80 ? (char)m->unicode : '?');
+        }
+    } else if (m->escape) {
+        m->escape = false;
+        switch (c) {
+        case 'u': m->unicode_left = 4; m->unicode = 0; break;
+        case 'n': put(m, '\n'); break;
+        case 't': put(m, '\t'); break;
+        case 'r': put(m, '\r'); break;
+        case 'b': put(m, '\b'); break;
+        case 'f': put(m, '\f'); break;
+        default:  put(m, c); break;      // " \ /
+        }
+    } else if (c == '\\') {
+        m->escape = true;
+    } else if (c == '"') {
+        m->in_string = false;
+        m->capture = CAPTURE_NONE;
+    } else {
+        put(m, c);
+    }
+}
+
+static bool literal_char(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           c == '.' || c == '+' || c == '-';
+}
+
+static void structural_char(ota_manifest_t *m, char c) {
+    switch (c) {
+    case ' ': case '\t': case '\r': case '\n':
+        break;
+    case '{':
+    case '[':
+        if (m->depth == 0) {
+            // The manifest is one object
+            if (c != '{' || m->started) {
+                m->error = true;
+                return;
+            }
+            m->started = true;
+        }
+        m->depth++;
+        if (m->depth == 1) m->expect_key = true;
+        break;
+    case '}':
+    case ']':
+        if (m->depth == 0) {
+            m->error = true;
+            return;
+        }
+        if (--m->depth == 0) m->complete = true;
+        break;
+    case ':':
+        if (m->depth == 1) {
+            m->expect_key = false;
+            m->target = CAPTURE_NONE;
+            if (m->key_len < OTA_KEY_MAX) {
+                if (strcmp(m->key, "version") == 0) m->target = CAPTURE_VERSION;
+                if (strcmp(m->key, "update_file_url") == 0) m->target = CAPTURE_URL;
+                if (strcmp(m->key, "patch_from") == 0) m->target = CAPTURE_PATCH_FROM;
+                if (strcmp(m->key, "patch_url") == 0) m->target = CAPTURE_PATCH_URL;
+            }
+        }
+        break;
+    case ',':
+        if (m->depth == 1) {
+            m->expect_key = true;
+            m->target = CAPTURE_NONE;
+        }
+        break;
+    case '"':
+        m->in_string = true;
+        begin_value(m);
+        break;
+    default:
+        if (!literal_char(c) || m->depth == 0) {
+            m->error = true;
+            return;
+        }
+        m->in_literal = true;
+        begin_value(m);
+        put(m, c);
+        break;
+    }
+}
+
+void ota_manifest_feed(ota_manifest_t *m, const char *data, size_t len) {
+    for (size_t i = 0; i < len && !m->error && !m->complete; i++) {
+        char c = data[i];
+        m->bytes++;
+        if (m->in_string) {
+            string_char(m, c);
+            continue;
+        }
+        if (m->in_literal) {
+            if (literal_char(c)) {
+                put(m, c);
+                continue;
+            }
+            m->in_literal = false;
+            m->capture = CAPTURE_NONE;
+        }
+        structural_char(m, c);
+    }
+}
+
+bool ota_manifest_ok(const ota_manifest_t *m) {
+    return m->complete && !m->error && !m->truncated && m->version[0] && m->url[0];
+}
+
+void ota_poll_wake(ota_poll_t *p) {
+    p->interval_ms = OTA_POLL_MIN_MS;
+    p->failures = 0;
+}
+
+ota_poll_result_t ota_poll_manifest(ota_poll_t *p, const ota_manifest_t *m, const char *etag) {
+    size_t len = etag ? strlen(etag) : 0;
+    if (len >= sizeof(p->etag)) len = 0;
+    if (len) memcpy(p->etag, etag, len);
+    p->etag[len] = '\0';
+
+    if (strcmp(p->version, m->version) == 0) return OTA_POLL_UNCHANGED;
+    strcpy(p->version, m->version);
+    return OTA_POLL_CHANGED;
+}
+
+uint32_t ota_poll_next(ota_poll_t *p, ota_poll_result_t result, uint32_t random) {
+    p->checks++;
+    if (p->interval_ms < OTA_POLL_MIN_MS) p->interval_ms = OTA_POLL_MIN_MS;
+
+    if (result == OTA_POLL_CHANGED) {
+        p->interval_ms = OTA_POLL_MIN_MS;
+        p->failures = 0;
+    } else {
+        if (result == OTA_POLL_UNCHANGED) {
+            p->failures = 0;
+        } else {
+            p->failures++;
+        }
+        p->interval_ms = (p->interval_ms >= OTA_CHECK_INTERVAL_MS / 2) ? OTA_CHECK_INTERVAL_MS : p->interval_ms * 2;
+    }
+
+    // Spread devices that woke together so they do not poll in step
+    uint32_t spread = p->interval_ms / 100 * OTA_POLL_JITTER_PCT;
+    return p->interval_ms - spread + (spread ? random % (2 * spread + 1) : 0);
+}
@@ -0,0 +1,294 @@
+#include "outbox.h"
+#include "modbus_crc.h"
+#include "hal.h"
+#include <string.h>
+
+static const char *TAG = "OUTBOX";
+
+#define OUTBOX_MAGIC          0x3158424F  // "OBX1"
+#define SLOTS_PER_SEGMENT     (OUTBOX_SEGMENT_SIZE / OUTBOX_RECORD_SIZE)   // Slot 0 is the header
+#define RECORDS_PER_SEGMENT   (SLOTS_PER_SEGMENT - 1)
+#define FLAGS_OFFSET          28
+#define CRC_OFFSET            30
+#define SEQ_ERASED            0xFFFFFFFF
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seg_seq;
+    uint32_t erase_count;
+    uint32_t first_seq;
+} segment_header_t;
+
+typedef struct {
+    uint32_t seg;
+    uint32_t slot;             // 1 .. RECORDS_PER_SEGMENT
+} cursor_t;
+
+static bool ready = false;
+static uint32_t num_segments;
+static uint32_t newest_seg_seq;
+static uint32_t next_seq;
+static cursor_t write_pos;
+static cursor_t read_pos;
+static cursor_t peek_end;
+static uint32_t read_seq;
+static uint32_t peek_count;
+static uint32_t peek_torn;           // Of peek_count, counted as dropped when consumed
+static outbox_stats_t stats;
+
+static uint32_t rd32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void wr32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+}
+
+static uint32_t slot_offset(uint32_t seg, uint32_t slot) {
+    return seg * OUTBOX_SEGMENT_SIZE + slot * OUTBOX_RECORD_SIZE;
+}
+
+static bool read_header(uint32_t seg, segment_header_t *h) {
+    uint8_t raw[16];
+    if (!hal_outbox_read(slot_offset(seg, 0), raw, sizeof(raw))) return false;
+    h->magic = rd32(&raw[0]);
+    h->seg_seq = rd32(&raw[4]);
+    h->erase_count = rd32(&raw[8]);
+    h->first_seq = rd32(&raw[12]);
+    return h->magic == OUTBOX_MAGIC;
+}
+
+static uint32_t read_slot_seq(uint32_t seg, uint32_t slot) {
+    uint8_t raw[4];
+    if (!hal_outbox_read(slot_offset(seg, slot), raw, sizeof(raw))) return SEQ_ERASED;
+    return rd32(raw);
+}
+
+static bool read_slot_sent(uint32_t seg, uint32_t slot) {
+    uint8_t raw[2];
+    if (!hal_outbox_read(slot_offset(seg, slot) + FLAGS_OFFSET, raw, sizeof(raw))) return false;
+    return raw[0] == 0 && raw[1] == 0;
+}
+
+static uint32_t next_seg(uint32_t seg) {
+    return (seg + 1) % num_segments;
+}
+
+// Written records form a prefix of the segment: first erased slot
+static uint32_t find_write_slot(uint32_t seg) {
+    uint32_t lo = 1, hi = SLOTS_PER_SEGMENT;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (read_slot_seq(seg, mid) == SEQ_ERASED) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+// Sent records form a prefix too: first unsent slot below end
+static uint32_t find_unsent_slot(uint32_t seg, uint32_t end) {
+    uint32_t lo = 1, hi = end;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (read_slot_sent(seg, mid)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static uint32_t segment_end(uint32_t seg) {
+    return seg == write_pos.seg ? write_pos.slot : SLOTS_PER_SEGMENT;
+}
+
+static bool open_segment(uint32_t seg, uint32_t erase_count) {
+    uint8_t raw[16];
+    if (!hal_outbox_erase(slot_offset(seg, 0), OUTBOX_SEGMENT_SIZE)) return false;
+    stats.erases++;
+    wr32(&raw[0], OUTBOX_MAGIC);
+    wr32(&raw[4], ++newest_seg_seq);
+    wr32(&raw[8], erase_count + 1);
+    wr32(&raw[12], next_seq);
+    if (!hal_outbox_write(slot_offset(seg, 0), raw, sizeof(raw))) return false;
+    write_pos.seg = seg;
+    write_pos.slot = 1;
+    return true;
+}
+
+static void set_read_pos(uint32_t seg, uint32_t slot) {
+    segment_header_t h;
+    read_pos.seg = seg;
+    read_pos.slot = slot;
+    read_seq = read_header(seg, &h) ? h.first_seq + slot - 1 : next_seq;
+}
+
+bool outbox_init(void) {
+    uint32_t size = hal_outbox_size();
+    num_segments = size / OUTBOX_SEGMENT_SIZE;
+    ready = false;
+    memset(&stats, 0, sizeof(stats));
+    if (num_segments < 2) {
+        ESP_LOGW(TAG, "No outbox partition");
+        return false;
+    }
+
+    // 1. Newest segment by sequence
+    segment_header_t h;
+    bool found = false;
+    uint32_t newest = 0;
+    newest_seg_seq = 0;
+    for (uint32_t seg = 0; seg < num_segments; seg++) {
+        if (read_header(seg, &h) && (!found || (int32_t)(h.seg_seq - newest_seg_seq) > 0)) {
+            found = true;
+            newest = seg;
+            newest_seg_seq = h.seg_seq;
+        }
+    }
+
+    if (!found) {
+        next_seq = 0;
+        if (!open_segment(0, 0)) return false;
+        read_pos = write_pos;
+        read_seq = next_seq;
+        ready = true;
+        ESP_LOGI(TAG, "Formatted %lu segments", (unsigned long)num_segments);
+        return true;
+    }
+
+    // 2. Write position in the newest segment
+    read_header(newest, &h);
+    write_pos.seg = newest;
+    write_pos.slot = find_write_slot(newest);
+    next_seq = h.first_seq + write_pos.slot - 1;
+
+    // 3. Oldest segment is the first valid one after the newest
+    uint32_t oldest = next_seg(newest);
+    while (oldest != newest && !read_header(oldest, &h)) {
+        oldest = next_seg(oldest);
+    }
+
+    // 4. First unsent record, skipping fully sent segments
+    uint32_t seg = oldest;
+    while (1) {
+        uint32_t end = segment_end(seg);
+        if (end > 1 && !read_slot_sent(seg, end - 1)) {
+            set_read_pos(seg, find_unsent_slot(seg, end));
+            break;
+        }
+        if (seg == newest) {
+            set_read_pos(write_pos.seg, write_pos.slot);
+            break;
+        }
+        seg = next_seg(seg);
+    }
+
+    ready = true;
+    ESP_LOGI(TAG, "Recovered: %lu pending, next seq %lu", (unsigned long)outbox_pending(), (unsigned long)next_seq);
+    return true;
+}
+
+bool outbox_append(const telemetry_sample_t *sample) {
+    if (!ready) return false;
+
+    if (write_pos.slot >= SLOTS_PER_SEGMENT) {
+        uint32_t seg = next_seg(write_pos.seg);
+        segment_header_t h;
+        uint32_t erase_count = read_header(seg, &h) ? h.erase_count : 0;
+
+        // Full: drop the oldest segment and whatever is unsent in it
+        if (read_pos.seg == seg && read_seq != next_seq) {
+            uint32_t lost = SLOTS_PER_SEGMENT - read_pos.slot;
+            stats.dropped += lost;
+            ESP_LOGW(TAG, "Outbox full, dropped %lu records", (unsigned long)lost);
+            uint32_t after = next_seg(seg);
+            set_read_pos(after, find_unsent_slot(after, segment_end(after)));
+            peek_count = 0;
+            peek_torn = 0;
+        }
+        if (!open_segment(seg, erase_count)) return false;
+        if (read_seq == next_seq) {
+            read_pos = write_pos;
+        }
+    }
+
+    uint8_t rec[OUTBOX_RECORD_SIZE];
+    memset(rec, 0xFF, sizeof(rec));
+    wr32(&rec[0], next_seq);
+    wr32(&rec[4], sample->ts_ms);
+    telemetry_serialize(TELEMETRY_FMT_BINARY, sample, &rec[8], TELEMETRY_BIN_LEN);
+    uint16_t crc = modbus_crc16(rec, FLAGS_OFFSET);
+    rec[CRC_OFFSET] = crc & 0xFF;
+    rec[CRC_OFFSET + 1] = crc >> 8;
+
+    if (!hal_outbox_write(slot_offset(write_pos.seg, write_pos.slot), rec, sizeof(rec))) return false;
+    write_pos.slot++;
+    next_seq++;
+    stats.appended++;
+    return true;
+}
+
+static void advance(cursor_t *c) {
+    c->slot++;
+    if (c->slot >= SLOTS_PER_SEGMENT && c->seg != write_pos.seg) {
+        c->seg = next_seg(c->seg);
+        c->slot = 1;
+    }
+}
+
+static bool at_end(const cursor_t *c) {
+    return c->seg == write_pos.seg && c->slot >= write_pos.slot;
+}
+
+int outbox_peek(telemetry_sample_t *out, int max) {
+    if (!ready) return 0;
+
+    cursor_t c = read_pos;
+    int n = 0;
+    peek_count = 0;
+    peek_torn = 0;
+    while (n < max && !at_end(&c)) {
+        uint8_t rec[OUTBOX_RECORD_SIZE];
+        bool ok = hal_outbox_read(slot_offset(c.seg, c.slot), rec, sizeof(rec)) &&
+                  modbus_crc16(rec, FLAGS_OFFSET) == (uint16_t)(rec[CRC_OFFSET] | (rec[CRC_OFFSET + 1] << 8));
+        if (ok) {
+            out[n].ts_ms = rd32(&rec[4]);
+            // The RTC restarts on a power cycle: keep each boot in its own batch
+            if (n > 0 && (int32_t)(out[n].ts_ms - out[n - 1].ts_ms) < 0) break;
+            ok = telemetry_parse_binary(&rec[8], TELEMETRY_BIN_LEN, &out[n]);
+        }
+        if (ok) {
+            n++;
+        } else {
+            peek_torn++; // Torn write, consumed with the rest
+        }
+        peek_count++;
+        advance(&c);
+    }
+    peek_end = c;
+    return n;
+}
+
+void outbox_consume(void) {
+    static const uint8_t sent[2] = { 0x00, 0x00 };
+    stats.dropped += peek_torn;
+    stats.replayed += peek_count - peek_torn;
+    while (peek_count > 0) {
+        hal_outbox_write(slot_offset(read_pos.seg, read_pos.slot) + FLAGS_OFFSET, sent, sizeof(sent));
+        advance(&read_pos);
+        read_seq++;
+        peek_count--;
+    }
+    peek_torn = 0;
+}
+
+uint32_t outbox_pending(void) {
+    return ready ? next_seq - read_seq : 0;
+}
+
+void outbox_get_stats(outbox_stats_t *out) {
+    *out = stats;
+    out->segments = num_segments;
+    out->pending = outbox_pending();
+}
@@ -0,0 +1,122 @@
+#include "overload_guard.h"
+#include <string.h>
+
+// Load as a multiple of rated power, Q8
+static uint64_t ratio_q8(const overload_guard_t *g, uint32_t power_dw) {
+    return (uint64_t)power_dw * 256 / g->cfg.rated_dw;
+}
+
+// Integral growth per ms at this ratio, Q16
+static uint64_t curve_rate(overload_curve_t curve, uint64_t r_q8) {
+    if (r_q8 <= 256) return 0;
+    switch (curve) {
+    case OVERLOAD_CURVE_I2T:     return r_q8 * r_q8 - 65536;
+    case OVERLOAD_CURVE_INVERSE: return (r_q8 - 256) << 8;
+    default:                     return 65536;
+    }
+}
+
+void overload_guard_init(overload_guard_t *g, const overload_config_t *cfg) {
+    memset(g, 0, sizeof(*g));
+    g->cfg = *cfg;
+    if (g->cfg.rated_dw == 0) g->cfg.rated_dw = 1;
+    if (g->cfg.ref_ratio_pct <= 100) g->cfg.ref_ratio_pct = 200;
+    if (g->cfg.reset_ms == 0) g->cfg.reset_ms = 1;
+    g->dropout_dw = cfg->rated_dw - cfg->rated_dw * cfg->hysteresis_pct / 100;
+    g->trip_level = curve_rate(cfg->curve, (uint64_t)g->cfg.ref_ratio_pct * 256 / 100) * cfg->ref_ms;
+    g->state = OVERLOAD_CLOSED;
+}
+
+static void drain(overload_guard_t *g, uint32_t dt) {
+    uint64_t step = g->trip_level * dt / g->cfg.reset_ms;
+    g->integral = (g->integral > step) ? g->integral - step : 0;
+}
+
+static overload_action_t trip(overload_guard_t *g, overload_action_t cause, uint32_t now_ms) {
+    const overload_config_t *c = &g->cfg;
+    uint32_t delay = c->reclose_ms;
+
+    g->trip_ms = now_ms;
+    g->state = OVERLOAD_TRIPPED;
+    if (c->reclose == OVERLOAD_RECLOSE_NEVER) {
+        g->state = OVERLOAD_LOCKOUT;
+    } else if (c->reclose == OVERLOAD_RECLOSE_LIMITED) {
+        // Only trips soon after a reclose count towards lockout
+        bool repeat = g->shots > 0 && now_ms - g->closed_ms <= c->window_ms;
+        g->shots = repeat ? g->shots + 1 : 1;
+        if (g->shots > c->max_shots) {
+            g->state = OVERLOAD_LOCKOUT;
+        }
+        for (uint8_t i = 1; i < g->shots && delay < UINT32_MAX / 2; i++) delay *= 2;
+    }
+    g->reclose_at_ms = now_ms + delay;
+    return cause;
+}
+
+overload_action_t overload_guard_update(overload_guard_t *g, uint32_t power_dw, uint32_t now_ms) {
+    uint32_t dt = g->primed ? now_ms - g->last_ms : 0;
+    g->primed = true;
+    g->last_ms = now_ms;
+
+    switch (g->state) {
+    case OVERLOAD_LOCKOUT:
+        drain(g, dt);
+        return OVERLOAD_NONE;
+
+    case OVERLOAD_TRIPPED:
+        if (power_dw >= g->dropout_dw) return OVERLOAD_NONE;
+        drain(g, dt);
+        if ((int32_t)(now_ms - g->reclose_at_ms) < 0) return OVERLOAD_NONE;
+        g->state = OVERLOAD_CLOSED;
+        g->closed_ms = now_ms;
+        return OVERLOAD_RECLOSE;
+
+    default:
+        break;
+    }
+
+    if (power_dw >= g->cfg.instant_dw) {
+        return trip(g, OVERLOAD_TRIP_INSTANT, now_ms);
+    }
+    if (power_dw > g->cfg.rated_dw) {
+        g->state = OVERLOAD_PICKUP;
+        g->integral += curve_rate(g->cfg.curve, ratio_q8(g, power_dw)) * dt;
+        if (g->integral >= g->trip_level) {
+            return trip(g, OVERLOAD_TRIP_CURVE, now_ms);
+        }
+    } else if (power_dw < g->dropout_dw) {
+        g->state = OVERLOAD_CLOSED;
+        drain(g, dt);
+    }
+    // Between dropout and rated: hold
+    return OVERLOAD_NONE;
+}
+
+bool overload_guard_open(const overload_guard_t *g) {
+    return g->state == OVERLOAD_TRIPPED || g->state == OVERLOAD_LOCKOUT;
+}
+
+void overload_guard_reset(overload_guard_t *g, uint32_t now_ms) {
+    g->state = OVERLOAD_CLOSED;
+    g->integral = 0;
+    g->shots = 0;
+    g->closed_ms = now_ms;
+}
+
+uint32_t overload_guard_trip_ms(const overload_guard_t *g, uint32_t power_dw) {
+    if (power_dw >= g->cfg.instant_dw) return 0;
+    uint64_t rate = curve_rate(g->cfg.curve, ratio_q8(g, power_dw));
+    if (rate == 0) return UINT32_MAX;
+    uint64_t ms = (g->trip_level + rate - 1) / rate;
+    return ms < UINT32_MAX ? (uint32_t)ms : UINT32_MAX;
+}
+
+const char *overload_state_name(overload_state_t state) {
+    switch (state) {
+    case OVERLOAD_CLOSED:  return "closed";
+    case OVERLOAD_PICKUP:  return "pickup";
+    case OVERLOAD_TRIPPED: return "tripped";
+    case OVERLOAD_LOCKOUT: return "lockout";
+    }
+    return "";
+}
@@ -0,0 +1,208 @@
+#include "protection.h"
+#include "pzem_async.h"
+#include "hal.h"
+#include "dlog.h"
+#include <stdatomic.h>
+#include <string.h>
+
+static pzem_async_t link;
+static overload_guard_t guard;
+static grid_anomaly_t grid;
+static protection_event_fn_t event_handler;
+static uint32_t request_ms;           // Send time of the transaction in flight
+static uint32_t next_read_ms;
+static pzem_data_t full;              // Last reading of every register
+static uint32_t full_ms;              // When it was requested
+static bool want_full;
+static bool reading_full;             // Kind of the transaction in flight
+static _Atomic bool tripped = false;
+static _Atomic bool reset_requested = false;
+static protection_stats_t stats;      // Kept across wakes on the host
+RTC_DATA_ATTR static uint16_t alarm_w;   // Threshold the meter is known to hold, W
+
+// Latest reading, seqlock: odd while the fast path writes it
+static _Atomic uint32_t latest_seq;
+static pzem_data_t latest;
+
+static void publish(const pzem_data_t *d) {
+    uint32_t seq = atomic_load_explicit(&latest_seq, memory_order_relaxed);
+    atomic_store_explicit(&latest_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    latest = *d;
+    atomic_store_explicit(&latest_seq, seq + 2, memory_order_release);
+}
+
+void protection_latest(pzem_data_t *out) {
+    uint32_t before, after;
+    do {
+        before = atomic_load_explicit(&latest_seq, memory_order_acquire);
+        *out = latest;
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&latest_seq, memory_order_relaxed);
+    } while (before != after || (before & 1));
+}
+
+bool protection_tripped(void) {
+    return atomic_load(&tripped);
+}
+
+void protection_reset(void) {
+    atomic_store(&reset_requested, true);
+}
+
+// The meter keeps the threshold in EEPROM, so it is written only when it
+// differs, and checked once per power-on rather than on every wake.
+// Blocking, before the fast path takes the UART.
+static void program_alarm(uint32_t rated_dw) {
+    const uint16_t want = rated_dw / PZEM_POWER_SCALE;
+    uint16_t have;
+    if (alarm_w == want) return;
+    if (pzem_read_holding(PZEM_HREG_ALARM_W, 1, &have) != PZEM_OK || have != want) {
+        if (pzem_write_holding(PZEM_HREG_ALARM_W, want) != PZEM_OK) return;
+        stats.alarm_writes++;
+    }
+    alarm_w = want;
+}
+
+void protection_start(const overload_config_t *cfg, const grid_config_t *grid_cfg, const pzem_data_t *seed,
+                      protection_event_fn_t on_event) {
+    program_alarm(cfg->rated_dw);
+    overload_guard_init(&guard, cfg);
+    grid_anomaly_init(&grid, grid_cfg);
+    event_handler = on_event;
+    pzem_async_init(&link, NULL, NULL);
+    publish(seed);
+    atomic_store(&tripped, false);
+    hal_relay_init();
+    hal_relay_set(1);
+    next_read_ms = hal_millis();
+    full = *seed;
+    full_ms = next_read_ms;
+    want_full = !seed->valid;
+    hal_periodic_create(protection_step, "protection", 3072, PROTECTION_PRIORITY, 1);
+}
+
+static void record_actuation(uint32_t now_ms) {
+    uint32_t ms = now_ms - request_ms;
+    uint32_t bucket = ms / PROTECTION_HIST_STEP_MS;
+    stats.latency_hist[bucket < PROTECTION_HIST_BUCKETS ? bucket : PROTECTION_HIST_BUCKETS - 1]++;
+    stats.latency_sum_ms += ms;
+    if (ms > stats.latency_max_ms) stats.latency_max_ms = ms;
+    stats.actuations++;
+}
+
+static void on_sample(const pzem_data_t *d, bool is_full, uint32_t now_ms) {
+    overload_action_t action = overload_guard_update(&guard, d->power_dw, now_ms);
+    grid_event_t event;
+    bool fired = grid_anomaly_update(&grid, d, now_ms, &event);
+    bool open = overload_guard_open(&guard) || grid_anomaly_open(&grid);
+
+    // Relay first, bookkeeping and logging after
+    if (open != atomic_load(&tripped)) {
+        hal_relay_set(open ? 0 : 1);
+        atomic_store(&tripped, open);
+        record_actuation(hal_millis());
+        if (open && !overload_guard_open(&guard)) stats.grid_trips++;
+    }
+    if (is_full) publish(d);
+
+    if (fired) {
+        stats.grid_events[event.type]++;
+        DLOG(DLOG_GRID_EVENT, DLOG_STR(grid_event_name(event.type)), DLOG_STR(grid_severity_name(event.severity)),
+             event.voltage_dv, event.dv, event.dp, event.df);
+        if (event_handler) event_handler(&event);
+    }
+
+    switch (action) {
+    case OVERLOAD_TRIP_INSTANT:
+    case OVERLOAD_TRIP_CURVE:
+        if (action == OVERLOAD_TRIP_INSTANT) {
+            stats.trips_instant++;
+        } else {
+            stats.trips_curve++;
+        }
+        if (guard.state == OVERLOAD_LOCKOUT) stats.lockouts++;
+        DLOG(DLOG_OVERLOAD_TRIP, d->power_dw, DLOG_STR(action == OVERLOAD_TRIP_INSTANT ? "instantaneous" : "curve"),
+             DLOG_STR(guard.state == OVERLOAD_LOCKOUT ? ", locked out" : ""));
+        break;
+    case OVERLOAD_RECLOSE:
+        stats.recloses++;
+        DLOG(DLOG_OVERLOAD_RECLOSE);
+        break;
+    default:
+        break;
+    }
+}
+
+uint32_t protection_step(uint32_t now_ms) {
+    pzem_status_t status;
+    pzem_data_t d;
+
+    if (atomic_exchange(&reset_requested, false)) {
+        overload_guard_reset(&guard, now_ms);
+        if (!grid_anomaly_open(&grid)) {
+            hal_relay_set(1);
+            atomic_store(&tripped, false);
+        }
+    }
+
+    pzem_async_poll(&link, now_ms);
+    if (pzem_async_result(&link, &status, &d)) {
+        stats.samples++;
+        if (status != PZEM_OK) {
+            stats.failed_reads++;
+            want_full |= reading_full;
+            publish(&d);
+        } else if (reading_full) {
+            stats.full_reads++;
+            full = d;
+            on_sample(&d, true, hal_millis());
+        } else {
+            // A new measurement: fetch the rest of it right away, the
+            // sensor task is waiting for it
+            if (d.voltage_dv != full.voltage_dv || d.current_ma != full.current_ma || d.power_dw != full.power_dw) {
+                want_full = true;
+                next_read_ms = now_ms;
+            }
+            pzem_data_t merged = full;
+            merged.voltage_dv = d.voltage_dv;
+            merged.current_ma = d.current_ma;
+            merged.power_dw = d.power_dw;
+            on_sample(&merged, false, hal_millis());
+        }
+    }
+
+    if (!pzem_async_busy(&link) && (int32_t)(now_ms - next_read_ms) >= 0) {
+        request_ms = now_ms;
+        next_read_ms = now_ms + PROTECTION_PERIOD_MS;
+        reading_full = want_full || !full.valid || now_ms - full_ms >= PROTECTION_FULL_MS;
+        if (reading_full) {
+            want_full = false;
+            full_ms = now_ms;
+        }
+        pzem_async_issue_request(&link, pzem_get_address(), reading_full ? &PZEM_READ_ALL : &PZEM_READ_VIP, now_ms);
+    }
+
+    if (pzem_async_busy(&link)) {
+        return pzem_async_wait_ms(&link, hal_millis());
+    }
+    int32_t until_read = (int32_t)(next_read_ms - hal_millis());
+    return until_read > 0 ? (uint32_t)until_read : 0;
+}
+
+void protection_get_stats(protection_stats_t *out) {
+    *out = stats;
+}
+
+uint32_t protection_latency_percentile(const protection_stats_t *s, uint32_t percent) {
+    uint64_t seen = 0, target = ((uint64_t)s->actuations * percent + 99) / 100;
+    if (s->actuations == 0) return 0;
+    for (int i = 0; i < PROTECTION_HIST_BUCKETS - 1; i++) {
+        seen += s->latency_hist[i];
+        if (seen >= target) {
+            uint32_t edge = (i + 1) * PROTECTION_HIST_STEP_MS;
+            return edge < s->latency_max_ms ? edge : s->latency_max_ms;
+        }
+    }
+    return s->latency_max_ms;
+}
@@ -0,0 +1,268 @@
+#include "pzem_async.h"
+#include "modbus_crc.h"
+#include "metrics.h"
+#include "dlog.h"
+#include "hal.h"
+#include <string.h>
+
+// Request and a reply of len on the wire. 8N1: 10 bits per byte, rounded
+// down so no genuine reply is called late.
+static uint32_t wire_ms(const pzem_async_t *a, int len) {
+    return (uint32_t)(a->request_len + len) * 10 * 1000 / PZEM_BAUD_RATE;
+}
+
+static void set_request(pzem_async_t *a, uint8_t addr, const pzem_request_t *req) {
+    a->addr = addr;
+    a->req = *req;
+    a->request_len = (uint8_t)pzem_build_request(addr, req, a->request);
+    a->reply_len = (uint8_t)pzem_reply_len(req);
+    a->min_reply_ms = wire_ms(a, a->reply_len);
+}
+
+void pzem_async_init(pzem_async_t *a, pzem_async_cb_t cb, void *user) {
+    memset(a, 0, sizeof(*a));
+    a->cb = cb;
+    a->user = user;
+    a->timeout_ms = PZEM_ASYNC_TIMEOUT_MS;
+    set_request(a, PZEM_DEFAULT_ADDR, &PZEM_READ_ALL);
+    a->stats.latency_min_ms = UINT32_MAX;
+}
+
+static void send_attempt(pzem_async_t *a, uint32_t now_ms) {
+    a->state = PZEM_ASYNC_WAITING;
+    a->sent_ms = now_ms;
+    a->last_error = PZEM_ERR_TIMEOUT;
+    if (a->unanswered < UINT8_MAX) a->unanswered++;
+    hal_uart_write(a->request, a->request_len);
+}
+
+bool pzem_async_issue_request(pzem_async_t *a, uint8_t addr, const pzem_request_t *req, uint32_t now_ms) {
+    if (pzem_async_busy(a)) return false;
+
+    if (addr != a->addr || req->function != a->req.function || req->reg != a->req.reg ||
+        req->value != a->req.value) {
+        set_request(a, addr, req);
+    }
+    a->attempts_left = PZEM_ASYNC_RETRIES;
+    a->issued_ms = now_ms;
+    a->stats.issued++;
+    if (a->unanswered > 0 && now_ms - a->sent_ms < a->timeout_ms) {
+        a->state = PZEM_ASYNC_HOLDOFF;
+        a->stats.holdoffs++;
+    } else {
+        a->unanswered = 0;
+        send_attempt(a, now_ms);
+    }
+    return true;
+}
+
+bool pzem_async_issue(pzem_async_t *a, uint8_t addr, uint32_t now_ms) {
+    return pzem_async_issue_request(a, addr, &PZEM_READ_ALL, now_ms);
+}
+
+static void record_latency(pzem_async_stats_t *s, uint32_t ms) {
+    uint32_t bucket = ms / PZEM_ASYNC_HIST_STEP_MS;
+    s->latency_hist[bucket < PZEM_ASYNC_HIST_BUCKETS ? bucket : PZEM_ASYNC_HIST_BUCKETS - 1]++;
+    if (ms < s->latency_min_ms) s->latency_min_ms = ms;
+    if (ms > s->latency_max_ms) s->latency_max_ms = ms;
+    s->latency_sum_ms += ms;
+}
+
+static void complete(pzem_async_t *a, pzem_status_t status, uint32_t now_ms) {
+    a->status = status;
+    if (status == PZEM_OK) {
+        a->stats.ok++;
+        record_latency(&a->stats, now_ms - a->issued_ms);
+        if (a->req.function == PZEM_CMD_READ_INPUT) metrics_inc(METRIC_PZEM_SAMPLES);
+        metrics_observe_us(METRIC_UART_TRANSACTION, (now_ms - a->issued_ms) * 1000);
+    } else if (status == PZEM_ERR_EXCEPTION) {
+        a->stats.exceptions++;
+        a->data.valid = false;
+        a->data.slave = a->reply.slave;
+        DLOG(DLOG_PZEM_EXCEPTION, a->req.function, a->reply.slave, a->reply.exception);
+    } else {
+        a->stats.failed++;
+        metrics_inc(METRIC_PZEM_READ_FAILURES);
+        a->data.valid = false;
+        a->data.slave = a->addr;
+        DLOG(DLOG_PZEM_NO_REPLY, a->addr, status);
+    }
+
+    // Idle before the callback so it can issue the next transaction
+    if (a->cb) {
+        a->state = PZEM_ASYNC_IDLE;
+        a->cb(a->user, status, &a->data);
+    } else {
+        a->state = PZEM_ASYNC_DONE;
+    }
+}
+
+static bool could_start_frame(const pzem_async_t *a, uint8_t b) {
+    // On the general address the reply may carry the meter's own address
+    if (a->addr == PZEM_DEFAULT_ADDR) return b != 0 && b <= PZEM_DEFAULT_ADDR;
+    return b == a->addr;
+}
+
+static void drop(pzem_async_t *a, int n) {
+    a->rx_len -= n;
+    memmove(a->rx, a->rx + n, a->rx_len);
+}
+
+static bool is_exception(const pzem_async_t *a) {
+    return a->rx_len > 1 && a->rx[1] == (a->req.function | PZEM_CMD_EXCEPTION);
+}
+
+// The header bytes received so far fit a reply to the request in flight
+static bool plausible(const pzem_async_t *a) {
+    if (a->rx_len < 2 || is_exception(a)) return true;
+    if (a->rx[1] != a->req.function) return false;
+    if (a->rx_len < 3) return true;
+    switch (a->req.function) {
+    case PZEM_CMD_READ_INPUT:
+    case PZEM_CMD_READ_HOLDING:
+        return a->rx[2] == a->reply_len - 5;
+    case PZEM_CMD_WRITE_SINGLE:
+        return a->rx[2] == a->request[2];
+    default:
+        return true;
+    }
+}
+
+static void take_reply(pzem_async_t *a) {
+    memset(&a->data, 0, sizeof(a->data));
+    a->data.slave = a->reply.slave;
+    if (a->req.function == PZEM_CMD_READ_INPUT) {
+        pzem_regs_to_data(a->req.reg, a->req.value, a->reply.regs, &a->data);
+        a->data.valid = true;
+    }
+}
+
+// Consumes every complete frame and all noise in rx, leaves a partial frame
+static void scan(pzem_async_t *a, uint32_t now_ms) {
+    while (a->rx_len > 0) {
+        if (!could_start_frame(a, a->rx[0])) {
+            a->stats.noise_bytes++;
+            drop(a, 1);
+            continue;
+        }
+        if (!plausible(a)) {
+            a->stats.resyncs++;
+            drop(a, 1);
+            continue;
+        }
+        const bool exception = is_exception(a);
+        const int len = exception ? PZEM_EXCEPTION_LEN : a->reply_len;
+        if (a->rx_len < len) return;
+
+        // A corrupted reply still answers an attempt
+        if (a->unanswered > 0) a->unanswered--;
+        if (!modbus_crc_check(a->rx, len)) {
+            a->stats.crc_errors++;
+            metrics_inc(METRIC_PZEM_CRC_ERRORS);
+            a->stats.resyncs++;
+            a->last_error = PZEM_ERR_CRC;
+            drop(a, 1);
+            continue;
+        }
+
+        pzem_status_t status = PZEM_ERR_FRAME;
+        if (a->state != PZEM_ASYNC_WAITING || now_ms - a->sent_ms < wire_ms(a, len)) {
+            a->stats.late++;
+        } else {
+            status = pzem_parse_response(a->addr, &a->req, a->rx, len, &a->reply);
+        }
+        drop(a, len);
+        if (status == PZEM_OK) {
+            take_reply(a);
+            complete(a, PZEM_OK, now_ms);
+        } else if (status == PZEM_ERR_EXCEPTION) {
+            complete(a, PZEM_ERR_EXCEPTION, now_ms);
+        }
+    }
+}
+
+void pzem_async_feed(pzem_async_t *a, const uint8_t *bytes, int len, uint32_t now_ms) {
+    while (len > 0) {
+        // scan leaves less than one frame, so there is always room
+        int n = (int)sizeof(a->rx) - a->rx_len;
+        if (n > len) n = len;
+        memcpy(a->rx + a->rx_len, bytes, n);
+        a->rx_len += n;
+        bytes += n;
+        len -= n;
+        scan(a, now_ms);
+    }
+}
+
+void pzem_async_poll(pzem_async_t *a, uint32_t now_ms) {
+    // Drain even when idle so late replies do not pile up
+    for (;;) {
+        int n = hal_uart_read(a->rx + a->rx_len, sizeof(a->rx) - a->rx_len, 0);
+        if (n <= 0) break;
+        a->rx_len += n;
+        scan(a, now_ms);
+    }
+    if (a->state == PZEM_ASYNC_HOLDOFF) {
+        // Every earlier attempt answered or overdue
+        if (a->unanswered > 0 && now_ms - a->sent_ms < a->timeout_ms) return;
+        a->unanswered = 0;
+        send_attempt(a, now_ms);
+        return;
+    }
+    if (a->state != PZEM_ASYNC_WAITING) return;
+
+    // A corrupted reply is not worth waiting out the timeout for
+    bool expired = now_ms - a->sent_ms >= a->timeout_ms;
+    if (!expired && a->last_error != PZEM_ERR_CRC) return;
+
+    pzem_status_t error = a->last_error;
+    if (expired) {
+        a->stats.timeouts++;
+        if (error == PZEM_ERR_TIMEOUT && a->rx_len > 0) error = PZEM_ERR_SHORT;
+    }
+    if (a->attempts_left > 0) {
+        a->attempts_left--;
+        a->stats.retries++;
+        send_attempt(a, now_ms);
+    } else {
+        complete(a, error, now_ms);
+    }
+}
+
+bool pzem_async_busy(const pzem_async_t *a) {
+    return a->state == PZEM_ASYNC_WAITING || a->state == PZEM_ASYNC_HOLDOFF;
+}
+
+uint32_t pzem_async_wait_ms(const pzem_async_t *a, uint32_t now_ms) {
+    uint32_t since = now_ms - a->sent_ms;
+    if (!pzem_async_busy(a)) return 0;
+    if (since >= a->timeout_ms) return 0;
+    // Nothing complete can arrive before the wire time, in HOLDOFF the
+    // earlier replies may come any time
+    if (a->state == PZEM_ASYNC_WAITING && since < a->min_reply_ms) return a->min_reply_ms - since;
+    return 1;
+}
+
+bool pzem_async_result(pzem_async_t *a, pzem_status_t *status, pzem_data_t *out) {
+    if (a->state != PZEM_ASYNC_DONE) return false;
+    a->state = PZEM_ASYNC_IDLE;
+    if (status) *status = a->status;
+    if (out) *out = a->data;
+    return true;
+}
+
+uint32_t pzem_async_latency_percentile(const pzem_async_stats_t *stats, uint32_t percent) {
+    uint64_t total = 0, seen = 0;
+    for (int i = 0; i < PZEM_ASYNC_HIST_BUCKETS; i++) total += stats->latency_hist[i];
+    if (total == 0) return 0;
+
+    uint64_t target = (total * percent + 99) / 100;
+    for (int i = 0; i < PZEM_ASYNC_HIST_BUCKETS - 1; i++) {
+        seen += stats->latency_hist[i];
+        if (seen >= target) {
+            uint32_t edge = (i + 1) * PZEM_ASYNC_HIST_STEP_MS;
+            return edge < stats->latency_max_ms ? edge : stats->latency_max_ms;
+        }
+    }
+    return stats->latency_max_ms;
+}
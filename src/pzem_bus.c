@@ -0,0 +1,128 @@
+#include "pzem_bus.h"
+#include "modbus_crc.h"
+#include "hal.h"
+#include <string.h>
+
+static const char *TAG = "PZEM_BUS";
+
+// 8N1: 10 bits per byte
+static uint32_t wire_ms(const pzem_bus_t *bus, uint32_t bytes) {
+    return (bytes * 10 * 1000 + bus->baud - 1) / bus->baud;
+}
+
+void pzem_bus_init(pzem_bus_t *bus, pzem_slave_t *slaves, int count, pzem_bus_schedule_t schedule) {
+    memset(bus, 0, sizeof(*bus));
+    bus->slaves = slaves;
+    bus->count = count;
+    bus->schedule = schedule;
+    bus->baud = PZEM_BAUD_RATE;
+    // Request and reply on the wire plus the meter's turnaround
+    bus->timeout_ms = wire_ms(bus, PZEM_REQUEST_LEN + PZEM_RESPONSE_LEN) + PZEM_BUS_SLAVE_LATENCY_MS;
+    bus->gap_ms = (35 * 1000 + bus->baud - 1) / bus->baud;   // 3.5 characters
+
+    for (int i = 0; i < count; i++) {
+        pzem_slave_t *s = &slaves[i];
+        uint8_t addr = s->addr, weight = s->weight ? s->weight : 1;
+        memset(s, 0, sizeof(*s));
+        s->addr = addr;
+        s->weight = weight;
+        pzem_build_read_request(addr, s->request);
+        bus->total_weight += weight;
+    }
+
+    modbus_crc_init();
+    hal_uart_init(bus->baud);
+    ESP_LOGI(TAG, "%d slaves, timeout %lu ms", count, (unsigned long)bus->timeout_ms);
+}
+
+// Offline slaves only get every PZEM_BUS_PROBE_INTERVAL-th of their turns
+static bool take_turn(pzem_slave_t *s) {
+    if (s->state != PZEM_SLAVE_OFFLINE) return true;
+    if (++s->skipped < PZEM_BUS_PROBE_INTERVAL) return false;
+    s->skipped = 0;
+    return true;
+}
+
+static pzem_slave_t *next_round_robin(pzem_bus_t *bus) {
+    // Bounded: after count * PROBE_INTERVAL turns every slave is due
+    for (int tries = 0; tries < bus->count * PZEM_BUS_PROBE_INTERVAL; tries++) {
+        pzem_slave_t *s = &bus->slaves[bus->next];
+        bus->next = (bus->next + 1) % bus->count;
+        if (take_turn(s)) return s;
+    }
+    return &bus->slaves[bus->next];
+}
+
+static pzem_slave_t *next_weighted(pzem_bus_t *bus) {
+    for (int tries = 0; tries < bus->total_weight * PZEM_BUS_PROBE_INTERVAL; tries++) {
+        pzem_slave_t *best = NULL;
+        for (int i = 0; i < bus->count; i++) {
+            pzem_slave_t *s = &bus->slaves[i];
+            s->credit += s->weight;
+            if (!best || s->credit > best->credit) best = s;
+        }
+        best->credit -= bus->total_weight;
+        if (take_turn(best)) return best;
+    }
+    return &bus->slaves[0];
+}
+
+static void record(pzem_bus_t *bus, pzem_slave_t *s, pzem_status_t status, int len) {
+    bus->transactions++;
+    bus->wire_bits += (uint64_t)(PZEM_REQUEST_LEN + (len > 0 ? len : 0)) * 10;
+    s->polls++;
+
+    switch (status) {
+    case PZEM_OK:          s->ok++; bus->ok++; break;
+    case PZEM_ERR_TIMEOUT: s->timeouts++; break;
+    case PZEM_ERR_SHORT:   s->short_replies++; break;
+    case PZEM_ERR_FRAME:
+    case PZEM_ERR_EXCEPTION: s->bad_frames++; break;
+    case PZEM_ERR_CRC:     s->crc_errors++; break;
+    }
+
+    if (status == PZEM_OK) {
+        if (s->state == PZEM_SLAVE_OFFLINE) {
+            ESP_LOGI(TAG, "Slave 0x%02X back online", s->addr);
+        }
+        s->state = PZEM_SLAVE_ONLINE;
+        s->failures = 0;
+        s->last_ok_ms = hal_millis();
+    } else if (s->failures < UINT8_MAX) {
+        s->failures++;
+        if (s->failures >= PZEM_BUS_OFFLINE_AFTER) {
+            if (s->state != PZEM_SLAVE_OFFLINE) {
+                ESP_LOGW(TAG, "Slave 0x%02X offline after %u failures", s->addr, s->failures);
+            }
+            s->state = PZEM_SLAVE_OFFLINE;
+        } else {
+            s->state = PZEM_SLAVE_SUSPECT;
+        }
+    }
+}
+
+pzem_slave_t *pzem_bus_poll(pzem_bus_t *bus, pzem_data_t *out) {
+    if (bus->count == 0) return NULL;
+    pzem_slave_t *s = (bus->schedule == PZEM_BUS_WEIGHTED) ? next_weighted(bus) : next_round_robin(bus);
+    uint8_t reply[PZEM_RESPONSE_LEN];
+
+    hal_uart_flush_input();   // Late replies from the last timeout
+    hal_uart_write(s->request, PZEM_REQUEST_LEN);
+    int len = hal_uart_read(reply, PZEM_RESPONSE_LEN, bus->timeout_ms);
+
+    pzem_status_t status = pzem_parse_reply(s->addr, reply, len, out);
+    out->slave = s->addr;
+    record(bus, s, status, len);
+    if (status == PZEM_OK) {
+        s->last = *out;
+    }
+
+    hal_delay_ms(bus->gap_ms);
+    return s;
+}
+
+uint32_t pzem_bus_utilisation(const pzem_bus_t *bus, uint32_t elapsed_ms) {
+    if (elapsed_ms == 0) return 0;
+    uint64_t busy_ms = bus->wire_bits * 1000 / bus->baud;
+    return (uint32_t)(busy_ms * 100 / elapsed_ms);
+}
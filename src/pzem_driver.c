@@ -1,81 +1,205 @@
 #include "pzem_driver.h"
+#include "pzem_async.h"
+#include "modbus_crc.h"
+#include "hal.h"
+#include "dlog.h"
 #include <string.h>
-#include "esp_log.h"
-#include <math.h>
 
 static const char *TAG = "PZEM_DRIVER";
-#define BUF_SIZE 128
-
-// Internal CRC Helper
-static uint16_t calculate_crc(const uint8_t *data, uint16_t len) {
-    uint16_t crc = 0xFFFF;
-    for (int pos = 0; pos < len; pos++) {
-        crc ^= (uint16_t)data[pos];
-        for (int i = 8; i != 0; i--) {
-            if ((crc & 0x0001) != 0) crc = (crc >> 1) ^ 0xA001;
-            else crc >>= 1;
-        }
+
+_Static_assert(PZEM_RESPONSE_LEN == 5 + PZEM_INPUT_REGS * 2, "Reply carries all registers");
+
+static uint8_t pzem_address = PZEM_DEFAULT_ADDR;
+static pzem_async_t link;
+
+static inline uint32_t be16(const uint8_t *p) {
+    return ((uint32_t)p[0] << 8) | p[1];
+}
+
+// 32-bit values are sent low word first
+static inline uint32_t word32(const uint16_t *r) {
+    return r[0] | ((uint32_t)r[1] << 16);
+}
+
+static inline bool is_read(uint8_t function) {
+    return function == PZEM_CMD_READ_INPUT || function == PZEM_CMD_READ_HOLDING;
+}
+
+int pzem_request_len(const pzem_request_t *req) {
+    return req->function == PZEM_CMD_RESET_ENERGY ? 4 : PZEM_REQUEST_LEN;
+}
+
+// Reads: addr, function, byte count, registers, CRC. A write and an
+// energy reset are echoed.
+int pzem_reply_len(const pzem_request_t *req) {
+    return is_read(req->function) ? 5 + req->value * 2 : pzem_request_len(req);
+}
+
+int pzem_build_request(uint8_t addr, const pzem_request_t *req, uint8_t request[PZEM_REQUEST_LEN]) {
+    request[0] = addr;
+    request[1] = req->function;
+    if (req->function == PZEM_CMD_RESET_ENERGY) {
+        modbus_crc_append(request, 2);
+        return 4;
     }
-    return crc;
+    request[2] = req->reg >> 8;             // Start register
+    request[3] = req->reg & 0xFF;
+    request[4] = req->value >> 8;           // Register count, or the value written
+    request[5] = req->value & 0xFF;
+    modbus_crc_append(request, 6);
+    return PZEM_REQUEST_LEN;
 }
 
-static float roundto4(float value)
-{
-    return roundf(value * 10000.0f) / 10000.0f;
+void pzem_build_read_request(uint8_t addr, uint8_t request[PZEM_REQUEST_LEN]) {
+    pzem_build_request(addr, &PZEM_READ_ALL, request);
 }
 
 void pzem_init(void) {
-    uart_config_t uart_config = {
-        .baud_rate = 9600,
-        .data_bits = UART_DATA_8_BITS,
-        .parity    = UART_PARITY_DISABLE,
-        .stop_bits = UART_STOP_BITS_1,
-        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
-        .source_clk = UART_SCLK_DEFAULT,
-    };
-    ESP_ERROR_CHECK(uart_driver_install(UART_PORT_NUM, BUF_SIZE * 2, 0, 0, NULL, 0));
-    ESP_ERROR_CHECK(uart_param_config(UART_PORT_NUM, &uart_config));
-    ESP_ERROR_CHECK(uart_set_pin(UART_PORT_NUM, PZEM_TXD_PIN, PZEM_RXD_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+    modbus_crc_init();
+    pzem_async_init(&link, NULL, NULL);
+    hal_uart_init(PZEM_BAUD_RATE);
     ESP_LOGI(TAG, "PZEM UART Initialized");
 }
 
-pzem_data_t pzem_read_registers(void) {
-    pzem_data_t result = {0};
-    result.valid = false;
-
-    uart_flush_input(UART_PORT_NUM);
-    
-    // Modbus Command 0x04 Read 10 Registers
-    uint8_t request[] = {0xF8, 0x04, 0x00, 0x00, 0x00, 0x0A, 0x64, 0x64};
-    uart_write_bytes(UART_PORT_NUM, (const char *)request, 8);
-
-    uint8_t data[32];
-    int len = uart_read_bytes(UART_PORT_NUM, data, 25, pdMS_TO_TICKS(100));
-
-    if (len >= 25) {
-        uint16_t received_crc = (data[24] << 8) | data[23];
-        if (received_crc == calculate_crc(data, 23)) {
-            result.voltage = roundto4(((data[3] << 8) | data[4]) / 10.0);
-            
-            uint32_t c_low = (data[5] << 8) | data[6];
-            uint32_t c_high = (data[7] << 8) | data[8];
-            result.current = roundto4(((c_high << 16) | c_low) / 1000.0);// mA
-            
-            uint32_t p_low = (data[9] << 8) | data[10];
-            uint32_t p_high = (data[11] << 8) | data[12];
-            result.power = roundto4(((p_high << 16) | p_low) / 10.0);
-            
-            uint32_t e_low = (data[13] << 8) | data[14];
-            uint32_t e_high = (data[15] << 8) | data[16];
-            result.energy = roundto4(((e_high << 16) | e_low)/ 1000.0);
-            
-            result.frequency = ((data[17] << 8) | data[18]) / 10.0;
-            result.pf = roundto4(((data[19] << 8) | data[20]) / 100.0);
-            
-            result.valid = true;
-        } else {
-            ESP_LOGW(TAG, "CRC Error");
+void pzem_set_address(uint8_t addr) {
+    pzem_address = addr;
+}
+
+uint8_t pzem_get_address(void) {
+    return pzem_address;
+}
+
+pzem_status_t pzem_parse_response(uint8_t addr, const pzem_request_t *req, const uint8_t *frame, int len,
+                                  pzem_reply_t *out) {
+    const int expect = pzem_reply_len(req);
+    const bool exception = len >= 2 && frame[1] == (req->function | PZEM_CMD_EXCEPTION);
+
+    if (len <= 0) return PZEM_ERR_TIMEOUT;
+    if (len < (exception ? PZEM_EXCEPTION_LEN : expect)) return PZEM_ERR_SHORT;
+    // On the general address the meter answers with its own address
+    if (addr != PZEM_DEFAULT_ADDR && frame[0] != addr) return PZEM_ERR_FRAME;
+    if (exception) {
+        if (!modbus_crc_check(frame, PZEM_EXCEPTION_LEN)) return PZEM_ERR_CRC;
+        out->slave = frame[0];
+        out->exception = frame[2];
+        return PZEM_ERR_EXCEPTION;
+    }
+    if (frame[1] != req->function) return PZEM_ERR_FRAME;
+    if (is_read(req->function) && frame[2] != req->value * 2) return PZEM_ERR_FRAME;
+    if (req->function == PZEM_CMD_WRITE_SINGLE && (be16(&frame[2]) != req->reg || be16(&frame[4]) != req->value)) {
+        return PZEM_ERR_FRAME;
+    }
+    if (!modbus_crc_check(frame, expect)) {
+        DLOG(DLOG_PZEM_CRC);
+        return PZEM_ERR_CRC;
+    }
+
+    out->slave = frame[0];
+    out->exception = 0;
+    if (is_read(req->function)) {
+        for (int i = 0; i < req->value; i++) {
+            out->regs[i] = be16(&frame[3 + i * 2]);
         }
+    } else {
+        out->regs[0] = req->value;
+    }
+    return PZEM_OK;
+}
+
+static inline bool covers(uint16_t first, uint16_t count, uint16_t reg, uint16_t n) {
+    return reg >= first && reg + n <= first + count;
+}
+
+void pzem_regs_to_data(uint16_t first, uint16_t count, const uint16_t *regs, pzem_data_t *out) {
+    if (covers(first, count, PZEM_REG_VOLTAGE, 1)) out->voltage_dv = regs[PZEM_REG_VOLTAGE - first];
+    if (covers(first, count, PZEM_REG_CURRENT, 2)) out->current_ma = word32(&regs[PZEM_REG_CURRENT - first]);
+    if (covers(first, count, PZEM_REG_POWER, 2))   out->power_dw   = word32(&regs[PZEM_REG_POWER - first]);
+    if (covers(first, count, PZEM_REG_ENERGY, 2))  out->energy_wh  = word32(&regs[PZEM_REG_ENERGY - first]);
+    if (covers(first, count, PZEM_REG_FREQ, 1))    out->freq_dhz   = regs[PZEM_REG_FREQ - first];
+    if (covers(first, count, PZEM_REG_PF, 1))      out->pf_cent    = regs[PZEM_REG_PF - first];
+    if (covers(first, count, PZEM_REG_ALARM, 1))   out->alarm      = regs[PZEM_REG_ALARM - first] == PZEM_ALARM_ON;
+}
+
+pzem_status_t pzem_parse_reply(uint8_t addr, const uint8_t *frame, int len, pzem_data_t *out) {
+    pzem_reply_t reply;
+    out->valid = false;
+    pzem_status_t status = pzem_parse_response(addr, &PZEM_READ_ALL, frame, len, &reply);
+    if (status != PZEM_OK) return status;
+
+    pzem_regs_to_data(PZEM_REG_VOLTAGE, PZEM_INPUT_REGS, reply.regs, out);
+    out->slave = reply.slave;
+    out->valid = true;
+    return PZEM_OK;
+}
+
+bool pzem_decode_frame(const uint8_t *frame, int len, pzem_data_t *out) {
+    return pzem_parse_reply(pzem_address, frame, len, out) == PZEM_OK;
+}
+
+// Blocking wrapper: the task sleeps between polls instead of sitting in the
+// UART driver, and noise or a late reply no longer costs the reading
+static pzem_status_t transact(const pzem_request_t *req, pzem_data_t *data) {
+    pzem_status_t status;
+
+    pzem_async_issue_request(&link, pzem_address, req, hal_millis());
+    for (;;) {
+        pzem_async_poll(&link, hal_millis());
+        if (pzem_async_result(&link, &status, data)) return status;
+        hal_delay_ms(PZEM_ASYNC_POLL_MS);
     }
+}
+
+pzem_data_t pzem_read_registers(void) {
+    pzem_data_t result = {0};
+    transact(&PZEM_READ_ALL, &result);
     return result;
-}
\ No newline at end of file
+}
+
+static pzem_status_t read_regs(uint8_t function, uint16_t reg, uint16_t count, uint16_t *out) {
+    if (count == 0 || count > PZEM_INPUT_REGS) return PZEM_ERR_FRAME;
+    pzem_status_t status = transact(&(pzem_request_t){ function, reg, count }, NULL);
+    if (status == PZEM_OK) memcpy(out, link.reply.regs, count * sizeof(uint16_t));
+    return status;
+}
+
+pzem_status_t pzem_read_input(uint16_t reg, uint16_t count, uint16_t *out) {
+    return read_regs(PZEM_CMD_READ_INPUT, reg, count, out);
+}
+
+pzem_status_t pzem_read_holding(uint16_t reg, uint16_t count, uint16_t *out) {
+    return read_regs(PZEM_CMD_READ_HOLDING, reg, count, out);
+}
+
+pzem_status_t pzem_write_holding(uint16_t reg, uint16_t value) {
+    return transact(&(pzem_request_t){ PZEM_CMD_WRITE_SINGLE, reg, value }, NULL);
+}
+
+pzem_status_t pzem_reset_energy(void) {
+    return transact(&(pzem_request_t){ PZEM_CMD_RESET_ENERGY, 0, 0 }, NULL);
+}
+
+pzem_status_t pzem_read_power(uint32_t *power_dw) {
+    pzem_data_t d;
+    pzem_status_t status = transact(&PZEM_READ_POWER, &d);
+    if (status == PZEM_OK) *power_dw = d.power_dw;
+    return status;
+}
+
+pzem_status_t pzem_read_alarm(bool *alarm) {
+    pzem_status_t status = transact(&PZEM_READ_ALARM, NULL);
+    if (status == PZEM_OK) *alarm = link.reply.regs[0] == PZEM_ALARM_ON;
+    return status;
+}
+
+pzem_status_t pzem_change_address(uint8_t addr) {
+    pzem_status_t status = pzem_write_holding(PZEM_HREG_ADDRESS, addr);
+    if (status == PZEM_OK) {
+        ESP_LOGI(TAG, "Meter address 0x%02X -> 0x%02X", pzem_address, addr);
+        pzem_address = addr;
+    }
+    return status;
+}
+
+const pzem_async_stats_t *pzem_link_stats(void) {
+    return &link.stats;
+}
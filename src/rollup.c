@@ -0,0 +1,205 @@
+#include "rollup.h"
+#include "hal.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MINUTE_MS 60000
+#define ROLLUP_ITEM_MAX 112
+
+// One spare slot per ring: a reader never gets the slot being rewritten
+RTC_DATA_ATTR static rollup_bucket_t minutes[ROLLUP_MINUTES + 1];
+RTC_DATA_ATTR static rollup_bucket_t hours[ROLLUP_HOURS + 1];
+RTC_DATA_ATTR static rollup_bucket_t open[ROLLUP_LEVELS];
+RTC_DATA_ATTR static _Atomic uint32_t closed[ROLLUP_LEVELS];
+RTC_DATA_ATTR static uint32_t last_energy_wh;
+RTC_DATA_ATTR static bool has_energy;
+
+static rollup_bucket_t *const rings[ROLLUP_LEVELS] = { minutes, hours };
+static const uint32_t depths[ROLLUP_LEVELS] = { ROLLUP_MINUTES + 1, ROLLUP_HOURS + 1 };
+
+static uint16_t add_u16(uint16_t a, uint32_t b) {
+    return a + b > UINT16_MAX ? UINT16_MAX : (uint16_t)(a + b);
+}
+
+static void merge(rollup_bucket_t *dst, const rollup_bucket_t *src) {
+    if (dst->count == 0) {
+        uint32_t start = dst->start_min;
+        *dst = *src;
+        dst->start_min = start;
+        return;
+    }
+    dst->count = add_u16(dst->count, src->count);
+    dst->energy_wh = add_u16(dst->energy_wh, src->energy_wh);
+    if (src->v_min < dst->v_min) dst->v_min = src->v_min;
+    if (src->v_max > dst->v_max) dst->v_max = src->v_max;
+    if (src->p_min < dst->p_min) dst->p_min = src->p_min;
+    if (src->p_max > dst->p_max) dst->p_max = src->p_max;
+    dst->v_sum += src->v_sum;
+    dst->p_sum += src->p_sum;
+}
+
+// Slot first, then the count that publishes it
+static void close_bucket(rollup_level_t level) {
+    uint32_t n = atomic_load_explicit(&closed[level], memory_order_relaxed);
+    rings[level][n % depths[level]] = open[level];
+    atomic_store_explicit(&closed[level], n + 1, memory_order_release);
+    open[level].count = 0;
+}
+
+uint8_t rollup_add(const pzem_data_t *d, uint32_t now_ms) {
+    rollup_bucket_t *m = &open[ROLLUP_MINUTE];
+    rollup_bucket_t *h = &open[ROLLUP_HOUR];
+    const uint32_t minute = now_ms / MINUTE_MS;
+    uint8_t mask = 0;
+
+    uint32_t energy = 0;
+    if (has_energy && d->energy_wh >= last_energy_wh) {
+        energy = d->energy_wh - last_energy_wh;   // A reset counter counts nothing
+    }
+    last_energy_wh = d->energy_wh;
+    has_energy = true;
+
+    if (m->count && m->start_min != minute) {
+        uint32_t hour = m->start_min / 60 * 60;
+        if (h->count && h->start_min != hour) {
+            close_bucket(ROLLUP_HOUR);
+            mask |= 1 << ROLLUP_HOUR;
+        }
+        h->start_min = hour;
+        merge(h, m);
+        close_bucket(ROLLUP_MINUTE);
+        mask |= 1 << ROLLUP_MINUTE;
+    }
+    // No later minute of that hour can come
+    if (h->count && h->start_min != minute / 60 * 60) {
+        close_bucket(ROLLUP_HOUR);
+        mask |= 1 << ROLLUP_HOUR;
+    }
+
+    if (m->count == 0) {
+        *m = (rollup_bucket_t){
+            .start_min = minute,
+            .v_min = UINT16_MAX,
+            .p_min = UINT32_MAX,
+        };
+    }
+    m->count = add_u16(m->count, 1);
+    m->energy_wh = add_u16(m->energy_wh, energy);
+    if (d->voltage_dv < m->v_min) m->v_min = d->voltage_dv;
+    if (d->voltage_dv > m->v_max) m->v_max = d->voltage_dv;
+    if (d->power_dw < m->p_min) m->p_min = d->power_dw;
+    if (d->power_dw > m->p_max) m->p_max = d->power_dw;
+    m->v_sum += d->voltage_dv;
+    m->p_sum += d->power_dw;
+    return mask;
+}
+
+uint32_t rollup_closed(rollup_level_t level) {
+    return atomic_load_explicit(&closed[level], memory_order_acquire);
+}
+
+uint32_t rollup_oldest(rollup_level_t level) {
+    uint32_t n = rollup_closed(level);
+    return n > depths[level] - 1 ? n - (depths[level] - 1) : 0;
+}
+
+// The writer only reuses the slot of seq once closed reaches
+// seq + depth, so a copy made while closed - seq stays below that is whole
+bool rollup_get(rollup_level_t level, uint32_t seq, rollup_bucket_t *out) {
+    uint32_t age = rollup_closed(level) - seq;
+    if (age == 0 || age >= depths[level]) return false;
+    *out = rings[level][seq % depths[level]];
+    atomic_thread_fence(memory_order_acquire);
+    age = atomic_load_explicit(&closed[level], memory_order_relaxed) - seq;
+    return age < depths[level];
+}
+
+void rollup_clear(void) {
+    memset(minutes, 0, sizeof(minutes));
+    memset(hours, 0, sizeof(hours));
+    memset(open, 0, sizeof(open));
+    for (int i = 0; i < ROLLUP_LEVELS; i++) {
+        atomic_store(&closed[i], 0);
+    }
+    last_energy_wh = 0;
+    has_energy = false;
+}
+
+size_t rollup_state_size(void) {
+    return sizeof(minutes) + sizeof(hours) + sizeof(open) + sizeof(closed) + sizeof(last_energy_wh) +
+           sizeof(has_energy);
+}
+
+// Value after "key": in a flat JSON object, NULL if absent
+static const char *find_value(const char *s, const char *key) {
+    const char *p = strstr(s, key);
+    if (!p) return NULL;
+    p += strlen(key);
+    while (*p == ' ') p++;
+    if (*p++ != ':') return NULL;
+    while (*p == ' ') p++;
+    return p;
+}
+
+bool rollup_parse_query(const char *buf, size_t len, rollup_query_t *q) {
+    char text[ROLLUP_QUERY_MAX + 1];
+    const char *v;
+
+    if (len > ROLLUP_QUERY_MAX) return false;
+    memcpy(text, buf, len);
+    text[len] = '\0';
+    if (!strchr(text, '{')) return false;
+
+    q->level = ROLLUP_MINUTE;
+    q->from_s = 0;
+    q->to_s = UINT32_MAX;
+    if ((v = find_value(text, "\"level\""))) {
+        if (strncmp(v, "\"minute\"", 8) == 0) {
+            q->level = ROLLUP_MINUTE;
+        } else if (strncmp(v, "\"hour\"", 6) == 0) {
+            q->level = ROLLUP_HOUR;
+        } else {
+            return false;
+        }
+    }
+    if ((v = find_value(text, "\"from\""))) q->from_s = strtoul(v, NULL, 10);
+    if ((v = find_value(text, "\"to\""))) q->to_s = strtoul(v, NULL, 10);
+    return q->from_s <= q->to_s;
+}
+
+int rollup_render(rollup_level_t level, const rollup_bucket_t *b, int n, uint32_t now_ms, char *buf, size_t cap,
+                  int *rendered) {
+    char item[ROLLUP_ITEM_MAX];
+    int len = snprintf(buf, cap, "{\"level\":\"%s\",\"now\":%lu,\"buckets\":[", rollup_level_name(level),
+                       (unsigned long)(now_ms / 1000));
+    if (len < 0 || (size_t)len >= cap) return -1;
+
+    int done = 0;
+    for (; done < n; done++) {
+        const rollup_bucket_t *x = &b[done];
+        int m = snprintf(item, sizeof(item),
+                         "%s{\"t\":%lu,\"n\":%u,\"v\":[%u,%lu,%u],\"p\":[%lu,%lu,%lu],\"e\":%u}", done ? "," : "",
+                         (unsigned long)x->start_min * 60, x->count, x->v_min,
+                         (unsigned long)(x->v_sum / x->count), x->v_max, (unsigned long)x->p_min,
+                         (unsigned long)(x->p_sum / x->count), (unsigned long)x->p_max, x->energy_wh);
+        if (m < 0 || (size_t)(len + m + 2) >= cap) break;   // Room for "]}"
+        memcpy(buf + len, item, m);
+        len += m;
+    }
+    if (done == 0 && n > 0) return -1;
+    buf[len++] = ']';
+    buf[len++] = '}';
+    buf[len] = '\0';
+    *rendered = done;
+    return len;
+}
+
+const char *rollup_level_name(rollup_level_t level) {
+    switch (level) {
+    case ROLLUP_MINUTE: return "minute";
+    case ROLLUP_HOUR:   return "hour";
+    default:            return "";
+    }
+}
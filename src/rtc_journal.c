@@ -0,0 +1,111 @@
+#include "rtc_journal.h"
+#include "telemetry.h"
+#include "hal.h"
+#include <string.h>
+
+#define KEYFRAME_SIZE  (4 + TELEMETRY_BIN_LEN - 2)
+#define DELTA_MAX      (7 * TELEMETRY_VARINT_MAX)
+
+typedef struct {
+    uint16_t used;
+    uint8_t count;
+    uint8_t data[RTC_JOURNAL_BLOCK_SIZE - 3];
+} journal_block_t;
+
+RTC_DATA_ATTR static journal_block_t blocks[RTC_JOURNAL_BLOCKS];
+RTC_DATA_ATTR static uint8_t first_block;
+RTC_DATA_ATTR static uint8_t block_count;
+RTC_DATA_ATTR static uint32_t sample_count;
+RTC_DATA_ATTR static uint32_t dropped;
+RTC_DATA_ATTR static pzem_data_t last;
+RTC_DATA_ATTR static uint32_t last_ts;
+
+static int32_t delta(uint32_t value, uint32_t prev) {
+    return (int32_t)(value - prev);
+}
+
+static journal_block_t *open_block(void) {
+    if (block_count == RTC_JOURNAL_BLOCKS) {
+        dropped += blocks[first_block].count;
+        sample_count -= blocks[first_block].count;
+        first_block = (first_block + 1) % RTC_JOURNAL_BLOCKS;
+        block_count--;
+    }
+    journal_block_t *b = &blocks[(first_block + block_count) % RTC_JOURNAL_BLOCKS];
+    block_count++;
+    b->used = 0;
+    b->count = 0;
+    return b;
+}
+
+void rtc_journal_append(const pzem_data_t *data, uint32_t ts_ms) {
+    journal_block_t *b = block_count ? &blocks[(first_block + block_count - 1) % RTC_JOURNAL_BLOCKS] : NULL;
+    uint8_t tmp[DELTA_MAX];
+    uint8_t *p = tmp;
+
+    if (b && b->count < 255) {
+        p = telemetry_put_varint(p, (int32_t)(ts_ms - last_ts));
+        p = telemetry_put_varint(p, delta(data->voltage_dv, last.voltage_dv));
+        p = telemetry_put_varint(p, delta(data->current_ma, last.current_ma));
+        p = telemetry_put_varint(p, delta(data->power_dw, last.power_dw));
+        p = telemetry_put_varint(p, delta(data->energy_wh, last.energy_wh));
+        p = telemetry_put_varint(p, delta(data->freq_dhz, last.freq_dhz));
+        p = telemetry_put_varint(p, delta(data->pf_cent, last.pf_cent));
+    }
+
+    size_t len = p - tmp;
+    if (!b || b->count == 255 || b->used + len > sizeof(b->data)) {
+        uint8_t record[TELEMETRY_BIN_LEN];
+        const telemetry_sample_t key = { .data = *data, .load_class = LOAD_CLASS_UNKNOWN };
+        b = open_block();
+        telemetry_serialize(TELEMETRY_FMT_BINARY, &key, record, sizeof(record));
+        tmp[0] = ts_ms & 0xFF;
+        tmp[1] = (ts_ms >> 8) & 0xFF;
+        tmp[2] = (ts_ms >> 16) & 0xFF;
+        tmp[3] = ts_ms >> 24;
+        memcpy(&tmp[4], &record[2], TELEMETRY_BIN_LEN - 2);
+        len = KEYFRAME_SIZE;
+    }
+
+    memcpy(&b->data[b->used], tmp, len);
+    b->used += len;
+    b->count++;
+    sample_count++;
+    last = *data;
+    last_ts = ts_ms;
+}
+
+uint32_t rtc_journal_count(void) {
+    return sample_count;
+}
+
+uint32_t rtc_journal_dropped(void) {
+    return dropped;
+}
+
+int rtc_journal_export(uint8_t *buf, size_t cap) {
+    size_t need = 2;
+    for (int i = 0; i < block_count; i++) {
+        need += 3 + blocks[(first_block + i) % RTC_JOURNAL_BLOCKS].used;
+    }
+    if (need > cap) return -1;
+
+    uint8_t *p = buf;
+    *p++ = RTC_JOURNAL_VERSION;
+    *p++ = block_count;
+    for (int i = 0; i < block_count; i++) {
+        const journal_block_t *b = &blocks[(first_block + i) % RTC_JOURNAL_BLOCKS];
+        *p++ = b->count;
+        *p++ = b->used & 0xFF;
+        *p++ = b->used >> 8;
+        memcpy(p, b->data, b->used);
+        p += b->used;
+    }
+    return (int)(p - buf);
+}
+
+void rtc_journal_clear(void) {
+    first_block = 0;
+    block_count = 0;
+    sample_count = 0;
+}
@@ -0,0 +1,99 @@
+#include "sample_ring.h"
+#include <string.h>
+
+bool sample_ring_init(sample_ring_t *ring, sample_slot_t *slots, uint32_t depth, sample_ring_policy_t policy) {
+    if (depth == 0 || (depth & (depth - 1)) != 0) return false;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->slots = slots;
+    ring->mask = depth - 1;
+    ring->policy = policy;
+    for (uint32_t i = 0; i < depth; i++) {
+        // Never matches 2 * index + 2 of a published sample until written
+        atomic_init(&slots[i].seq, 1);
+    }
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return true;
+}
+
+telemetry_sample_t *sample_ring_claim(sample_ring_t *ring) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    if (ring->policy == SAMPLE_RING_BACKPRESSURE) {
+        uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head - tail > ring->mask) {
+            ring->dropped++;
+            return NULL;
+        }
+    }
+
+    sample_slot_t *slot = &ring->slots[head & ring->mask];
+    atomic_store_explicit(&slot->seq, 2 * head + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    return &slot->sample;
+}
+
+void sample_ring_commit(sample_ring_t *ring) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    sample_slot_t *slot = &ring->slots[head & ring->mask];
+
+    atomic_store_explicit(&slot->seq, 2 * head + 2, memory_order_release);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    uint32_t count = head + 1 - atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (count > ring->mask + 1) count = ring->mask + 1;
+    if (count > ring->high_water) ring->high_water = count;
+}
+
+const telemetry_sample_t *sample_ring_peek(sample_ring_t *ring) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    while (1) {
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (head == tail) return NULL;
+
+        // Producer lapped us: skip to the oldest slot still in the ring
+        if (head - tail > ring->mask + 1) {
+            ring->overwritten += head - tail - (ring->mask + 1);
+            tail = head - (ring->mask + 1);
+            atomic_store_explicit(&ring->tail, tail, memory_order_release);
+        }
+
+        sample_slot_t *slot = &ring->slots[tail & ring->mask];
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq == 2 * tail + 2) {
+            ring->peek_seq = seq;
+            return &slot->sample;
+        }
+
+        // Slot already reused for a newer sample
+        ring->overwritten++;
+        tail++;
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    }
+}
+
+bool sample_ring_release(sample_ring_t *ring) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    sample_slot_t *slot = &ring->slots[tail & ring->mask];
+
+    atomic_thread_fence(memory_order_acquire);
+    bool intact = atomic_load_explicit(&slot->seq, memory_order_relaxed) == ring->peek_seq;
+    if (!intact) ring->overwritten++;
+
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return intact;
+}
+
+void sample_ring_get_stats(sample_ring_t *ring, sample_ring_stats_t *stats) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t count = head - tail;
+
+    stats->depth = ring->mask + 1;
+    stats->count = count > stats->depth ? stats->depth : count;
+    stats->high_water = ring->high_water;
+    stats->dropped = ring->dropped;
+    stats->overwritten = ring->overwritten;
+}
@@ -0,0 +1,69 @@
+#include "sample_scheduler.h"
+
+void sample_scheduler_init(sample_scheduler_t *s, uint32_t overload_dw) {
+    s->near_overload_dw = overload_dw - overload_dw / 8;
+    s->sleep_ms = SCHED_SLEEP_MIN_MS;
+    s->sleep_reasons = SCHED_REASON_TRANSITION;
+    sample_scheduler_wake(s);
+}
+
+void sample_scheduler_wake(sample_scheduler_t *s) {
+    s->period_ms = SCHED_FAST_PERIOD_MS;
+    s->reasons = SCHED_REASON_TRANSITION;
+    s->stable = 0;
+    s->sleep_ms = SCHED_SLEEP_MIN_MS;
+    s->sleep_reasons = SCHED_REASON_TRANSITION;
+}
+
+uint32_t sample_scheduler_next(sample_scheduler_t *s, bool changed, uint32_t power_dw, bool overload) {
+    if (changed) {
+        s->stable = 0;
+    } else if (s->stable < UINT16_MAX) {
+        s->stable++;
+    }
+
+    s->reasons = 0;
+    if (s->stable < SCHED_FAST_HOLD_SAMPLES) s->reasons |= SCHED_REASON_TRANSITION;
+    if (power_dw >= s->near_overload_dw) s->reasons |= SCHED_REASON_NEAR_OVERLOAD;
+    if (overload) s->reasons |= SCHED_REASON_OVERLOAD;
+    if (s->reasons) {
+        s->period_ms = SCHED_FAST_PERIOD_MS;
+        return s->period_ms;
+    }
+
+    uint32_t doublings = (s->stable - SCHED_FAST_HOLD_SAMPLES) / SCHED_BACKOFF_SAMPLES;
+    uint32_t period = SCHED_BASE_PERIOD_MS;
+    while (doublings-- && period < SCHED_MAX_PERIOD_MS) period *= 2;
+
+    if (period >= SCHED_MAX_PERIOD_MS) {
+        s->period_ms = SCHED_MAX_PERIOD_MS;
+        s->reasons = SCHED_REASON_CEILING;
+    } else {
+        s->period_ms = period;
+        s->reasons = SCHED_REASON_BACKOFF;
+    }
+    return s->period_ms;
+}
+
+uint32_t sample_scheduler_next_sleep(sample_scheduler_t *s, uint32_t power_dw) {
+    if (power_dw >= s->near_overload_dw) {
+        s->sleep_ms = SCHED_SLEEP_MIN_MS;
+        s->sleep_reasons = SCHED_REASON_NEAR_OVERLOAD;
+    } else if (s->sleep_ms * 2 >= SCHED_SLEEP_MAX_MS) {
+        s->sleep_ms = SCHED_SLEEP_MAX_MS;
+        s->sleep_reasons = SCHED_REASON_CEILING;
+    } else {
+        s->sleep_ms *= 2;
+        s->sleep_reasons = SCHED_REASON_BACKOFF;
+    }
+    return s->sleep_ms;
+}
+
+const char *sample_scheduler_reason_name(uint8_t reasons) {
+    if (reasons & SCHED_REASON_OVERLOAD) return "overload";
+    if (reasons & SCHED_REASON_NEAR_OVERLOAD) return "near overload";
+    if (reasons & SCHED_REASON_TRANSITION) return "transition";
+    if (reasons & SCHED_REASON_CEILING) return "ceiling";
+    if (reasons & SCHED_REASON_BACKOFF) return "backoff";
+    return "";
+}
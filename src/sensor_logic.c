@@ -0,0 +1,48 @@
+#include "sensor_logic.h"
+#include "app_config.h"
+#include "ota_poll.h"
+
+// Polled faster than the PZEM refreshes, the same registers come back
+static bool same_reading(const pzem_data_t *a, const pzem_data_t *b) {
+    return a->energy_wh == b->energy_wh && a->power_dw == b->power_dw && a->current_ma == b->current_ma &&
+           a->voltage_dv == b->voltage_dv && a->freq_dhz == b->freq_dhz && a->pf_cent == b->pf_cent;
+}
+
+bool sensor_logic_wake(sensor_logic_t *s, uint8_t changed, uint32_t slept_ms) {
+    // Time to force a wake-up for OTA (e.g. every 5 mins)
+    bool force_ota_check = slept_ms >= OTA_CHECK_INTERVAL_MS;
+    if (!changed && s->has_run && !force_ota_check) return false;
+
+    s->wake_change = changed != 0;
+    return true;
+}
+
+void sensor_logic_start(sensor_logic_t *s, uint32_t now_ms) {
+    s->last = (pzem_data_t){0};
+    s->last_change_ms = now_ms;
+}
+
+sensor_decision_t sensor_logic_step(sensor_logic_t *s, change_detector_t *detector, const pzem_data_t *data,
+                                    uint8_t load_class, uint32_t now_ms) {
+    sensor_decision_t d;
+
+    d.fresh = !same_reading(data, &s->last);
+    s->last = *data;
+    d.changed = d.fresh ? change_detector_update(detector, data) : 0;
+
+#if PUBLISH_ON_CLASS_CHANGE_ONLY
+    d.publish = load_class != s->last_class || !s->has_run;
+#else
+    (void)load_class;
+    d.publish = d.changed || s->wake_change || !s->has_run;
+#endif
+    s->wake_change = false;
+
+    if (d.publish) {
+        s->last_class = load_class;
+        s->has_run = true;
+        s->last_change_ms = now_ms;
+    }
+    d.sleep = now_ms - s->last_change_ms > IDLE_TIMEOUT_MS;
+    return d;
+}
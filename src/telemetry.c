@@ -0,0 +1,253 @@
+#include "telemetry.h"
+#include <string.h>
+
+typedef struct {
+    char *p;
+    char *end;
+    bool overflow;
+} writer_t;
+
+static void put_str(writer_t *w, const char *s) {
+    while (*s && w->p < w->end) *w->p++ = *s++;
+    if (*s) w->overflow = true;
+}
+
+// Prints value / 10^decimals with trailing zeros dropped. Registers have
+// at most 10 digits, so this is what cJSON prints for the same quotient
+// as a double ("%d" when whole, else a "%1.15g" that round-trips)
+static void put_fixed(writer_t *w, uint32_t value, int decimals) {
+    char tmp[16];
+    int n = 0;
+    int frac_digits = decimals;
+
+    while (frac_digits > 0 && value % 10 == 0) {
+        value /= 10;
+        frac_digits--;
+    }
+    do {
+        tmp[n++] = '0' + value % 10;
+        value /= 10;
+        if (n == frac_digits) tmp[n++] = '.';
+    } while (value || n <= frac_digits);
+    if (tmp[n - 1] == '.') tmp[n++] = '0';
+
+    if (w->end - w->p < n) {
+        w->overflow = true;
+        return;
+    }
+    while (n) *w->p++ = tmp[--n];
+}
+
+static void put_int(writer_t *w, int32_t value) {
+    if (value < 0) {
+        put_str(w, "-");
+        put_fixed(w, (uint32_t)0 - (uint32_t)value, 0);
+    } else {
+        put_fixed(w, (uint32_t)value, 0);
+    }
+}
+
+static int serialize_json(const telemetry_sample_t *s, uint8_t *buf, size_t cap) {
+    const pzem_data_t *d = &s->data;
+    const char *name = load_classifier_name(s->load_class);
+    if (cap == 0) return -1;
+    writer_t w = { (char *)buf, (char *)buf + cap - 1, false };
+
+    // Fields keep the old cJSON insertion order
+    put_str(&w, "{\"voltage\":");
+    put_fixed(&w, d->voltage_dv, 1);
+    put_str(&w, ",\"current\":");
+    put_fixed(&w, d->current_ma, 3);
+    put_str(&w, ",\"power\":");
+    put_fixed(&w, d->power_dw, 1);
+    put_str(&w, ",\"energy\":");
+    put_fixed(&w, d->energy_wh, 3);
+    put_str(&w, ",\"frequency\":");
+    put_fixed(&w, d->freq_dhz, 1);
+    put_str(&w, ",\"pf\":");
+    put_fixed(&w, d->pf_cent, 2);
+    put_str(&w, s->relay ? ",\"relay\":true" : ",\"relay\":false");
+    if (name) {
+        put_str(&w, ",\"class\":\"");
+        put_str(&w, name);
+        put_str(&w, "\"");
+    }
+    put_str(&w, "}");
+    if (w.overflow) return -1;
+
+    *w.p = '\0';
+    return (int)(w.p - (char *)buf);
+}
+
+static void le16(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static void le32(uint8_t *p, uint32_t v) {
+    le16(p, v & 0xFFFF);
+    le16(p + 2, v >> 16);
+}
+
+static uint8_t flags(const telemetry_sample_t *s) {
+    return (s->relay ? 0x01 : 0x00) | (uint8_t)((s->load_class & 0x0F) << 1);
+}
+
+static int serialize_binary(const telemetry_sample_t *s, uint8_t *buf, size_t cap) {
+    const pzem_data_t *d = &s->data;
+    if (cap < TELEMETRY_BIN_LEN) return -1;
+    buf[0] = TELEMETRY_BIN_VERSION;
+    buf[1] = flags(s);
+    le16(&buf[2], d->voltage_dv);
+    le32(&buf[4], d->current_ma);
+    le32(&buf[8], d->power_dw);
+    le32(&buf[12], d->energy_wh);
+    le16(&buf[16], d->freq_dhz);
+    le16(&buf[18], d->pf_cent);
+    return TELEMETRY_BIN_LEN;
+}
+
+static uint32_t rd16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t rd32(const uint8_t *p) {
+    return rd16(p) | (rd16(p + 2) << 16);
+}
+
+bool telemetry_parse_binary(const uint8_t *buf, size_t len, telemetry_sample_t *sample) {
+    pzem_data_t *data = &sample->data;
+    if (len < TELEMETRY_BIN_LEN || buf[0] != TELEMETRY_BIN_VERSION) return false;
+    sample->relay = (buf[1] & 0x01) != 0;
+    sample->load_class = (buf[1] >> 1) & 0x0F;
+    data->voltage_dv = rd16(&buf[2]);
+    data->current_ma = rd32(&buf[4]);
+    data->power_dw   = rd32(&buf[8]);
+    data->energy_wh  = rd32(&buf[12]);
+    data->freq_dhz   = rd16(&buf[16]);
+    data->pf_cent    = rd16(&buf[18]);
+    data->valid = true;
+    return true;
+}
+
+static int32_t delta(uint32_t value, uint32_t base) {
+    return (int32_t)(value - base);
+}
+
+static int serialize_batch_json(const telemetry_batch_t *b, uint8_t *buf, size_t cap) {
+    if (cap == 0 || b->count == 0) return -1;
+    writer_t w = { (char *)buf, (char *)buf + cap - 1, false };
+    const telemetry_sample_t *first = &b->samples[0];
+    const pzem_data_t *base = &first->data;
+
+    put_str(&w, "{\"t0\":");
+    put_fixed(&w, first->ts_ms, 0);
+    put_str(&w, ",\"base\":[");
+    put_fixed(&w, base->voltage_dv, 0);
+    put_str(&w, ",");
+    put_fixed(&w, base->current_ma, 0);
+    put_str(&w, ",");
+    put_fixed(&w, base->power_dw, 0);
+    put_str(&w, ",");
+    put_fixed(&w, base->energy_wh, 0);
+    put_str(&w, ",");
+    put_fixed(&w, base->freq_dhz, 0);
+    put_str(&w, ",");
+    put_fixed(&w, base->pf_cent, 0);
+    put_str(&w, first->relay ? ",1," : ",0,");
+    put_fixed(&w, first->load_class, 0);
+    put_str(&w, "],\"d\":[");
+
+    for (int i = 1; i < b->count; i++) {
+        const telemetry_sample_t *s = &b->samples[i];
+        put_str(&w, i > 1 ? ",[" : "[");
+        put_fixed(&w, s->ts_ms - first->ts_ms, 0);
+        put_str(&w, ",");
+        put_int(&w, delta(s->data.voltage_dv, base->voltage_dv));
+        put_str(&w, ",");
+        put_int(&w, delta(s->data.current_ma, base->current_ma));
+        put_str(&w, ",");
+        put_int(&w, delta(s->data.power_dw, base->power_dw));
+        put_str(&w, ",");
+        put_int(&w, delta(s->data.energy_wh, base->energy_wh));
+        put_str(&w, ",");
+        put_int(&w, delta(s->data.freq_dhz, base->freq_dhz));
+        put_str(&w, ",");
+        put_int(&w, delta(s->data.pf_cent, base->pf_cent));
+        put_str(&w, s->relay ? ",1," : ",0,");
+        put_fixed(&w, s->load_class, 0);
+        put_str(&w, "]");
+    }
+    put_str(&w, "]}");
+    if (w.overflow) return -1;
+
+    *w.p = '\0';
+    return (int)(w.p - (char *)buf);
+}
+
+// Zigzag LEB128, at most 5 bytes per value
+uint8_t *telemetry_put_varint(uint8_t *p, int32_t value) {
+    uint32_t v = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    while (v >= 0x80) {
+        *p++ = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+static int serialize_batch_binary(const telemetry_batch_t *b, uint8_t *buf, size_t cap) {
+    const size_t header = 6 + TELEMETRY_BIN_LEN - 1;
+    const size_t row_max = 7 * 5 + 1;
+    if (b->count == 0 || cap < header + (b->count - 1) * row_max) return -1;
+
+    const telemetry_sample_t *first = &b->samples[0];
+    const pzem_data_t *base = &first->data;
+    uint8_t record[TELEMETRY_BIN_LEN];
+
+    buf[0] = TELEMETRY_BIN_BATCH_VERSION;
+    buf[1] = b->count;
+    le32(&buf[2], first->ts_ms);
+    serialize_binary(first, record, sizeof(record));
+    memcpy(&buf[6], &record[1], TELEMETRY_BIN_LEN - 1);
+
+    uint8_t *p = buf + header;
+    for (int i = 1; i < b->count; i++) {
+        const telemetry_sample_t *s = &b->samples[i];
+        p = telemetry_put_varint(p, (int32_t)(s->ts_ms - first->ts_ms));
+        p = telemetry_put_varint(p, delta(s->data.voltage_dv, base->voltage_dv));
+        p = telemetry_put_varint(p, delta(s->data.current_ma, base->current_ma));
+        p = telemetry_put_varint(p, delta(s->data.power_dw, base->power_dw));
+        p = telemetry_put_varint(p, delta(s->data.energy_wh, base->energy_wh));
+        p = telemetry_put_varint(p, delta(s->data.freq_dhz, base->freq_dhz));
+        p = telemetry_put_varint(p, delta(s->data.pf_cent, base->pf_cent));
+        *p++ = flags(s);
+    }
+    return (int)(p - buf);
+}
+
+int telemetry_serialize_batch(telemetry_format_t fmt, const telemetry_batch_t *batch, uint8_t *buf, size_t cap) {
+    if (fmt == TELEMETRY_FMT_BINARY) {
+        return serialize_batch_binary(batch, buf, cap);
+    }
+    return serialize_batch_json(batch, buf, cap);
+}
+
+bool telemetry_batch_add(telemetry_batch_t *batch, const telemetry_sample_t *sample, int max_samples) {
+    if (max_samples > TELEMETRY_BATCH_MAX) max_samples = TELEMETRY_BATCH_MAX;
+    if (batch->count < max_samples) {
+        batch->samples[batch->count++] = *sample;
+    }
+    return batch->count >= max_samples;
+}
+
+bool telemetry_batch_expired(const telemetry_batch_t *batch, uint32_t now_ms, uint32_t max_latency_ms) {
+    return batch->count > 0 && now_ms - batch->samples[0].ts_ms >= max_latency_ms;
+}
+
+int telemetry_serialize(telemetry_format_t fmt, const telemetry_sample_t *sample, uint8_t *buf, size_t cap) {
+    if (fmt == TELEMETRY_FMT_BINARY) {
+        return serialize_binary(sample, buf, cap);
+    }
+    return serialize_json(sample, buf, cap);
+}
@@ -0,0 +1,64 @@
+#include "wake_trace.h"
+#include "hal.h"
+#include <stdatomic.h>
+#include <stdio.h>
+
+#define WAKE_PHASE_NAME(id, name) name,
+static const char *const phase_names[] = { WAKE_PHASES(WAKE_PHASE_NAME) };
+#undef WAKE_PHASE_NAME
+
+// ms + 1, 0 while unmarked. Plain RAM: a deep sleep clears it anyway.
+static _Atomic uint32_t marks[WAKE_PHASE_COUNT];
+static _Atomic bool cached_ap;
+
+void wake_trace_begin(void) {
+    for (int i = 0; i < WAKE_PHASE_COUNT; i++) {
+        atomic_store_explicit(&marks[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&cached_ap, false, memory_order_relaxed);
+}
+
+bool wake_trace_mark_at(wake_phase_t phase, uint32_t ms) {
+    uint32_t unmarked = 0;
+    return atomic_compare_exchange_strong_explicit(&marks[phase], &unmarked, ms + 1, memory_order_relaxed,
+                                                   memory_order_relaxed);
+}
+
+bool wake_trace_mark(wake_phase_t phase) {
+    return wake_trace_mark_at(phase, hal_millis());
+}
+
+bool wake_trace_get(wake_phase_t phase, uint32_t *ms) {
+    uint32_t m = atomic_load_explicit(&marks[phase], memory_order_relaxed);
+    if (m == 0) return false;
+    *ms = m - 1;
+    return true;
+}
+
+void wake_trace_set_cached(bool cached) {
+    atomic_store_explicit(&cached_ap, cached, memory_order_relaxed);
+}
+
+bool wake_trace_cached(void) {
+    return atomic_load_explicit(&cached_ap, memory_order_relaxed);
+}
+
+int wake_trace_format(char *buf, size_t cap) {
+    size_t len = 0;
+    int n;
+
+    for (int i = 0; i < WAKE_PHASE_COUNT; i++) {
+        uint32_t ms;
+        if (!wake_trace_get((wake_phase_t)i, &ms)) continue;
+        n = snprintf(buf + len, cap - len, "%s%s %lu", len ? ", " : "", phase_names[i], (unsigned long)ms);
+        if (n < 0 || (size_t)n >= cap - len) return -1;
+        len += n;
+    }
+    n = snprintf(buf + len, cap - len, " ms (%s)", wake_trace_cached() ? "cached AP" : "full connect");
+    if (n < 0 || (size_t)n >= cap - len) return -1;
+    return (int)(len + n);
+}
+
+const char *wake_phase_name(wake_phase_t phase) {
+    return phase < WAKE_PHASE_COUNT ? phase_names[phase] : "";
+}
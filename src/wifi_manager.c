@@ -4,7 +4,10 @@
 #include "freertos/task.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
+#include "esp_netif.h"
 #include "esp_log.h"
+#include "hal.h"
+#include "wake_trace.h"
 
 
 #define WIFI_SSID      "wifi"
@@ -12,14 +15,78 @@
 
 #define MAX_RETRY      10
 
+// AP and lease of the last DHCP, survives deep sleep
+typedef struct {
+    bool valid;
+    uint8_t bssid[6];
+    uint8_t channel;
+    esp_netif_ip_info_t ip;
+    esp_ip4_addr_t dns;
+    uint32_t saved_ms;          // hal_rtc_millis of the DHCP lease
+} wifi_cache_t;
+
 static const char *TAG = "WIFI_MGR";
 static int s_retry_num = 0;
+static esp_netif_t *sta_netif = NULL;
+static wifi_config_t wifi_config;
+static bool using_cache = false;
+static wifi_connected_fn_t connected_cb = NULL;
+RTC_DATA_ATTR static wifi_cache_t cache;
+
+static void save_cache(const esp_netif_ip_info_t *ip) {
+    wifi_ap_record_t ap;
+    esp_netif_dns_info_t dns;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) return;
+    if (esp_netif_get_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns) != ESP_OK) return;
+
+    memcpy(cache.bssid, ap.bssid, sizeof(cache.bssid));
+    cache.channel = ap.primary;
+    cache.ip = *ip;
+    cache.dns = dns.ip.u_addr.ip4;
+    cache.saved_ms = hal_rtc_millis();
+    cache.valid = true;
+}
+
+// Straight to the known AP on its channel, no scan, no DHCP
+static bool apply_cache(void) {
+    if (!cache.valid || hal_rtc_millis() - cache.saved_ms >= WIFI_CACHE_MAX_AGE_MS) return false;
+
+    esp_netif_dns_info_t dns = { .ip.type = ESP_IPADDR_TYPE_V4, .ip.u_addr.ip4 = cache.dns };
+    esp_err_t err = esp_netif_dhcpc_stop(sta_netif);
+    if (err != ESP_OK && err != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED) return false;
+    if (esp_netif_set_ip_info(sta_netif, &cache.ip) != ESP_OK) {
+        esp_netif_dhcpc_start(sta_netif);
+        return false;
+    }
+    esp_netif_set_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns);
+    wifi_config.sta.bssid_set = true;
+    memcpy(wifi_config.sta.bssid, cache.bssid, sizeof(cache.bssid));
+    wifi_config.sta.channel = cache.channel;
+    return true;
+}
+
+// The cached AP or lease did not work: forget it and do a full connect
+static void drop_cache(void) {
+    ESP_LOGW(TAG, "Cached AP failed, scanning");
+    cache.valid = false;
+    using_cache = false;
+    wake_trace_set_cached(false);
+    wifi_config.sta.bssid_set = false;
+    wifi_config.sta.channel = 0;
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    esp_netif_dhcpc_start(sta_netif);
+}
 
 static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        wake_trace_mark(WAKE_ASSOCIATED);
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < MAX_RETRY) {
+        if (using_cache) {
+            drop_cache();
+            esp_wifi_connect();
+        } else if (s_retry_num < MAX_RETRY) {
             esp_wifi_connect();
             s_retry_num++;
             ESP_LOGI(TAG, "Retrying to connect...");
@@ -31,30 +98,43 @@ static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_
         }
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        ESP_LOGI(TAG, "Connected! IP: " IPSTR, IP2STR(&event->ip_info.ip));
+        wake_trace_mark(WAKE_GOT_IP);
+        ESP_LOGI(TAG, "Connected! IP: " IPSTR "%s", IP2STR(&event->ip_info.ip), using_cache ? " (cached)" : "");
+        if (!using_cache) {
+            save_cache(&event->ip_info);
+        }
         s_retry_num = 0;
+        if (connected_cb) {
+            connected_cb();
+        }
     }
 }
 
-void wifi_init_sta(void) {
+void wifi_init_sta(wifi_connected_fn_t on_connected) {
+    wake_trace_mark(WAKE_WIFI_START);
+    connected_cb = on_connected;
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    sta_netif = esp_netif_create_default_wifi_sta();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    // The config is set on every wake, no need to write it to NVS each time
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
 
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL, NULL));
     ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL, NULL));
 
-    wifi_config_t wifi_config = {
+    wifi_config = (wifi_config_t){
         .sta = {
             .ssid = WIFI_SSID,
             .password = WIFI_PASS,
             .threshold.authmode = WIFI_AUTH_WPA2_PSK,
         },
     };
+    using_cache = apply_cache();
+    wake_trace_set_cached(using_cache);
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
-}
\ No newline at end of file
+}
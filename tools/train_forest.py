@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""Train the load classifier on dataset/*.csv and emit it as flat C tables.
+
+Every tree is a complete binary tree of fixed depth stored in heap order,
+so inference is DEPTH steps of  i = 2*i + 1 + (x[feature[i]] > threshold[i])
+with no data-dependent branches. Features and thresholds are raw PZEM
+integer units (see include/common_structs.h).
+
+Pure Python, no dependencies:
+    python3 tools/train_forest.py            # writes include/load_classifier_model.h
+"""
+import csv
+import glob
+import os
+import random
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+OUT = os.path.join(ROOT, "include", "load_classifier_model.h")
+
+TREES = 15
+DEPTH = 6
+MIN_SPLIT = 4
+SEED = 39
+
+CLASSES = ["Nothing", "Laptop", "Solder", "Printer", "3D Printer",
+           "Laptop+Solder", "Laptop+Printer", "Solder+Printer"]
+SOURCES = {
+    "laptop.csv": "Laptop",
+    "solder.csv": "Solder",
+    "printerlab.csv": "Printer",
+    "3dprinterlab.csv": "3D Printer",
+    "laptopdansolder.csv": "Laptop+Solder",
+    "laptopdanprinter.csv": "Laptop+Printer",
+    "solderdanprinter.csv": "Solder+Printer",
+}
+# Same order as load_classifier.c builds its feature vector
+FEATURES = ["power_dw", "current_ma", "pf_cent"]
+NO_SPLIT = 0xFFFFFFFF  # x > NO_SPLIT is never true, always go left
+
+
+def load():
+    rows = []
+    for path in sorted(glob.glob(os.path.join(ROOT, "dataset", "*.csv"))):
+        label = CLASSES.index(SOURCES[os.path.basename(path)])
+        with open(path) as f:
+            for r in csv.DictReader(f):
+                try:
+                    x = [round(float(r["Power"]) * 10), round(float(r["Current"]) * 1000),
+                         round(float(r["PF"]) * 100)]
+                except (TypeError, ValueError):
+                    continue  # Two logger lines run together
+                y = CLASSES.index("Nothing") if x[0] == 0 and x[1] == 0 else label
+                rows.append((x, y))
+    return rows
+
+
+def gini(counts, n):
+    return 1.0 - sum((c / n) ** 2 for c in counts.values()) if n else 0.0
+
+
+def majority(rows):
+    counts = {}
+    for _, y in rows:
+        counts[y] = counts.get(y, 0) + 1
+    return max(sorted(counts), key=lambda c: counts[c])
+
+
+def best_split(rows, rng):
+    n = len(rows)
+    feats = rng.sample(range(len(FEATURES)), max(1, int(len(FEATURES) ** 0.5 + 0.5)))
+    best = None
+    for f in feats:
+        ordered = sorted(rows, key=lambda r: r[0][f])
+        left, right = {}, {}
+        for _, y in ordered:
+            right[y] = right.get(y, 0) + 1
+        for i in range(n - 1):
+            y = ordered[i][1]
+            left[y] = left.get(y, 0) + 1
+            right[y] -= 1
+            a, b = ordered[i][0][f], ordered[i + 1][0][f]
+            if a == b:
+                continue
+            score = ((i + 1) * gini(left, i + 1) + (n - i - 1) * gini(right, n - i - 1)) / n
+            if best is None or score < best[0]:
+                best = (score, f, (a + b) // 2)
+    return best
+
+
+def grow(rows, depth, index, nodes, leaves, rng):
+    """Fills heap-ordered nodes/leaves of a complete tree rooted at index."""
+    if depth == DEPTH:
+        leaves[index - (2 ** DEPTH - 1)] = majority(rows)
+        return
+    split = None
+    if len(rows) >= MIN_SPLIT and len(set(y for _, y in rows)) > 1:
+        split = best_split(rows, rng)
+    if split is None:
+        nodes[index] = (0, NO_SPLIT)
+        grow(rows, depth + 1, 2 * index + 1, nodes, leaves, rng)
+        grow(rows, depth + 1, 2 * index + 2, nodes, leaves, rng)  # Unreachable, padding
+        return
+    _, f, t = split
+    nodes[index] = (f, t)
+    grow([r for r in rows if r[0][f] <= t], depth + 1, 2 * index + 1, nodes, leaves, rng)
+    grow([r for r in rows if r[0][f] > t], depth + 1, 2 * index + 2, nodes, leaves, rng)
+
+
+def train(rows, rng):
+    forest = []
+    for _ in range(TREES):
+        sample = [rows[rng.randrange(len(rows))] for _ in rows]
+        nodes = [None] * (2 ** DEPTH - 1)
+        leaves = [0] * (2 ** DEPTH)
+        grow(sample, 0, 0, nodes, leaves, rng)
+        forest.append((nodes, leaves))
+    return forest
+
+
+def predict(forest, x):
+    """Exactly the traversal load_classifier.c performs."""
+    votes = [0] * len(CLASSES)
+    for nodes, leaves in forest:
+        i = 0
+        for _ in range(DEPTH):
+            f, t = nodes[i]
+            i = 2 * i + 1 + (1 if x[f] > t else 0)
+        votes[leaves[i - (2 ** DEPTH - 1)]] += 1
+    return max(range(len(CLASSES)), key=lambda c: (votes[c], -c))
+
+
+def accuracy(forest, rows):
+    return sum(predict(forest, x) == y for x, y in rows) / len(rows)
+
+
+def emit(forest, holdout, resub):
+    out = []
+    out.append("#pragma once")
+    out.append("// GENERATED by tools/train_forest.py from dataset/*.csv, do not edit.")
+    out.append("// %d trees, depth %d, features: %s" % (TREES, DEPTH, ", ".join(FEATURES)))
+    out.append("// Holdout accuracy %.2f%%, full dataset %.2f%%" % (holdout * 100, resub * 100))
+    out.append("#include <stdint.h>")
+    out.append("")
+    out.append("#define LOAD_MODEL_TREES     %d" % TREES)
+    out.append("#define LOAD_MODEL_DEPTH     %d" % DEPTH)
+    out.append("#define LOAD_MODEL_NODES     %d" % (2 ** DEPTH - 1))
+    out.append("#define LOAD_MODEL_LEAVES    %d" % (2 ** DEPTH))
+    out.append("#define LOAD_MODEL_FEATURES  %d" % len(FEATURES))
+    out.append("#define LOAD_MODEL_CLASSES   %d" % len(CLASSES))
+    out.append("")
+    out.append("static const char *const load_model_class_names[LOAD_MODEL_CLASSES] = {")
+    out.append("    " + ", ".join('"%s"' % c for c in CLASSES) + ",")
+    out.append("};")
+    out.append("")
+    out.append("static const uint8_t load_model_feature[LOAD_MODEL_TREES][LOAD_MODEL_NODES] = {")
+    for nodes, _ in forest:
+        out.append("    { " + ", ".join(str(f) for f, _ in nodes) + " },")
+    out.append("};")
+    out.append("")
+    out.append("static const uint32_t load_model_threshold[LOAD_MODEL_TREES][LOAD_MODEL_NODES] = {")
+    for nodes, _ in forest:
+        out.append("    { " + ", ".join("0x%X" % t if t == NO_SPLIT else str(t) for _, t in nodes) + " },")
+    out.append("};")
+    out.append("")
+    out.append("static const uint8_t load_model_leaf[LOAD_MODEL_TREES][LOAD_MODEL_LEAVES] = {")
+    for _, leaves in forest:
+        out.append("    { " + ", ".join(str(c) for c in leaves) + " },")
+    out.append("};")
+    with open(OUT, "w") as f:
+        f.write("\n".join(out) + "\n")
+
+
+def main():
+    rows = load()
+    rng = random.Random(SEED)
+
+    shuffled = rows[:]
+    rng.shuffle(shuffled)
+    cut = len(shuffled) * 4 // 5
+    holdout = accuracy(train(shuffled[:cut], random.Random(SEED)), shuffled[cut:])
+
+    forest = train(rows, random.Random(SEED))
+    resub = accuracy(forest, rows)
+    emit(forest, holdout, resub)
+
+    print("%d samples, %d classes" % (len(rows), len(CLASSES)))
+    print("Holdout accuracy (80/20): %.2f%%" % (holdout * 100))
+    print("Flat-table accuracy on all samples: %.2f%%" % (resub * 100))
+    print("Wrote %s" % os.path.relpath(OUT, ROOT))
+
+
+if __name__ == "__main__":
+    sys.exit(main())